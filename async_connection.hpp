@@ -0,0 +1,438 @@
+/*
+ * File:   async_connection.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef ASYNC_CONNECTION_HPP
+#define ASYNC_CONNECTION_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "connection.hpp"
+
+namespace vgi { namespace dbconn { namespace dbi {
+
+namespace detail {
+
+    /**
+     * owned - maps type of a queued command parameter to the type owning its
+     * value, strings and blobs referenced by pointers and views are copied
+     * as the caller's data may be gone before the command is run
+     */
+    template <typename T>
+    struct owned
+    {
+        using type = T;
+
+        template <typename U>
+        static type get(U&& val) { return std::forward<U>(val); }
+    };
+
+    template <>
+    struct owned<const char*>
+    {
+        using type = std::string;
+        static type get(const char* val) { return type(val); }
+    };
+
+    template <>
+    struct owned<char*> : owned<const char*> { };
+
+    template <>
+    struct owned<utils::string_view>
+    {
+        using type = std::string;
+        static type get(utils::string_view val) { return type(val.data(), val.size()); }
+    };
+
+    template <>
+    struct owned<utils::blob_span>
+    {
+        using type = std::vector<uint8_t>;
+        static type get(utils::blob_span val) { return type(val.begin(), val.end()); }
+    };
+
+    template <typename T>
+    typename owned<typename std::decay<T>::type>::type own(T&& val)
+    {
+        return owned<typename std::decay<T>::type>::get(std::forward<T>(val));
+    }
+
+} // namespace detail
+
+
+/**
+ * async_connection - is a connection owned by a dedicated worker thread. Any
+ * number of threads may queue commands which are run by the worker one by one
+ * in the order they were queued, the callers get results via futures or
+ * callbacks and never wait for database I/O. The queue is bounded, a caller
+ * queuing a command into the full queue waits up to queue timeout for a free
+ * slot (backpressure). The worker connects (and reconnects) the connection on
+ * demand before running a command, eg:
+ *
+ *     async_connection aconn(driver<sqlite::driver>::load().get_connection("test.db"));
+ *     auto res = aconn.execute_async("select * from test where id = ?", 1);
+ *     materialized_result mr = res.get();
+ *
+ * Commands still queued when async_connection is destroyed are run before the
+ * worker thread exits.
+ */
+class async_connection
+{
+    using clock = std::chrono::steady_clock;
+
+public:
+    using callback = std::function<void(std::exception_ptr, materialized_result&&)>;
+
+    /**
+     * latency - counters of time spent by commands, in microseconds
+     */
+    struct latency
+    {
+        size_t count = 0;
+        uint64_t total = 0;
+        uint64_t max = 0;
+
+        uint64_t avg() const
+        {
+            return (count > 0 ? total / count : 0);
+        }
+    };
+
+    /**
+     * stats - queue counters snapshot, wait is the time commands spent in the
+     * queue and run is the time spent by the worker running them
+     */
+    struct stats
+    {
+        size_t depth = 0;
+        size_t max_depth = 0;
+        size_t executed = 0;
+        size_t failed = 0;
+        size_t rejected = 0;
+        latency wait;
+        latency run;
+    };
+
+    /**
+     * Constructor
+     * @param conn connection to be owned by the worker thread
+     * @param max_queue maximum number of queued commands
+     */
+    explicit async_connection(connection&& conn, size_t max_queue = 1024)
+        : conn(std::move(conn)), max_queue(max_queue)
+    {
+        if (0 == max_queue)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Queue size must be greater than zero"));
+        worker = std::thread(&async_connection::run, this);
+    }
+
+    ~async_connection()
+    {
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            stopped = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    /**
+     * Function sets time callers wait for a free queue slot when the queue is
+     * full, zero (default) means wait without time limit
+     * @param timeout
+     * @return
+     */
+    async_connection& queue_timeout(std::chrono::milliseconds timeout)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        queue_tout = timeout;
+        return *this;
+    }
+
+    /**
+     * Function queues SQL statement, see statement::execute(sql, args...) for
+     * parameters binding. Parameters are copied (or moved) into the command,
+     * C strings, string views and blob spans are copied into owning strings
+     * and byte vectors.
+     * @param sql statement to be executed
+     * @param args parameter values
+     * @return future of the fully fetched result
+     */
+    template <typename... Args>
+    std::future<materialized_result> execute_async(const std::string& sql, Args&&... args)
+    {
+        auto params = std::make_tuple(detail::own(std::forward<Args>(args))...);
+        return submit([this, sql, params](connection&) mutable { return materialize(sql, params); });
+    }
+
+    /**
+     * Function queues SQL statement, the callback is called by the worker
+     * thread with either an exception or the fetched result. An exception
+     * thrown by the callback is caught and the command is counted as failed.
+     * @param cb callback function
+     * @param sql statement to be executed
+     * @param args parameter values
+     */
+    template <typename... Args>
+    void execute_async(callback cb, const std::string& sql, Args&&... args)
+    {
+        auto params = std::make_tuple(detail::own(std::forward<Args>(args))...);
+        enqueue(std::unique_ptr<command>(new callback_command<decltype(params)>(this, std::move(cb), sql, std::move(params))));
+    }
+
+    /**
+     * Function queues a function which gets exclusive access to the connection
+     * on the worker thread, eg for a transaction made of several statements
+     * @param f function taking connection& argument
+     * @return future of the function result
+     */
+    template <typename F>
+    auto submit(F&& f) -> std::future<decltype(f(std::declval<connection&>()))>
+    {
+        using R = decltype(f(std::declval<connection&>()));
+        std::unique_ptr<task_command<typename std::decay<F>::type, R>> cmd(new task_command<typename std::decay<F>::type, R>(std::forward<F>(f)));
+        auto res = cmd->promise.get_future();
+        enqueue(std::move(cmd));
+        return res;
+    }
+
+    /**
+     * Function returns queue counters
+     * @return stats
+     */
+    stats statistics() const
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        stats st = counters;
+        st.depth = queue.size();
+        return st;
+    }
+
+private:
+    struct command
+    {
+        virtual ~command() { }
+        // returns false if the command failed
+        virtual bool run(connection& conn) = 0;
+        clock::time_point queued;
+    };
+
+    template <typename F, typename R>
+    struct task_command : command
+    {
+        template <typename T>
+        explicit task_command(T&& f) : f(std::forward<T>(f)) { }
+
+        virtual bool run(connection& conn)
+        {
+            try
+            {
+                set_value(conn, std::is_void<R>());
+                return true;
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+                return false;
+            }
+        }
+
+        void set_value(connection& conn, std::false_type) { promise.set_value(f(conn)); }
+        void set_value(connection& conn, std::true_type) { f(conn); promise.set_value(); }
+
+        F f;
+        std::promise<R> promise;
+    };
+
+    template <typename Params>
+    struct callback_command : command
+    {
+        callback_command(async_connection* aconn, callback&& cb, const std::string& sql, Params&& params)
+            : aconn(aconn), cb(std::move(cb)), sql(sql), params(std::move(params))
+        {
+        }
+
+        virtual bool run(connection&)
+        {
+            materialized_result res;
+            std::exception_ptr ex;
+            try
+            {
+                res = aconn->materialize(sql, params);
+            }
+            catch (...)
+            {
+                ex = std::current_exception();
+            }
+            if (cb)
+            {
+                try
+                {
+                    cb(ex, std::move(res));
+                }
+                catch (...)
+                {
+                    // the worker thread must survive callbacks rethrowing the error
+                    return false;
+                }
+            }
+            return (nullptr == ex);
+        }
+
+        async_connection* aconn;
+        callback cb;
+        std::string sql;
+        Params params;
+    };
+
+    async_connection(const async_connection&) = delete;
+    async_connection& operator=(const async_connection&) = delete;
+
+    void enqueue(std::unique_ptr<command>&& cmd)
+    {
+        std::unique_lock<std::mutex> ul(lock);
+        auto ready = [this]() { return (stopped || queue.size() < max_queue); };
+        if (queue_tout.count() > 0)
+        {
+            if (false == not_full.wait_for(ul, queue_tout, ready))
+            {
+                counters.rejected += 1;
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Timed out waiting for a free queue slot"));
+            }
+        }
+        else
+            not_full.wait(ul, ready);
+        if (stopped)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Connection is being closed"));
+        cmd->queued = clock::now();
+        queue.push_back(std::move(cmd));
+        counters.max_depth = std::max(counters.max_depth, queue.size());
+        ul.unlock();
+        not_empty.notify_one();
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            std::unique_ptr<command> cmd;
+            {
+                std::unique_lock<std::mutex> ul(lock);
+                not_empty.wait(ul, [this]() { return (stopped || false == queue.empty()); });
+                if (queue.empty())
+                    break;
+                cmd = std::move(queue.front());
+                queue.pop_front();
+            }
+            not_full.notify_one();
+            auto start = clock::now();
+            bool ok = cmd->run(conn);
+            auto end = clock::now();
+            std::lock_guard<std::mutex> lg(lock);
+            counters.executed += 1;
+            counters.failed += (ok ? 0 : 1);
+            update(counters.wait, start - cmd->queued);
+            update(counters.run, end - start);
+        }
+        stmt.reset();
+    }
+
+    static void update(latency& lat, clock::duration d)
+    {
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        lat.count += 1;
+        lat.total += us;
+        lat.max = std::max(lat.max, us);
+    }
+
+    statement& get_statement()
+    {
+        if (false == conn.connected())
+        {
+            stmt.reset();
+            if (false == conn.connect())
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to connect"));
+        }
+        if (nullptr == stmt)
+            stmt.reset(new statement(conn.get_statement()));
+        return *stmt;
+    }
+
+    template <typename Params>
+    materialized_result materialize(const std::string& sql, Params& params)
+    {
+        materialized_result res;
+        result_set rs = execute(get_statement(), sql, params, std::make_index_sequence<std::tuple_size<Params>::value>());
+        do
+        {
+            if (rs.has_data())
+            {
+                res.result_sets.emplace_back();
+                rs.fetch_batch(std::numeric_limits<size_t>::max(), res.result_sets.back());
+            }
+            res.rows_affected += rs.rows_affected();
+        }
+        while (rs.more_results());
+        return res;
+    }
+
+    template <typename Params, size_t... I>
+    static result_set execute(statement& stmt, const std::string& sql, Params& params, std::index_sequence<I...>)
+    {
+        return stmt.execute(sql, std::get<I>(params)...);
+    }
+
+    template <typename Params>
+    static result_set execute(statement& stmt, const std::string& sql, Params&, std::index_sequence<>)
+    {
+        return stmt.execute(sql);
+    }
+
+private:
+    connection conn;
+    std::unique_ptr<statement> stmt;
+    size_t max_queue;
+    std::chrono::milliseconds queue_tout = std::chrono::milliseconds(0);
+    bool stopped = false;
+    std::deque<std::unique_ptr<command>> queue;
+    stats counters;
+    mutable std::mutex lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::thread worker;
+
+}; // async_connection
+
+} } } // namespace vgi::dbconn::dbi
+
+#endif // ASYNC_CONNECTION_HPP
@@ -0,0 +1,547 @@
+/*
+ * File:   basic_connection.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef BASIC_CONNECTION_HPP
+#define BASIC_CONNECTION_HPP
+
+#include <memory>
+#include "connection.hpp"
+
+namespace vgi { namespace dbconn { namespace dbi {
+
+template <typename Driver> class basic_statement;
+
+/**
+ * basic_result_set - is a statically dispatched counterpart of result_set for
+ * code that knows its database at compile time. It refers to the concrete
+ * driver result set (eg sqlite::result_set) which is declared final, thus all
+ * calls are direct and can be inlined. Driver is a concrete driver class, eg
+ * sqlite::driver.
+ */
+template <typename Driver>
+class basic_result_set
+{
+public:
+    using result_set_type = typename Driver::result_set_type;
+
+    bool has_data()
+    {
+        return rs_impl->has_data();
+    }
+
+    bool more_results()
+    {
+        return rs_impl->more_results();
+    }
+
+    size_t row_count() const
+    {
+        return rs_impl->row_count();
+    }
+
+    size_t rows_affected() const
+    {
+        return rs_impl->rows_affected();
+    }
+
+    size_t column_count() const
+    {
+        return rs_impl->column_count();
+    }
+
+    const std::string column_name(size_t col_idx)
+    {
+        return rs_impl->column_name(col_idx);
+    }
+
+    int column_index(const std::string& col_name)
+    {
+        return rs_impl->column_index(col_name);
+    }
+
+    bool next()
+    {
+        return rs_impl->next();
+    }
+
+    bool prev()
+    {
+        return rs_impl->prev();
+    }
+
+    bool first()
+    {
+        return rs_impl->first();
+    }
+
+    bool last()
+    {
+        return rs_impl->last();
+    }
+
+    bool is_null(size_t col_idx)
+    {
+        return rs_impl->is_null(col_idx);
+    }
+
+    bool is_null(const std::string& colname)
+    {
+        return rs_impl->is_null(rs_impl->column_index(colname));
+    }
+
+    int16_t get_type_by_index(short);
+    int16_t get_type_by_name(short);
+    uint16_t get_type_by_index(ushort);
+    uint16_t get_type_by_name(ushort);
+    int32_t get_type_by_index(int);
+    int32_t get_type_by_name(int);
+    uint32_t get_type_by_index(uint);
+    uint32_t get_type_by_name(uint);
+    int64_t get_type_by_index(long);
+    int64_t get_type_by_name(long);
+    uint64_t get_type_by_index(ulong);
+    uint64_t get_type_by_name(ulong);
+    float get_type_by_index(float);
+    float get_type_by_name(float);
+    double get_type_by_index(double);
+    double get_type_by_name(double);
+    bool get_type_by_index(bool);
+    bool get_type_by_name(bool);
+    char get_type_by_index(char);
+    char get_type_by_name(char);
+    std::string get_type_by_index(string);
+    std::string get_type_by_name(string);
+    int get_type_by_index(date);
+    int get_type_by_name(date);
+    double get_type_by_index(time);
+    double get_type_by_name(time);
+    time_t get_type_by_index(datetime);
+    time_t get_type_by_name(datetime);
+    char16_t get_type_by_index(u16char);
+    char16_t get_type_by_name(u16char);
+    std::u16string get_type_by_index(u16string);
+    std::u16string get_type_by_name(u16string);
+    std::vector<uint8_t> get_type_by_index(binary);
+    std::vector<uint8_t> get_type_by_name(binary);
+    utils::string_view get_type_by_index(string_view);
+    utils::string_view get_type_by_name(string_view);
+    utils::blob_span get_type_by_index(blob_span);
+    utils::blob_span get_type_by_name(blob_span);
+
+    void get_string(size_t col_idx, std::string& out)
+    {
+        rs_impl->get_string(col_idx, out);
+    }
+
+    void get_binary(size_t col_idx, std::vector<uint8_t>& out)
+    {
+        rs_impl->get_binary(col_idx, out);
+    }
+
+    size_t fetch_batch(size_t rows, column_batch& batch)
+    {
+        return rs_impl->fetch_batch(rows, batch);
+    }
+
+    /**
+     * Typed getters, see result_set::get(), column_handle(), get_row() and as()
+     */
+    template <typename T>
+    T get(size_t col_idx)
+    {
+        T val;
+        get_value(col_idx, val);
+        return val;
+    }
+
+    template <typename T>
+    T get(const std::string& colname)
+    {
+        return get<T>(rs_impl->column_index(colname));
+    }
+
+    template <typename T>
+    dbi::column_handle<T, basic_result_set> column_handle(const std::string& colname)
+    {
+        auto col_idx = rs_impl->column_index(colname);
+        if (col_idx < 0)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column name: ").append(colname));
+        return dbi::column_handle<T, basic_result_set>(*this, col_idx);
+    }
+
+    template <typename T>
+    T get_row()
+    {
+        T row;
+        get_row(row);
+        return row;
+    }
+
+    template <typename... Args>
+    void get_row(std::tuple<Args...>& row)
+    {
+        get_fields(row, std::index_sequence_for<Args...>());
+    }
+
+    template <typename... Args>
+    void get_row(std::tuple<Args...>&& row)
+    {
+        get_fields(row, std::index_sequence_for<Args...>());
+    }
+
+    template <typename T>
+    void get_row(T& row)
+    {
+        auto fields = row_mapping<T>::tie(row);
+        get_fields(fields, std::make_index_sequence<std::tuple_size<decltype(fields)>::value>());
+    }
+
+    template <typename T>
+    row_range<T, basic_result_set> as()
+    {
+        return row_range<T, basic_result_set>(*this);
+    }
+
+    /**
+     * Conversion operator to the concrete database result set implementation
+     * @return
+     */
+    explicit operator result_set_type&() const
+    {
+        return *rs_impl;
+    }
+
+private:
+    friend class basic_statement<Driver>;
+    basic_result_set(result_set_type* rs) : rs_impl(rs) { }
+
+    template <typename Tuple, size_t... I>
+    void get_fields(Tuple& row, std::index_sequence<I...>)
+    {
+        using expand = int[];
+        (void)expand{0, (get_value(I, std::get<I>(row)), 0)...};
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type get_value(size_t col_idx, T& val)
+    {
+        if (sizeof(T) <= sizeof(int16_t))
+            val = static_cast<T>(std::is_signed<T>::value ? rs_impl->get_short(col_idx) : rs_impl->get_ushort(col_idx));
+        else if (sizeof(T) == sizeof(int32_t))
+            val = static_cast<T>(std::is_signed<T>::value ? rs_impl->get_int(col_idx) : rs_impl->get_uint(col_idx));
+        else
+            val = static_cast<T>(std::is_signed<T>::value ? rs_impl->get_long(col_idx) : rs_impl->get_ulong(col_idx));
+    }
+
+    void get_value(size_t col_idx, bool& val) { val = rs_impl->get_bool(col_idx); }
+    void get_value(size_t col_idx, char& val) { val = rs_impl->get_char(col_idx); }
+    void get_value(size_t col_idx, char16_t& val) { val = rs_impl->get_u16char(col_idx); }
+    void get_value(size_t col_idx, float& val) { val = rs_impl->get_float(col_idx); }
+    void get_value(size_t col_idx, double& val) { val = rs_impl->get_double(col_idx); }
+    void get_value(size_t col_idx, std::string& val) { rs_impl->get_string(col_idx, val); }
+    void get_value(size_t col_idx, utils::string_view& val) { val = rs_impl->get_string_view(col_idx); }
+    void get_value(size_t col_idx, std::u16string& val) { val = rs_impl->get_u16string(col_idx); }
+    void get_value(size_t col_idx, std::vector<uint8_t>& val) { rs_impl->get_binary(col_idx, val); }
+    void get_value(size_t col_idx, utils::blob_span& val) { val = rs_impl->get_blob_span(col_idx); }
+
+private:
+    result_set_type* rs_impl;
+
+}; // basic_result_set
+
+
+//=====================================================================================
+
+
+/**
+ * basic_statement - is a statically dispatched counterpart of statement, it
+ * owns the concrete driver statement (eg sqlite::statement). The object is
+ * returned by basic_connection::get_statement() function call.
+ */
+template <typename Driver>
+class basic_statement
+{
+public:
+    using statement_type = typename Driver::statement_type;
+    using result_set_type = typename Driver::result_set_type;
+
+    basic_statement(basic_statement&& stmt) = default;
+    basic_statement& operator=(basic_statement&& stmt) = default;
+
+    void prepare(const std::string& sql)
+    {
+        stmt_impl->prepare(sql);
+    }
+
+    void call(const std::string& proc)
+    {
+        stmt_impl->call(proc);
+    }
+
+    basic_result_set<Driver> execute()
+    {
+        return basic_result_set<Driver>(static_cast<result_set_type*>(stmt_impl->execute()));
+    }
+
+    basic_result_set<Driver> execute(const std::string& sql, bool cursor = false, bool scrollable = false)
+    {
+        return basic_result_set<Driver>(static_cast<result_set_type*>(stmt_impl->execute(sql, cursor, scrollable)));
+    }
+
+    /**
+     * Function prepares SQL statement, binds parameters and runs it, see
+     * statement::execute(sql, args...)
+     */
+    template <typename... Args, typename = typename std::enable_if<(sizeof...(Args) > 0)>::type>
+    basic_result_set<Driver> execute(const std::string& sql, Args&&... args)
+    {
+        stmt_impl->prepare(sql);
+        bind(std::forward<Args>(args)...);
+        return basic_result_set<Driver>(static_cast<result_set_type*>(stmt_impl->execute()));
+    }
+
+    /**
+     * Function binds parameters by their C++ types, see statement::bind()
+     */
+    template <typename... Args>
+    basic_statement& bind(Args&&... args)
+    {
+        bind_params(std::index_sequence_for<Args...>(), std::forward<Args>(args)...);
+        return *this;
+    }
+
+    batch_result execute_batch(const column_batch& params)
+    {
+        return stmt_impl->execute_batch(params);
+    }
+
+    bool cancel()
+    {
+        return stmt_impl->cancel();
+    }
+
+    int proc_retval()
+    {
+        return stmt_impl->proc_retval();
+    }
+
+    /**
+     * Conversion operator to the concrete database statement implementation
+     * @return
+     */
+    explicit operator statement_type&() const
+    {
+        return *stmt_impl;
+    }
+
+#define set_type(t, T) set_##t(size_t col_idx, T val) { stmt_impl->set_##t(col_idx, val); }
+
+    void set_null(size_t col_idx)
+    {
+        stmt_impl->set_null(col_idx);
+    }
+
+    void set_type(short, int16_t)
+    void set_type(ushort, uint16_t)
+    void set_type(int, int32_t)
+    void set_type(uint, uint32_t)
+    void set_type(long, int64_t)
+    void set_type(ulong, uint64_t)
+    void set_type(float, float)
+    void set_type(double, double)
+    void set_type(bool, bool)
+    void set_type(char, char)
+    void set_type(string, const std::string&)
+    void set_type(string_view, utils::string_view)
+    void set_type(date, int)
+    void set_type(time, double)
+    void set_type(datetime, time_t)
+    void set_type(u16char, char16_t)
+    void set_type(u16string, const std::u16string&)
+    void set_type(binary, const std::vector<uint8_t>&)
+    void set_type(blob_span, utils::blob_span)
+
+#undef set_type
+
+    void set_string(size_t col_idx, std::string&& val)
+    {
+        stmt_impl->set_string(col_idx, std::move(val));
+    }
+
+    void set_binary(size_t col_idx, std::vector<uint8_t>&& val)
+    {
+        stmt_impl->set_binary(col_idx, std::move(val));
+    }
+
+private:
+    template <typename T> friend class basic_connection;
+
+    basic_statement(statement_type* stmt) : stmt_impl(stmt) { }
+    basic_statement(const basic_statement&) = delete;
+    basic_statement& operator=(const basic_statement&) = delete;
+
+    template <size_t... I, typename... Args>
+    void bind_params(std::index_sequence<I...>, Args&&... args)
+    {
+        int expand[] = { 0, (bind_param(I, std::forward<Args>(args)), 0)... };
+        (void)expand;
+    }
+
+    void bind_param(size_t idx, std::nullptr_t) { stmt_impl->set_null(idx); }
+    void bind_param(size_t idx, bool val) { stmt_impl->set_bool(idx, val); }
+    void bind_param(size_t idx, char val) { stmt_impl->set_char(idx, val); }
+    void bind_param(size_t idx, char16_t val) { stmt_impl->set_u16char(idx, val); }
+    void bind_param(size_t idx, float val) { stmt_impl->set_float(idx, val); }
+    void bind_param(size_t idx, double val) { stmt_impl->set_double(idx, val); }
+    void bind_param(size_t idx, const char* val) { stmt_impl->set_string(idx, std::string(val)); }
+    void bind_param(size_t idx, const std::string& val) { stmt_impl->set_string(idx, val); }
+    void bind_param(size_t idx, std::string&& val) { stmt_impl->set_string(idx, std::move(val)); }
+    void bind_param(size_t idx, utils::string_view val) { stmt_impl->set_string_view(idx, val); }
+    void bind_param(size_t idx, const std::u16string& val) { stmt_impl->set_u16string(idx, val); }
+    void bind_param(size_t idx, const std::vector<uint8_t>& val) { stmt_impl->set_binary(idx, val); }
+    void bind_param(size_t idx, std::vector<uint8_t>&& val) { stmt_impl->set_binary(idx, std::move(val)); }
+    void bind_param(size_t idx, utils::blob_span val) { stmt_impl->set_blob_span(idx, val); }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value && !std::is_same<T, char16_t>::value>::type
+    bind_param(size_t idx, T val)
+    {
+        if (sizeof(T) <= sizeof(int16_t))
+            std::is_signed<T>::value ? stmt_impl->set_short(idx, val) : stmt_impl->set_ushort(idx, val);
+        else if (sizeof(T) <= sizeof(int32_t))
+            std::is_signed<T>::value ? stmt_impl->set_int(idx, val) : stmt_impl->set_uint(idx, val);
+        else
+            std::is_signed<T>::value ? stmt_impl->set_long(idx, val) : stmt_impl->set_ulong(idx, val);
+    }
+
+private:
+    std::unique_ptr<statement_type> stmt_impl;
+
+}; // basic_statement
+
+
+//=====================================================================================
+
+
+/**
+ * basic_connection - is a statically dispatched counterpart of connection, it
+ * takes over the concrete driver connection (eg sqlite::connection) from the
+ * connection object returned by the driver, eg:
+ *     basic_connection<sqlite::driver> conn(driver<sqlite::driver>::load().get_connection(":memory:"));
+ * The concrete objects are owned through pointers to their final types so
+ * that moving the basic_ objects does not invalidate references held by the
+ * driver between connection, statement and result set.
+ */
+template <typename Driver>
+class basic_connection
+{
+public:
+    using connection_type = typename Driver::connection_type;
+    using statement_type = typename Driver::statement_type;
+
+    /**
+     * Constructor takes ownership of the native connection handle, the
+     * connection object is left without one. An exception is thrown if the
+     * connection was created by a different driver.
+     * @param conn
+     */
+    explicit basic_connection(connection&& conn) : conn_impl(&dynamic_cast<connection_type&>(*conn.conn_impl))
+    {
+        conn.conn_impl.release();
+    }
+
+    basic_connection(basic_connection&& conn) = default;
+    basic_connection& operator=(basic_connection&& conn) = default;
+
+    ~basic_connection()
+    {
+        if (conn_impl)
+            disconnect();
+    }
+
+    bool connect()
+    {
+        return conn_impl->connect();
+    }
+
+    void disconnect()
+    {
+        conn_impl->disconnect();
+    }
+
+    void autocommit(bool ac)
+    {
+        conn_impl->autocommit(ac);
+    }
+
+    void commit()
+    {
+        conn_impl->commit();
+    }
+
+    void rollback()
+    {
+        conn_impl->rollback();
+    }
+
+    bool connected() const
+    {
+        return conn_impl->connected();
+    }
+
+    bool alive() const
+    {
+        return conn_impl->alive();
+    }
+
+    void statement_cache(size_t capacity)
+    {
+        conn_impl->statement_cache(capacity);
+    }
+
+    cache_stats statement_cache_stats() const
+    {
+        return conn_impl->statement_cache_stats();
+    }
+
+    basic_statement<Driver> get_statement()
+    {
+        return basic_statement<Driver>(static_cast<statement_type*>(conn_impl->get_statement(*conn_impl)));
+    }
+
+    /**
+     * Conversion operator to the concrete database connection implementation
+     * @return
+     */
+    explicit operator connection_type&() const
+    {
+        return *conn_impl;
+    }
+
+private:
+    basic_connection(const basic_connection&) = delete;
+    basic_connection& operator=(const basic_connection&) = delete;
+
+private:
+    std::unique_ptr<connection_type> conn_impl;
+
+}; // basic_connection
+
+} } } // namespace vgi::dbconn::dbi
+
+#endif // BASIC_CONNECTION_HPP
@@ -31,6 +31,21 @@ namespace vgi { namespace dbconn { namespace dbd {
 
 namespace vgi { namespace dbconn { namespace dbi {
 
+template <typename Driver> class basic_connection;
+
+/**
+ * cache_stats - prepared statement cache counters
+ */
+struct cache_stats
+{
+    size_t size = 0;
+    size_t capacity = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+};
+
+
 /**
  * iconnection - is an interface that describes common functionality for all
  * concrete native implementations for a connection class
@@ -46,6 +61,8 @@ struct iconnection
     virtual bool connected() const = 0;
     virtual bool alive() const = 0;
     virtual istatement* get_statement(iconnection&) = 0;
+    virtual void statement_cache(size_t capacity) = 0;
+    virtual cache_stats statement_cache_stats() const = 0;
 };
 
 
@@ -87,7 +104,8 @@ public:
      */
     ~connection()
     {
-        disconnect();
+        if (conn_impl)
+            disconnect();
     }
 
     /**
@@ -150,6 +168,26 @@ public:
         return conn_impl->alive();
     }
 
+    /**
+     * Function sets maximum number of prepared statements cached by the
+     * connection, zero disables the cache (default). Cached statements are
+     * reused by statements executing or preparing the same SQL text.
+     * @param capacity
+     */
+    void statement_cache(size_t capacity)
+    {
+        conn_impl->statement_cache(capacity);
+    }
+
+    /**
+     * Function returns prepared statement cache counters
+     * @return cache_stats
+     */
+    cache_stats statement_cache_stats() const
+    {
+        return conn_impl->statement_cache_stats();
+    }
+
     /**
      * Function returns statement object for the connection
      * @return 
@@ -173,6 +211,7 @@ public:
 
 private:
     template <typename T> friend class dbd::driver;
+    template <typename T> friend class basic_connection;
     friend class statement;
 
     connection(iconnection* conn) : conn_impl(conn) { }
@@ -0,0 +1,490 @@
+/*
+ * File:   connection_pool.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "connection.hpp"
+
+namespace vgi { namespace dbconn { namespace dbi {
+
+/**
+ * connection_pool - is a thread-safe pool of connection objects, the connections
+ * are created by user supplied factory function which is usually a wrap around
+ * concrete driver get_connection() call, eg:
+ *
+ *     connection_pool pool([]() { return driver<sqlite::driver>::load().get_connection("test.db"); });
+ *     pool.min_size(2).max_size(8);
+ *
+ * Connections are borrowed from the pool with get() function call which returns
+ * a handle object. The handle returns connection back to the pool as soon as it
+ * goes out of scope. Connections that are dead, idle for too long or have
+ * exceeded their maximum lifetime are closed instead of being handed out again.
+ * connection_pool object must outlive all handles borrowed from it.
+ */
+class connection_pool
+{
+    using clock = std::chrono::steady_clock;
+
+    struct pooled_connection
+    {
+        connection conn;
+        clock::time_point created;
+        clock::time_point returned;
+    };
+
+public:
+    /**
+     * handle - is a RAII wrap around borrowed connection, connection is returned
+     * back to the pool on handle destruction or on release() function call
+     */
+    class handle
+    {
+    public:
+        handle(handle&& h) : pool(h.pool), pconn(std::move(h.pconn))
+        {
+            h.pool = nullptr;
+        }
+
+        handle& operator=(handle&& h)
+        {
+            if (this != &h)
+            {
+                release();
+                pool = h.pool;
+                pconn = std::move(h.pconn);
+                h.pool = nullptr;
+            }
+            return *this;
+        }
+
+        ~handle()
+        {
+            release();
+        }
+
+        connection& operator*() const
+        {
+            return get();
+        }
+
+        connection* operator->() const
+        {
+            return &get();
+        }
+
+        connection& get() const
+        {
+            if (nullptr == pconn)
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Connection handle is empty"));
+            return pconn->conn;
+        }
+
+        /**
+         * Function returns connection back to the pool
+         */
+        void release()
+        {
+            if (nullptr != pool && nullptr != pconn)
+                pool->put(std::move(pconn), false);
+            pool = nullptr;
+        }
+
+        /**
+         * Function closes borrowed connection instead of returning it back to
+         * the pool, it should be used when connection is known to be broken
+         */
+        void invalidate()
+        {
+            if (nullptr != pool && nullptr != pconn)
+                pool->put(std::move(pconn), true);
+            pool = nullptr;
+        }
+
+    private:
+        friend class connection_pool;
+        handle(connection_pool* pool, std::unique_ptr<pooled_connection>&& pconn) : pool(pool), pconn(std::move(pconn)) { }
+        handle(const handle&) = delete;
+        handle& operator=(const handle&) = delete;
+
+    private:
+        connection_pool* pool = nullptr;
+        std::unique_ptr<pooled_connection> pconn;
+    }; // handle
+
+    /**
+     * stats - pool counters snapshot
+     */
+    struct stats
+    {
+        size_t idle = 0;
+        size_t borrowed = 0;
+        size_t waiting = 0;
+        size_t created = 0;
+        size_t closed = 0;
+        size_t timeouts = 0;
+    };
+
+    /**
+     * Constructor
+     * @param factory function that returns new (not yet connected) connection
+     */
+    explicit connection_pool(std::function<connection()> factory) : factory(std::move(factory))
+    {
+        if (!this->factory)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Connection factory function is not set"));
+    }
+
+    ~connection_pool()
+    {
+        std::vector<std::unique_ptr<pooled_connection>> tmp;
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            tmp.swap(idle);
+        }
+    }
+
+    /**
+     * Function sets minimum number of connections kept open by reap()
+     * @param size
+     * @return
+     */
+    connection_pool& min_size(size_t size)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        if (size > max_conn)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Minimum size is greater than maximum size"));
+        min_conn = size;
+        return *this;
+    }
+
+    /**
+     * Function sets maximum number of opened (idle and borrowed) connections
+     * @param size
+     * @return
+     */
+    connection_pool& max_size(size_t size)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        if (size == 0 || size < min_conn)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Maximum size must be greater than zero and minimum size"));
+        max_conn = size;
+        return *this;
+    }
+
+    /**
+     * Function sets time after which idle connections above minimum size are closed,
+     * zero means idle connections are never closed
+     * @param timeout
+     * @return
+     */
+    connection_pool& idle_timeout(std::chrono::milliseconds timeout)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        idle_tout = timeout;
+        return *this;
+    }
+
+    /**
+     * Function sets maximum lifetime of a connection, zero means unlimited
+     * @param lifetime
+     * @return
+     */
+    connection_pool& max_lifetime(std::chrono::milliseconds lifetime)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        max_life = lifetime;
+        return *this;
+    }
+
+    /**
+     * Function sets default time get() waits for a free connection when pool
+     * has reached its maximum size
+     * @param timeout
+     * @return
+     */
+    connection_pool& borrow_timeout(std::chrono::milliseconds timeout)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        borrow_tout = timeout;
+        return *this;
+    }
+
+    /**
+     * Function borrows connection from the pool waiting up to default borrow timeout
+     * @return connection handle or exception is thrown on timeout
+     */
+    handle get()
+    {
+        std::chrono::milliseconds tout;
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            tout = borrow_tout;
+        }
+        return get(tout);
+    }
+
+    /**
+     * Function borrows connection from the pool, most recently used idle
+     * connection is returned first, new connection is opened if there are no idle
+     * connections and pool has not reached its maximum size
+     * @param timeout
+     * @return connection handle or exception is thrown on timeout
+     */
+    handle get(std::chrono::milliseconds timeout)
+    {
+        auto deadline = clock::now() + timeout;
+        std::vector<std::unique_ptr<pooled_connection>> expired;
+        std::unique_lock<std::mutex> ul(lock);
+        while (true)
+        {
+            auto now = clock::now();
+            collect_expired(now, expired);
+            while (false == idle.empty())
+            {
+                std::unique_ptr<pooled_connection> pconn = std::move(idle.back());
+                idle.pop_back();
+                if (is_expired(*pconn, now) || false == pconn->conn.alive())
+                {
+                    expired.push_back(std::move(pconn));
+                    continue;
+                }
+                borrowed += 1;
+                ul.unlock();
+                close(expired);
+                return handle(this, std::move(pconn));
+            }
+            if (total < max_conn)
+            {
+                total += 1;
+                ul.unlock();
+                close(expired);
+                return handle(this, open());
+            }
+            if (false == expired.empty())
+            {
+                ul.unlock();
+                close(expired);
+                ul.lock();
+                continue;
+            }
+            waiting += 1;
+            auto st = cond.wait_until(ul, deadline);
+            waiting -= 1;
+            if (std::cv_status::timeout == st && idle.empty() && total >= max_conn)
+            {
+                timeouts += 1;
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Timed out waiting for a free connection"));
+            }
+        }
+    }
+
+    /**
+     * Function closes idle connections which exceeded idle timeout or maximum
+     * lifetime and then opens new connections up to the minimum pool size.
+     * It is intended to be called periodically, eg from a maintenance thread.
+     */
+    void reap()
+    {
+        std::vector<std::unique_ptr<pooled_connection>> expired;
+        size_t to_open = 0;
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            auto now = clock::now();
+            for (auto it = idle.begin(); it != idle.end();)
+            {
+                if (is_expired(**it, now) || false == (*it)->conn.alive())
+                {
+                    expired.push_back(std::move(*it));
+                    it = idle.erase(it);
+                }
+                else
+                    ++it;
+            }
+            total -= expired.size();
+            auto cnt = expired.size();
+            collect_expired(now, expired);
+            total -= expired.size() - cnt;
+            closed += expired.size();
+            if (total < min_conn)
+            {
+                to_open = min_conn - total;
+                total = min_conn;
+            }
+        }
+        expired.clear();
+        for (size_t i = 0; i < to_open; ++i)
+        {
+            try
+            {
+                put(open(), false);
+            }
+            catch (...)
+            {
+                // open() has released its own slot, release the rest of reserved slots
+                {
+                    std::lock_guard<std::mutex> lg(lock);
+                    total -= to_open - i - 1;
+                }
+                cond.notify_all();
+                throw;
+            }
+        }
+    }
+
+    /**
+     * Function returns pool counters
+     * @return stats
+     */
+    stats statistics() const
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        stats st;
+        st.idle = idle.size();
+        st.borrowed = borrowed;
+        st.waiting = waiting;
+        st.created = created;
+        st.closed = closed;
+        st.timeouts = timeouts;
+        return st;
+    }
+
+private:
+    connection_pool(const connection_pool&) = delete;
+    connection_pool& operator=(const connection_pool&) = delete;
+
+    /**
+     * Function opens new connection, the pool slot must be already reserved by
+     * the caller and it's released if connection can't be opened
+     */
+    std::unique_ptr<pooled_connection> open()
+    {
+        try
+        {
+            auto now = clock::now();
+            std::unique_ptr<pooled_connection> pconn(new pooled_connection{factory(), now, now});
+            if (false == pconn->conn.connect())
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to connect"));
+            std::lock_guard<std::mutex> lg(lock);
+            created += 1;
+            borrowed += 1;
+            return pconn;
+        }
+        catch (...)
+        {
+            {
+                std::lock_guard<std::mutex> lg(lock);
+                total -= 1;
+            }
+            cond.notify_one();
+            throw;
+        }
+    }
+
+    void put(std::unique_ptr<pooled_connection>&& pconn, bool discard)
+    {
+        auto now = clock::now();
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            borrowed -= 1;
+            if (false == discard && false == (max_life.count() > 0 && now - pconn->created >= max_life) && pconn->conn.alive())
+            {
+                pconn->returned = now;
+                idle.push_back(std::move(pconn));
+            }
+            else
+            {
+                total -= 1;
+                closed += 1;
+            }
+        }
+        cond.notify_one();
+        // connection is closed (if it was not returned back) outside of the lock
+        pconn.reset();
+    }
+
+    bool is_expired(const pooled_connection& pconn, clock::time_point now) const
+    {
+        return (max_life.count() > 0 && now - pconn.created >= max_life);
+    }
+
+    /**
+     * Function moves connections which are idle for longer than idle timeout
+     * out of the idle list, connections are kept in LRU order thus the oldest
+     * are at the front. Lock must be held by the caller.
+     */
+    void collect_expired(clock::time_point now, std::vector<std::unique_ptr<pooled_connection>>& expired)
+    {
+        if (idle_tout.count() <= 0)
+            return;
+        auto cnt = 0U;
+        auto keep = (total > min_conn ? total - min_conn : 0);
+        while (cnt < idle.size() && cnt < keep && now - idle[cnt]->returned >= idle_tout)
+            ++cnt;
+        if (cnt > 0)
+        {
+            for (auto i = 0U; i < cnt; ++i)
+                expired.push_back(std::move(idle[i]));
+            idle.erase(idle.begin(), idle.begin() + cnt);
+        }
+    }
+
+    /**
+     * Function closes connections outside of the lock
+     */
+    void close(std::vector<std::unique_ptr<pooled_connection>>& expired)
+    {
+        if (expired.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            total -= expired.size();
+            closed += expired.size();
+        }
+        expired.clear();
+        cond.notify_all();
+    }
+
+private:
+    std::function<connection()> factory;
+    size_t min_conn = 0;
+    size_t max_conn = UINT_MAX;
+    size_t total = 0;
+    size_t borrowed = 0;
+    size_t waiting = 0;
+    size_t created = 0;
+    size_t closed = 0;
+    size_t timeouts = 0;
+    std::chrono::milliseconds idle_tout = std::chrono::milliseconds(0);
+    std::chrono::milliseconds max_life = std::chrono::milliseconds(0);
+    std::chrono::milliseconds borrow_tout = std::chrono::milliseconds(30000);
+    std::vector<std::unique_ptr<pooled_connection>> idle;
+    mutable std::mutex lock;
+    std::condition_variable cond;
+}; // connection_pool
+
+} } } // namespace vgi::dbconn::dbi
+
+#endif // CONNECTION_POOL_HPP
@@ -0,0 +1,482 @@
+/*
+ * File:   coroutine.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef COROUTINE_HPP
+#define COROUTINE_HPP
+
+// c++20 coroutines are required, the header is empty otherwise
+#if __cplusplus > 201703L && defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "connection.hpp"
+
+namespace vgi { namespace dbconn { namespace dbi {
+
+/**
+ * executor - is an interface of executors running blocking database calls
+ * made by coroutines, a coroutine awaiting a call is resumed by the executor
+ * thread once the call has completed
+ */
+struct executor
+{
+    virtual ~executor() { }
+    virtual void post(std::function<void()> f) = 0;
+};
+
+
+/**
+ * thread_pool_executor - is an executor with a fixed number of threads which
+ * offload blocking calls from coroutine threads (default executor for sqlite)
+ */
+class thread_pool_executor : public executor
+{
+public:
+    explicit thread_pool_executor(size_t threads = std::thread::hardware_concurrency())
+    {
+        for (size_t i = 0; i < std::max<size_t>(1, threads); ++i)
+            workers.emplace_back(&thread_pool_executor::run, this);
+    }
+
+    ~thread_pool_executor()
+    {
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            stopped = true;
+        }
+        cond.notify_all();
+        for (auto& t : workers)
+            t.join();
+    }
+
+    virtual void post(std::function<void()> f)
+    {
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            if (stopped)
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Executor is stopped"));
+            queue.push_back(std::move(f));
+        }
+        cond.notify_one();
+    }
+
+private:
+    thread_pool_executor(const thread_pool_executor&) = delete;
+    thread_pool_executor& operator=(const thread_pool_executor&) = delete;
+
+    void run()
+    {
+        while (true)
+        {
+            std::function<void()> f;
+            {
+                std::unique_lock<std::mutex> ul(lock);
+                cond.wait(ul, [this]() { return (stopped || false == queue.empty()); });
+                if (queue.empty())
+                    return;
+                f = std::move(queue.front());
+                queue.pop_front();
+            }
+            f();
+        }
+    }
+
+private:
+    bool stopped = false;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable cond;
+}; // thread_pool_executor
+
+
+//=====================================================================================
+
+
+template <typename T = void> class task;
+
+namespace detail {
+
+    struct task_promise_base
+    {
+        struct final_awaiter
+        {
+            bool await_ready() noexcept { return false; }
+
+            template <typename P>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+            {
+                auto cont = h.promise().continuation;
+                return (cont ? cont : std::noop_coroutine());
+            }
+
+            void await_resume() noexcept { }
+        };
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        final_awaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { ex = std::current_exception(); }
+
+        std::coroutine_handle<> continuation;
+        std::exception_ptr ex;
+    };
+
+    template <typename T>
+    struct task_promise : task_promise_base
+    {
+        task<T> get_return_object();
+        void return_value(T val) { value.emplace(std::move(val)); }
+
+        T result()
+        {
+            if (ex)
+                std::rethrow_exception(ex);
+            return std::move(*value);
+        }
+
+        std::optional<T> value;
+    };
+
+    template <>
+    struct task_promise<void> : task_promise_base
+    {
+        task<void> get_return_object();
+        void return_void() { }
+
+        void result()
+        {
+            if (ex)
+                std::rethrow_exception(ex);
+        }
+    };
+
+    /**
+     * offload - is an awaiter which runs a blocking call on the executor and
+     * resumes the awaiting coroutine on the executor thread
+     */
+    template <typename F>
+    class offload
+    {
+        using result_type = decltype(std::declval<F&>()());
+
+    public:
+        offload(executor& ex, F&& f) : ex(ex), f(std::move(f)) { }
+
+        bool await_ready() { return false; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            ex.post([this, h]()
+            {
+                try
+                {
+                    res.emplace(f());
+                }
+                catch (...)
+                {
+                    err = std::current_exception();
+                }
+                h.resume();
+            });
+        }
+
+        result_type await_resume()
+        {
+            if (err)
+                std::rethrow_exception(err);
+            return std::move(*res);
+        }
+
+    private:
+        executor& ex;
+        F f;
+        std::optional<result_type> res;
+        std::exception_ptr err;
+    };
+
+    template <typename F>
+    offload<F> make_offload(executor& ex, F&& f)
+    {
+        return offload<F>(ex, std::forward<F>(f));
+    }
+
+    struct detached
+    {
+        struct promise_type
+        {
+            detached get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() { }
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+} // namespace detail
+
+
+/**
+ * task - is a lazily started coroutine returning value of type T, it starts
+ * when it is awaited (co_await), by sync_wait() or spawn() function calls
+ */
+template <typename T>
+class task
+{
+public:
+    using promise_type = detail::task_promise<T>;
+
+    task(task&& t) noexcept : handle(std::exchange(t.handle, nullptr)) { }
+
+    task& operator=(task&& t) noexcept
+    {
+        if (this != &t)
+        {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(t.handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    auto operator co_await() noexcept
+    {
+        struct awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept
+            {
+                handle.promise().continuation = h;
+                return handle;
+            }
+
+            T await_resume() { return handle.promise().result(); }
+        };
+        return awaiter{handle};
+    }
+
+private:
+    friend promise_type;
+    explicit task(std::coroutine_handle<promise_type> h) : handle(h) { }
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+private:
+    std::coroutine_handle<promise_type> handle;
+}; // task
+
+namespace detail {
+
+    template <typename T>
+    task<T> task_promise<T>::get_return_object()
+    {
+        return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+    }
+
+    inline task<void> task_promise<void>::get_return_object()
+    {
+        return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+    }
+
+} // namespace detail
+
+
+/**
+ * Function runs the task and blocks calling thread until the task completes
+ * @param t
+ * @return task result
+ */
+template <typename T>
+T sync_wait(task<T> t)
+{
+    std::mutex m;
+    std::condition_variable cond;
+    bool done = false;
+    std::optional<std::conditional_t<std::is_void<T>::value, bool, T>> res;
+    std::exception_ptr err;
+    auto d = [](task<T>& t, auto& res, std::exception_ptr& err, std::mutex& m, std::condition_variable& cond, bool& done) -> detail::detached
+    {
+        try
+        {
+            if constexpr (std::is_void<T>::value)
+            {
+                co_await t;
+                res.emplace(true);
+            }
+            else
+                res.emplace(co_await t);
+        }
+        catch (...)
+        {
+            err = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lg(m);
+        done = true;
+        cond.notify_all();
+    }(t, res, err, m, cond, done);
+    d.handle.resume();
+    std::unique_lock<std::mutex> ul(m);
+    cond.wait(ul, [&done]() { return done; });
+    if (err)
+        std::rethrow_exception(err);
+    if constexpr (false == std::is_void<T>::value)
+        return std::move(*res);
+}
+
+/**
+ * Function starts the task on the executor without waiting for it, the task
+ * must handle its exceptions (std::terminate() is called otherwise)
+ * @param ex
+ * @param t
+ */
+inline void spawn(executor& ex, task<void> t)
+{
+    auto d = [](task<void> t) -> detail::detached { co_await t; }(std::move(t));
+    ex.post([h = d.handle]() { h.resume(); });
+}
+
+
+//=====================================================================================
+
+
+/**
+ * co_result_set - is a result set of a statement executed by co_statement,
+ * row fetching is awaitable, while cell getters are called directly on the
+ * result set once the row is fetched, eg:
+ *
+ *     co_result_set rs = co_await stmt.co_execute("select id from test");
+ *     while (co_await rs.next_async())
+ *         std::cout << rs->get_int(0);
+ *
+ * fetch_batch_async() fetches many rows per executor round trip.
+ */
+class co_result_set
+{
+public:
+    auto next_async()
+    {
+        return detail::make_offload(*ex, [this]() { return rs.next(); });
+    }
+
+    auto more_results_async()
+    {
+        return detail::make_offload(*ex, [this]() { return rs.more_results(); });
+    }
+
+    auto fetch_batch_async(size_t rows, column_batch& batch)
+    {
+        return detail::make_offload(*ex, [this, rows, &batch]() { return rs.fetch_batch(rows, batch); });
+    }
+
+    result_set& operator*()
+    {
+        return rs;
+    }
+
+    result_set* operator->()
+    {
+        return &rs;
+    }
+
+private:
+    friend class co_statement;
+    co_result_set(result_set&& rs, executor* ex) : rs(std::move(rs)), ex(ex) { }
+
+private:
+    result_set rs;
+    executor* ex;
+}; // co_result_set
+
+
+/**
+ * co_statement - is a statement with awaitable execution, blocking calls are
+ * made on the executor threads so that coroutine threads are not blocked.
+ * co_statement and the executor must outlive all pending awaits.
+ */
+class co_statement
+{
+public:
+    co_statement(statement&& stmt, executor& ex) : stmt(std::move(stmt)), ex(&ex)
+    {
+    }
+
+    /**
+     * Function runs SQL statement, see statement::execute(sql, args...)
+     * @param sql
+     * @param args parameter values, copied into the awaiter
+     * @return awaitable co_result_set
+     */
+    template <typename... Args>
+    auto co_execute(const std::string& sql, Args&&... args)
+    {
+        return detail::make_offload(*ex, [this, sql, params = std::make_tuple(std::forward<Args>(args)...)]() mutable
+        {
+            return co_result_set(std::apply([this, &sql](auto&... a) { return stmt.execute(sql, a...); }, params), ex);
+        });
+    }
+
+    /**
+     * Function runs last prepared statement
+     * @return awaitable co_result_set
+     */
+    auto co_execute()
+    {
+        return detail::make_offload(*ex, [this]() { return co_result_set(stmt.execute(), ex); });
+    }
+
+    statement& operator*()
+    {
+        return stmt;
+    }
+
+    statement* operator->()
+    {
+        return &stmt;
+    }
+
+private:
+    statement stmt;
+    executor* ex;
+}; // co_statement
+
+} } } // namespace vgi::dbconn::dbi
+
+#endif // c++20 coroutines
+
+#endif // COROUTINE_HPP
@@ -0,0 +1,476 @@
+/*
+ * File:   parallel.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "result_set.hpp"
+
+namespace vgi { namespace dbconn { namespace dbi {
+
+/**
+ * parallel_options - options of parallel_for_each() function
+ */
+struct parallel_options
+{
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());  // worker threads
+    size_t batch_rows = 1024;   // rows fetched into one batch
+    size_t batches = 0;         // batches in flight (fetch backpressure), zero means 2 x threads
+    bool ordered = false;       // reduce batch results in row order (for non-commutative reduce)
+};
+
+
+/**
+ * batch_row - is a row of a column batch passed to parallel_for_each()
+ * function, getters convert values the same way as result_set getters do for
+ * integral, floating point, text and binary columns
+ */
+class batch_row
+{
+public:
+    batch_row(const column_batch& batch, size_t row, size_t row_num) : batch(&batch), row(row), row_num(row_num) { }
+
+    /**
+     * Function returns zero based row number in the result set
+     * @return
+     */
+    size_t row_number() const
+    {
+        return row_num;
+    }
+
+    size_t column_count() const
+    {
+        return batch->columns.size();
+    }
+
+    bool is_null(size_t col_idx) const
+    {
+        return column(col_idx).is_null(row);
+    }
+
+    int32_t get_int(size_t col_idx) const
+    {
+        return static_cast<int32_t>(column(col_idx).to_long(row));
+    }
+
+    int64_t get_long(size_t col_idx) const
+    {
+        return column(col_idx).to_long(row);
+    }
+
+    double get_double(size_t col_idx) const
+    {
+        return column(col_idx).to_double(row);
+    }
+
+    bool get_bool(size_t col_idx) const
+    {
+        return (0 != column(col_idx).to_long(row));
+    }
+
+    std::string get_string(size_t col_idx) const
+    {
+        std::string str;
+        column(col_idx).to_string(row, str);
+        return str;
+    }
+
+    utils::string_view get_string_view(size_t col_idx) const
+    {
+        auto& col = text_column(col_idx);
+        return utils::string_view(col.data(row), col.length(row));
+    }
+
+    utils::blob_span get_blob_span(size_t col_idx) const
+    {
+        auto& col = text_column(col_idx);
+        return utils::blob_span(reinterpret_cast<const uint8_t*>(col.data(row)), col.length(row));
+    }
+
+private:
+    const column_batch::column& column(size_t col_idx) const
+    {
+        if (col_idx >= batch->columns.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column index"));
+        return batch->columns[col_idx];
+    }
+
+    const column_batch::column& text_column(size_t col_idx) const
+    {
+        auto& col = column(col_idx);
+        if (data_type::TEXT != col.type && data_type::BLOB != col.type)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type (supported: text, binary)"));
+        return col;
+    }
+
+private:
+    const column_batch* batch;
+    size_t row;
+    size_t row_num;
+}; // batch_row
+
+
+namespace detail {
+
+    /**
+     * batch_pool - is a pool of worker threads with a work stealing queue per
+     * worker. The calling thread fetches rows into column batches and deals
+     * them round robin to the worker queues, a worker takes batches from the
+     * back of its own queue and steals from the front of the others when it
+     * runs out of work. Processed batches are returned to the free list and
+     * refilled by the fetching thread.
+     */
+    template <typename Worker>
+    class batch_pool
+    {
+        struct job
+        {
+            column_batch* batch;
+            size_t seq;
+            size_t first_row;
+        };
+
+        struct job_queue
+        {
+            std::mutex lock;
+            std::deque<job> jobs;
+        };
+
+    public:
+        batch_pool(const parallel_options& opts, std::vector<Worker>& workers)
+            : opts(opts), workers(workers), queues(workers.size()),
+              batches(std::max<size_t>(2, (0 == opts.batches ? 2 * workers.size() : opts.batches)))
+        {
+            for (auto& b : batches)
+                free_list.push_back(&b);
+        }
+
+        void run(result_set& rs)
+        {
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < workers.size(); ++i)
+                threads.emplace_back(&batch_pool::work, this, i);
+            try
+            {
+                fetch(rs);
+            }
+            catch (...)
+            {
+                fail(std::current_exception());
+            }
+            {
+                std::lock_guard<std::mutex> lg(lock);
+                finished = true;
+            }
+            work_cond.notify_all();
+            for (auto& t : threads)
+                t.join();
+            if (error)
+                std::rethrow_exception(error);
+        }
+
+    private:
+        void fetch(result_set& rs)
+        {
+            size_t seq = 0;
+            size_t row_num = 0;
+            while (false == stopped.load(std::memory_order_relaxed))
+            {
+                column_batch* batch = nullptr;
+                {
+                    std::unique_lock<std::mutex> ul(lock);
+                    free_cond.wait(ul, [this]() { return (false == free_list.empty() || stopped.load(std::memory_order_relaxed)); });
+                    if (free_list.empty())
+                        return;
+                    batch = free_list.back();
+                    free_list.pop_back();
+                }
+                if (0 == rs.fetch_batch(opts.batch_rows, *batch))
+                    return;
+                check_columns(*batch, 0 == seq);
+                auto& q = queues[seq % queues.size()];
+                {
+                    std::lock_guard<std::mutex> lg(q.lock);
+                    q.jobs.push_back(job{batch, seq, row_num});
+                }
+                row_num += batch->rows;
+                ++seq;
+                {
+                    std::lock_guard<std::mutex> lg(lock);
+                    ++available;
+                }
+                work_cond.notify_one();
+            }
+        }
+
+        /**
+         * Function checks that the batch has the columns of the first batch,
+         * fetch_batch() stops at the end of the data set, so a different
+         * layout means the driver crossed into the next one
+         * @param batch
+         * @param first
+         */
+        void check_columns(const column_batch& batch, bool first)
+        {
+            if (first)
+            {
+                columns.clear();
+                for (auto& col : batch.columns)
+                    columns.push_back(col.name);
+                return;
+            }
+            bool same = (columns.size() == batch.columns.size());
+            for (size_t i = 0; same && i < columns.size(); ++i)
+                same = (columns[i] == batch.columns[i].name);
+            if (false == same)
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Columns changed between batches of the data set"));
+        }
+
+        void work(size_t idx)
+        {
+            job j;
+            while (true)
+            {
+                if (pop(idx, j))
+                {
+                    try
+                    {
+                        if (false == stopped.load(std::memory_order_relaxed))
+                            workers[idx](*j.batch, j.seq, j.first_row);
+                    }
+                    catch (...)
+                    {
+                        fail(std::current_exception());
+                    }
+                    {
+                        std::lock_guard<std::mutex> lg(lock);
+                        free_list.push_back(j.batch);
+                    }
+                    free_cond.notify_one();
+                    continue;
+                }
+                std::unique_lock<std::mutex> ul(lock);
+                work_cond.wait(ul, [this]() { return (finished || available > 0); });
+                if (finished && 0 == available)
+                    return;
+            }
+        }
+
+        bool pop(size_t idx, job& j)
+        {
+            for (size_t i = 0; i < queues.size(); ++i)
+            {
+                auto& q = queues[(idx + i) % queues.size()];
+                std::lock_guard<std::mutex> lg(q.lock);
+                if (q.jobs.empty())
+                    continue;
+                if (0 == i)
+                {
+                    j = q.jobs.back();
+                    q.jobs.pop_back();
+                }
+                else
+                {
+                    j = q.jobs.front();
+                    q.jobs.pop_front();
+                }
+                std::lock_guard<std::mutex> glg(lock);
+                --available;
+                return true;
+            }
+            return false;
+        }
+
+        void fail(std::exception_ptr ex)
+        {
+            {
+                std::lock_guard<std::mutex> lg(lock);
+                if (nullptr == error)
+                    error = ex;
+                stopped.store(true, std::memory_order_relaxed);
+            }
+            free_cond.notify_all();
+        }
+
+    private:
+        const parallel_options& opts;
+        std::vector<Worker>& workers;
+        std::vector<job_queue> queues;
+        std::deque<column_batch> batches;
+        std::vector<column_batch*> free_list;
+        std::vector<std::string> columns;
+        size_t available = 0;
+        bool finished = false;
+        std::atomic<bool> stopped{false};
+        std::exception_ptr error;
+        std::mutex lock;
+        std::condition_variable work_cond;
+        std::condition_variable free_cond;
+    }; // batch_pool
+
+    template <typename F>
+    struct for_each_worker
+    {
+        void operator()(const column_batch& batch, size_t, size_t first_row)
+        {
+            for (size_t i = 0; i < batch.rows; ++i)
+                (*fn)(batch_row(batch, i, first_row + i));
+        }
+
+        F* fn;
+    };
+
+    template <typename T, typename F, typename R>
+    struct reduce_worker
+    {
+        /**
+         * partial - is a reduced value of a range of rows, the first row value
+         * starts the range so that no identity value of reduce is required
+         */
+        struct partial
+        {
+            bool empty = true;
+            T value;
+
+            void add(R& reduce, T&& val)
+            {
+                if (empty)
+                    value = std::move(val);
+                else
+                    value = reduce(std::move(value), std::move(val));
+                empty = false;
+            }
+        };
+
+        /**
+         * merger - is the state shared by workers with ordered option, batch
+         * results are reduced in batch sequence order as they become available
+         */
+        struct merger
+        {
+            std::mutex lock;
+            std::map<size_t, T> pending;
+            size_t next_seq = 0;
+            partial total;
+        };
+
+        void operator()(const column_batch& batch, size_t seq, size_t first_row)
+        {
+            partial part;
+            auto& acc = (nullptr == merge ? local : part);
+            for (size_t i = 0; i < batch.rows; ++i)
+                acc.add(*reduce, (*fn)(batch_row(batch, i, first_row + i)));
+            if (nullptr == merge)
+                return;
+            // fetched batches are never empty, so every batch yields a value
+            std::lock_guard<std::mutex> lg(merge->lock);
+            merge->pending.emplace(seq, std::move(part.value));
+            for (auto it = merge->pending.begin(); merge->pending.end() != it && it->first == merge->next_seq; it = merge->pending.erase(it))
+            {
+                merge->total.add(*reduce, std::move(it->second));
+                ++merge->next_seq;
+            }
+        }
+
+        F* fn;
+        R* reduce;
+        merger* merge;
+        partial local;
+    };
+
+} // namespace detail
+
+
+/**
+ * Function runs fn for each row of the current data set of the result set on
+ * a pool of worker threads. The calling thread fetches rows into column
+ * batches (so the result set is only used by one thread and any driver is
+ * supported), workers process the batches in parallel, eg:
+ *
+ *     parallel_for_each(rs, [](const batch_row& row) { process(row.get_long(0), row.get_string_view(1)); });
+ *
+ * fn is called concurrently and must be thread safe. The first exception
+ * thrown by fn or by fetching stops the processing and is rethrown. Rows of
+ * the next data set are not processed, more_results() is left to the caller.
+ * @param rs result set
+ * @param fn function taking const batch_row& argument
+ * @param opts
+ */
+template <typename F>
+void parallel_for_each(result_set& rs, F&& fn, const parallel_options& opts = parallel_options())
+{
+    using worker = detail::for_each_worker<typename std::remove_reference<F>::type>;
+    std::vector<worker> workers(std::max<size_t>(1, opts.threads), worker{&fn});
+    detail::batch_pool<worker>(opts, workers).run(rs);
+}
+
+/**
+ * Function runs fn for each row of the current data set on a pool of worker
+ * threads like parallel_for_each(rs, fn, opts) and reduces the values
+ * returned by fn, eg:
+ *
+ *     auto total = parallel_for_each(rs, [](const batch_row& row) { return row.get_double(2); }, 0.0, std::plus<double>());
+ *
+ * reduce must be associative, it is called concurrently on different values.
+ * Unless ordered option is set, the values are reduced in any order so reduce
+ * must be commutative as well. With ordered option values are reduced in the
+ * order of rows, eg to concatenate them.
+ * @param rs result set
+ * @param fn function taking const batch_row& argument and returning T value
+ * @param init initial value
+ * @param reduce function taking (T, T) arguments and returning T value
+ * @param opts
+ * @return init reduced with all the values returned by fn
+ */
+template <typename T, typename F, typename R>
+T parallel_for_each(result_set& rs, F&& fn, T init, R reduce, const parallel_options& opts = parallel_options())
+{
+    using worker = detail::reduce_worker<T, typename std::remove_reference<F>::type, R>;
+    typename worker::merger merge;
+    std::vector<worker> workers(std::max<size_t>(1, opts.threads), worker{&fn, &reduce, (opts.ordered ? &merge : nullptr)});
+    detail::batch_pool<worker>(opts, workers).run(rs);
+    if (opts.ordered)
+    {
+        if (false == merge.total.empty)
+            init = reduce(std::move(init), std::move(merge.total.value));
+        return init;
+    }
+    for (auto& w : workers)
+    {
+        if (false == w.local.empty)
+            init = reduce(std::move(init), std::move(w.local.value));
+    }
+    return init;
+}
+
+} } } // namespace vgi::dbconn::dbi
+
+#endif // PARALLEL_HPP
@@ -0,0 +1,508 @@
+/*
+ * File:   prefetch_result_set.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PREFETCH_RESULT_SET_HPP
+#define PREFETCH_RESULT_SET_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "result_set.hpp"
+
+namespace vgi { namespace dbconn { namespace dbi {
+
+/**
+ * prefetch_result_set - is a result set which reads rows ahead of the consumer.
+ * A producer thread fetches rows of the wrapped driver result set into column
+ * batches and publishes them into a lock-free single producer single consumer
+ * ring, next() takes rows from the ring. Read ahead is bounded by the number of
+ * rows and optionally by the number of bytes of text and binary data. Both
+ * threads spin shortly while the ring is empty (full) and then block until
+ * the other side makes progress. Each data set is prefetched separately, the
+ * producer stops at its end and more_results() starts prefetching the next one.
+ * Date, time and UTF-16 values are not supported, they can be read as strings.
+ * The wrapped result set must not be used directly while prefetching, it is
+ * used by statement when prefetch mode is enabled with statement::prefetch().
+ */
+class prefetch_result_set : public iresult_set
+{
+public:
+    /**
+     * Constructor starts prefetching of the current data set
+     * @param rs wrapped driver result set
+     * @param max_rows maximum number of rows read ahead
+     * @param max_bytes maximum number of bytes read ahead, zero for no limit
+     */
+    prefetch_result_set(iresult_set* rs, size_t max_rows, size_t max_bytes = 0)
+    {
+        reset(rs, max_rows, max_bytes);
+    }
+
+    ~prefetch_result_set()
+    {
+        stop();
+    }
+
+    /**
+     * Function starts prefetching of the current data set of another (or the
+     * same re-executed) driver result set, previous rows are dropped. It is
+     * used by statement so that result_set objects returned earlier keep
+     * referring to a valid object.
+     * @param rs wrapped driver result set
+     * @param max_rows maximum number of rows read ahead
+     * @param max_bytes maximum number of bytes read ahead, zero for no limit
+     */
+    void reset(iresult_set* rs, size_t max_rows, size_t max_bytes = 0)
+    {
+        cancel();
+        this->rs = rs;
+        this->max_bytes = max_bytes;
+        // up to 256 rows per ring slot
+        batch_rows = std::max<size_t>(1, std::min<size_t>(256, max_rows / 2));
+        slots.resize(std::max<size_t>(2, max_rows / batch_rows));
+        canceled = false;
+        start();
+    }
+
+    /**
+     * Function stops the producer thread and drops rows read ahead, next()
+     * and more_results() return false afterwards. Called by statement before
+     * the driver statement is canceled, prepared, executed or its parameters
+     * are changed.
+     */
+    void cancel()
+    {
+        stop();
+        current = nullptr;
+        head.store(tail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        queued_bytes.store(0, std::memory_order_relaxed);
+        done.store(true, std::memory_order_relaxed);
+        canceled = true;
+    }
+
+    virtual bool has_data()
+    {
+        return (false == names.empty());
+    }
+
+    virtual bool more_results()
+    {
+        stop();
+        // the driver result set may already belong to another execution
+        if (canceled || false == rs->more_results())
+            return false;
+        start();
+        return true;
+    }
+
+    virtual size_t row_count() const
+    {
+        return row_cnt;
+    }
+
+    virtual size_t rows_affected() const
+    {
+        return (finished ? rs->rows_affected() : 0);
+    }
+
+    virtual size_t column_count() const
+    {
+        return names.size();
+    }
+
+    virtual std::string column_name(size_t col_idx)
+    {
+        if (col_idx >= names.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column index"));
+        return names[col_idx];
+    }
+
+    virtual int column_index(const std::string& col_name)
+    {
+        return name2index.find(col_name);
+    }
+
+    virtual bool next()
+    {
+        if (nullptr != current && ++row < current->rows)
+        {
+            row_cnt += 1;
+            return true;
+        }
+        while (true)
+        {
+            if (nullptr != current)
+            {
+                queued_bytes.fetch_sub(bytes_of(*current), std::memory_order_relaxed);
+                head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                current = nullptr;
+                wake();
+            }
+            auto h = head.load(std::memory_order_relaxed);
+            wait([this, h]() { return (tail.load(std::memory_order_acquire) != h || done.load(std::memory_order_acquire)); });
+            if (tail.load(std::memory_order_acquire) == h)
+            {
+                stop();
+                if (error)
+                    std::rethrow_exception(error);
+                return false;
+            }
+            current = &slots[h % slots.size()];
+            row = 0;
+            if (current->rows > 0)
+            {
+                row_cnt += 1;
+                return true;
+            }
+        }
+    }
+
+    virtual bool prev()
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": Cursors are not supported by prefetch"));
+    }
+
+    virtual bool first()
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": Cursors are not supported by prefetch"));
+    }
+
+    virtual bool last()
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": Cursors are not supported by prefetch"));
+    }
+
+    virtual bool is_null(size_t col_idx)
+    {
+        return column(col_idx).is_null(row);
+    }
+
+    virtual int16_t get_short(size_t col_idx)
+    {
+        return static_cast<int16_t>(get_long(col_idx));
+    }
+
+    virtual uint16_t get_ushort(size_t col_idx)
+    {
+        return static_cast<uint16_t>(get_long(col_idx));
+    }
+
+    virtual int32_t get_int(size_t col_idx)
+    {
+        return static_cast<int32_t>(get_long(col_idx));
+    }
+
+    virtual uint32_t get_uint(size_t col_idx)
+    {
+        return static_cast<uint32_t>(get_long(col_idx));
+    }
+
+    virtual int64_t get_long(size_t col_idx)
+    {
+        return column(col_idx).to_long(row);
+    }
+
+    virtual uint64_t get_ulong(size_t col_idx)
+    {
+        return static_cast<uint64_t>(get_long(col_idx));
+    }
+
+    virtual float get_float(size_t col_idx)
+    {
+        return static_cast<float>(get_double(col_idx));
+    }
+
+    virtual double get_double(size_t col_idx)
+    {
+        return column(col_idx).to_double(row);
+    }
+
+    virtual bool get_bool(size_t col_idx)
+    {
+        return (0 != get_long(col_idx));
+    }
+
+    virtual char get_char(size_t col_idx)
+    {
+        auto& col = column(col_idx);
+        if (data_type::TEXT == col.type || data_type::BLOB == col.type)
+            return (0 == col.length(row) ? '\0' : *col.data(row));
+        return static_cast<char>(get_long(col_idx));
+    }
+
+    virtual std::string get_string(size_t col_idx)
+    {
+        std::string str;
+        get_string(col_idx, str);
+        return str;
+    }
+
+    virtual void get_string(size_t col_idx, std::string& out)
+    {
+        column(col_idx).to_string(row, out);
+    }
+
+    virtual utils::string_view get_string_view(size_t col_idx)
+    {
+        auto& col = text_column(col_idx);
+        return utils::string_view(col.data(row), col.length(row));
+    }
+
+    virtual int get_date(size_t col_idx)
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": Date values are not supported by prefetch, use get_string()"));
+    }
+
+    virtual double get_time(size_t col_idx)
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": Time values are not supported by prefetch, use get_string()"));
+    }
+
+    virtual time_t get_datetime(size_t col_idx)
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": Datetime values are not supported by prefetch, use get_string()"));
+    }
+
+    virtual char16_t get_u16char(size_t col_idx)
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": UTF-16 values are not supported by prefetch, use get_string()"));
+    }
+
+    virtual std::u16string get_u16string(size_t col_idx)
+    {
+        throw std::runtime_error(std::string(__FUNCTION__).append(": UTF-16 values are not supported by prefetch, use get_string()"));
+    }
+
+    virtual std::vector<uint8_t> get_binary(size_t col_idx)
+    {
+        std::vector<uint8_t> out;
+        get_binary(col_idx, out);
+        return out;
+    }
+
+    virtual void get_binary(size_t col_idx, std::vector<uint8_t>& out)
+    {
+        auto& col = text_column(col_idx);
+        out.assign(col.data(row), col.data(row) + col.length(row));
+    }
+
+    virtual utils::blob_span get_blob_span(size_t col_idx)
+    {
+        auto& col = text_column(col_idx);
+        return utils::blob_span(reinterpret_cast<const uint8_t*>(col.data(row)), col.length(row));
+    }
+
+    virtual size_t fetch_batch(size_t rows, column_batch& batch)
+    {
+        batch.clear();
+        while (batch.rows < rows && next())
+        {
+            if (0 == batch.rows)
+            {
+                batch.columns.resize(current->columns.size());
+                for (size_t i = 0; i < batch.columns.size(); ++i)
+                {
+                    batch.columns[i].name = current->columns[i].name;
+                    batch.columns[i].type = current->columns[i].type;
+                    batch.columns[i].clear();
+                }
+            }
+            for (size_t i = 0; i < batch.columns.size(); ++i)
+            {
+                auto& src = current->columns[i];
+                auto& col = batch.columns[i];
+                if (src.is_null(row))
+                    col.append_null();
+                else if (data_type::INTEGER == src.type)
+                    col.append(src.get_long(row));
+                else if (data_type::REAL == src.type)
+                    col.append(src.get_double(row));
+                else
+                    col.append(src.data(row), src.length(row));
+            }
+            ++batch.rows;
+        }
+        return batch.rows;
+    }
+
+private:
+    prefetch_result_set(const prefetch_result_set&) = delete;
+    prefetch_result_set& operator=(const prefetch_result_set&) = delete;
+
+    void start()
+    {
+        names.clear();
+        name2index.clear();
+        for (size_t i = 0; i < rs->column_count(); ++i)
+        {
+            names.push_back(rs->column_name(i));
+            name2index.insert(names.back(), i);
+        }
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        queued_bytes.store(0, std::memory_order_relaxed);
+        done.store(false, std::memory_order_relaxed);
+        stopping.store(false, std::memory_order_relaxed);
+        current = nullptr;
+        row = 0;
+        row_cnt = 0;
+        error = nullptr;
+        finished = false;
+        producer = std::thread(&prefetch_result_set::produce, this);
+    }
+
+    void stop()
+    {
+        if (producer.joinable())
+        {
+            stopping.store(true, std::memory_order_release);
+            wake();
+            producer.join();
+            finished = true;
+        }
+    }
+
+    void produce()
+    {
+        try
+        {
+            while (false == stopping.load(std::memory_order_acquire))
+            {
+                auto t = tail.load(std::memory_order_relaxed);
+                // wait while the ring is full or the consumer has not yet released enough data
+                wait([this, t]()
+                {
+                    auto h = head.load(std::memory_order_acquire);
+                    return (stopping.load(std::memory_order_acquire) || (t - h < slots.size() &&
+                            (0 == max_bytes || t == h || queued_bytes.load(std::memory_order_relaxed) < max_bytes)));
+                });
+                if (stopping.load(std::memory_order_acquire))
+                    return;
+                auto& slot = slots[t % slots.size()];
+                // fetch_batch() returns zero at the end of the current data set
+                auto rows = rs->fetch_batch(batch_rows, slot);
+                if (0 == rows)
+                    break;
+                queued_bytes.fetch_add(bytes_of(slot), std::memory_order_relaxed);
+                tail.store(t + 1, std::memory_order_release);
+                wake();
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        done.store(true, std::memory_order_release);
+        wake();
+    }
+
+    static size_t bytes_of(const column_batch& batch)
+    {
+        size_t bytes = 0;
+        for (auto& col : batch.columns)
+            bytes += col.bytes.size();
+        return bytes;
+    }
+
+    /**
+     * Function waits until the condition is met: it spins, then yields and
+     * then blocks until the other thread calls wake()
+     * @param ready
+     */
+    template <typename Ready>
+    void wait(Ready ready)
+    {
+        for (size_t spins = 0; false == ready(); ++spins)
+        {
+            if (spins < 64)
+                continue;
+            if (spins < 128)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> ul(wait_lock);
+            sleepers.fetch_add(1, std::memory_order_relaxed);
+            // pairs with the fence in wake(): either the condition or the sleeper is seen
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wait_cond.wait(ul, ready);
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lg(wait_lock);
+            wait_cond.notify_all();
+        }
+    }
+
+    const column_batch::column& column(size_t col_idx) const
+    {
+        if (nullptr == current)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": There is no current row"));
+        if (col_idx >= current->columns.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column index"));
+        return current->columns[col_idx];
+    }
+
+    const column_batch::column& text_column(size_t col_idx) const
+    {
+        auto& col = column(col_idx);
+        if (data_type::TEXT != col.type && data_type::BLOB != col.type)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type (supported: text, binary)"));
+        return col;
+    }
+
+private:
+    iresult_set* rs = nullptr;
+    size_t max_bytes = 0;
+    size_t batch_rows = 256;  // rows per ring slot
+    std::vector<column_batch> slots;
+    std::atomic<size_t> head{0};
+    std::atomic<size_t> tail{0};
+    std::atomic<size_t> queued_bytes{0};
+    std::atomic<bool> done{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> sleepers{0};
+    std::mutex wait_lock;
+    std::condition_variable wait_cond;
+    std::exception_ptr error;
+    std::thread producer;
+    const column_batch* current = nullptr;
+    size_t row = 0;
+    size_t row_cnt = 0;
+    bool finished = false;
+    bool canceled = false;
+    std::vector<std::string> names;
+    utils::index_map name2index;
+}; // prefetch_result_set
+
+} } } // namespace vgi::dbconn::dbi
+
+#endif // PREFETCH_RESULT_SET_HPP
@@ -19,11 +19,288 @@
 #ifndef RESULT_SET_HPP
 #define RESULT_SET_HPP
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <iterator>
+#include <stdexcept>
 #include "utilities.hpp"
 
 namespace vgi { namespace dbconn { namespace dbi {
 
 class statement;
+class result_set;
+template <typename T, typename ResultSet = result_set> class row_range;
+template <typename T, typename ResultSet = result_set> class column_handle;
+
+/**
+ * row_mapping - is a trait that maps members of a user defined structure to
+ * the result set columns in their order, specializations are generated by the
+ * DBCONN_MAP() macro and provide static tie() function returning a tuple of
+ * references to the mapped members
+ */
+template <typename T>
+struct row_mapping;
+
+
+/**
+ * data_type - is a type of column_batch column values
+ */
+enum class data_type : char
+{
+    INTEGER,
+    REAL,
+    TEXT,
+    BLOB
+};
+
+
+/**
+ * column_batch - is a columnar block of result set rows filled by
+ * result_set::fetch_batch(). Each column keeps its values contiguously (64-bit
+ * integers, doubles or offsets into a single byte buffer for text and blobs)
+ * along with a validity bitmap where a set bit marks a non-NULL value.
+ * Fetching subsequent batches into the same object reuses its memory.
+ */
+struct column_batch
+{
+    struct column
+    {
+        std::string name;
+        data_type type = data_type::TEXT;
+        std::vector<int64_t> ints;
+        std::vector<double> reals;
+        std::vector<size_t> offsets = std::vector<size_t>(1, 0);
+        std::vector<char> bytes;
+        std::vector<uint8_t> validity;
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        bool is_null(size_t row) const
+        {
+            return (0 == (validity[row >> 3] & (1 << (row & 7))));
+        }
+
+        int64_t get_long(size_t row) const
+        {
+            return ints[row];
+        }
+
+        double get_double(size_t row) const
+        {
+            return reals[row];
+        }
+
+        const char* data(size_t row) const
+        {
+            return bytes.data() + offsets[row];
+        }
+
+        size_t length(size_t row) const
+        {
+            return offsets[row + 1] - offsets[row];
+        }
+
+        std::string get_string(size_t row) const
+        {
+            return std::string(data(row), length(row));
+        }
+
+        /**
+         * Functions return the value converted from the column type the way
+         * drivers convert values: the leading integer or real number of text
+         * is parsed (zero if there is none), reals are formatted with up to 15
+         * significant digits keeping the decimal point
+         */
+        int64_t to_long(size_t row) const
+        {
+            switch (type)
+            {
+                case data_type::INTEGER:
+                    return ints[row];
+                case data_type::REAL:
+                    // out of range values are clamped
+                    if (reals[row] <= static_cast<double>(std::numeric_limits<int64_t>::min()))
+                        return std::numeric_limits<int64_t>::min();
+                    if (reals[row] >= static_cast<double>(std::numeric_limits<int64_t>::max()))
+                        return std::numeric_limits<int64_t>::max();
+                    return static_cast<int64_t>(reals[row]);
+                default:
+                    {
+                        std::string str;
+                        const char* start = number(row, str);
+                        return (nullptr == start ? 0 : std::strtoll(start, nullptr, 10));
+                    }
+            }
+        }
+
+        double to_double(size_t row) const
+        {
+            switch (type)
+            {
+                case data_type::INTEGER:
+                    return static_cast<double>(ints[row]);
+                case data_type::REAL:
+                    return reals[row];
+                default:
+                    {
+                        std::string str;
+                        const char* start = number(row, str);
+                        if (nullptr == start)
+                            return 0.0;
+                        char* end = nullptr;
+                        auto val = std::strtod(start, &end);
+                        // hexadecimal text is not a number
+                        return (std::any_of(start, static_cast<const char*>(end), [](char c) { return ('x' == c || 'X' == c); }) ? 0.0 : val);
+                    }
+            }
+        }
+
+        void to_string(size_t row, std::string& out) const
+        {
+            switch (type)
+            {
+                case data_type::INTEGER:
+                    out = std::to_string(ints[row]);
+                    break;
+                case data_type::REAL:
+                    {
+                        char buf[32];
+                        out.assign(buf, std::snprintf(buf, sizeof(buf), "%.15g", reals[row]));
+                        if (std::isfinite(reals[row]) && std::string::npos == out.find('.'))
+                            out.insert(std::min(out.find('e'), out.length()), ".0");
+                    }
+                    break;
+                default:
+                    out.assign(data(row), length(row));
+            }
+        }
+
+        void clear()
+        {
+            count = 0;
+            ints.clear();
+            reals.clear();
+            offsets.assign(1, 0);
+            bytes.clear();
+            validity.clear();
+        }
+
+        void append_null()
+        {
+            switch (type)
+            {
+                case data_type::INTEGER:
+                    ints.push_back(0);
+                    break;
+                case data_type::REAL:
+                    reals.push_back(0);
+                    break;
+                default:
+                    offsets.push_back(bytes.size());
+            }
+            validate(false);
+        }
+
+        void append(int64_t val)
+        {
+            ints.push_back(val);
+            validate(true);
+        }
+
+        void append(double val)
+        {
+            reals.push_back(val);
+            validate(true);
+        }
+
+        void append(const char* val, size_t len)
+        {
+            bytes.insert(bytes.end(), val, val + len);
+            offsets.push_back(bytes.size());
+            validate(true);
+        }
+
+    private:
+        /**
+         * Function returns the start of the number in the text value or
+         * nullptr if the value does not start with a number
+         * @param row
+         * @param str buffer holding null terminated copy of the value
+         * @return
+         */
+        const char* number(size_t row, std::string& str) const
+        {
+            str.assign(data(row), length(row));
+            const char* start = str.c_str();
+            while (std::isspace(static_cast<unsigned char>(*start)))
+                ++start;
+            const char* digits = ('+' == *start || '-' == *start ? start + 1 : start);
+            if ('.' == *digits)
+                ++digits;
+            return (std::isdigit(static_cast<unsigned char>(*digits)) ? start : nullptr);
+        }
+
+        void validate(bool valid)
+        {
+            if (0 == (count & 7))
+                validity.push_back(0);
+            if (valid)
+                validity.back() |= (1 << (count & 7));
+            ++count;
+        }
+
+        size_t count = 0;
+    };
+
+    size_t rows = 0;
+    std::vector<column> columns;
+
+    /**
+     * Function adds an empty column, used to build parameter batches
+     * @param type
+     * @param name
+     * @return new column
+     */
+    column& add_column(data_type type, const std::string& name = "")
+    {
+        columns.emplace_back();
+        columns.back().type = type;
+        columns.back().name = name;
+        return columns.back();
+    }
+
+    /**
+     * Function removes all rows keeping allocated memory
+     */
+    void clear()
+    {
+        rows = 0;
+        for (auto& col : columns)
+            col.clear();
+    }
+};
+
+
+/**
+ * materialized_result - is a fully fetched result of an asynchronously executed
+ * statement, one column_batch per returned data set
+ */
+struct materialized_result
+{
+    std::vector<column_batch> result_sets;
+    size_t rows_affected = 0;
+};
+
 
 /**
  * iresult_set - is an interface that describes common functionality for all
@@ -56,12 +333,17 @@ struct iresult_set
     virtual bool get_bool(size_t col_idx) = 0;
     virtual char get_char(size_t col_idx) = 0;
     virtual std::string get_string(size_t col_idx) = 0;
+    virtual void get_string(size_t col_idx, std::string& out) = 0;
+    virtual utils::string_view get_string_view(size_t col_idx) = 0;
     virtual int get_date(size_t col_idx) = 0;
     virtual double get_time(size_t col_idx) = 0;
     virtual time_t get_datetime(size_t col_idx) = 0;
     virtual char16_t get_u16char(size_t col_idx) = 0;
     virtual std::u16string get_u16string(size_t col_idx) = 0;
     virtual std::vector<uint8_t> get_binary(size_t col_idx) = 0;
+    virtual void get_binary(size_t col_idx, std::vector<uint8_t>& out) = 0;
+    virtual utils::blob_span get_blob_span(size_t col_idx) = 0;
+    virtual size_t fetch_batch(size_t rows, column_batch& batch) = 0;
 };
 
 
@@ -287,17 +569,410 @@ public:
     std::vector<uint8_t> get_type_by_index(binary);
     std::vector<uint8_t> get_type_by_name(binary);
 
+    /**
+     * Function copies string cell data into the caller string reusing its
+     * capacity
+     * @param col_idx
+     * @param out
+     */
+    void get_string(size_t col_idx, std::string& out)
+    {
+        rs_impl->get_string(col_idx, out);
+    }
+
+    void get_string(const std::string& colname, std::string& out)
+    {
+        rs_impl->get_string(rs_impl->column_index(colname), out);
+    }
+
+    /**
+     * Function copies binary cell data into the caller vector reusing its
+     * capacity
+     * @param col_idx
+     * @param out
+     */
+    void get_binary(size_t col_idx, std::vector<uint8_t>& out)
+    {
+        rs_impl->get_binary(col_idx, out);
+    }
+
+    void get_binary(const std::string& colname, std::vector<uint8_t>& out)
+    {
+        rs_impl->get_binary(rs_impl->column_index(colname), out);
+    }
+
+    /**
+     * Function returns string cell data without copying, the data is only
+     * valid until the next call to next() or more_results()
+     * @param col_idx
+     * @return
+     */
+    utils::string_view get_string_view(size_t col_idx)
+    {
+        return rs_impl->get_string_view(col_idx);
+    }
+
+    utils::string_view get_string_view(const std::string& colname)
+    {
+        return rs_impl->get_string_view(rs_impl->column_index(colname));
+    }
+
+    /**
+     * Function returns binary cell data without copying, the data is only
+     * valid until the next call to next() or more_results()
+     * @param col_idx
+     * @return
+     */
+    utils::blob_span get_blob_span(size_t col_idx)
+    {
+        return rs_impl->get_blob_span(col_idx);
+    }
+
+    utils::blob_span get_blob_span(const std::string& colname)
+    {
+        return rs_impl->get_blob_span(rs_impl->column_index(colname));
+    }
+
+    /**
+     * Function fetches up to the given number of rows of the current result
+     * data set into the columnar batch, replacing its previous content. Rows
+     * are fetched directly by the driver without per value calls. Once the
+     * data set is exhausted zero is returned until more_results() is called.
+     * @param rows maximum number of rows to fetch
+     * @param batch
+     * @return number of rows fetched, zero if there is no more rows
+     */
+    size_t fetch_batch(size_t rows, column_batch& batch)
+    {
+        return rs_impl->fetch_batch(rows, batch);
+    }
+
+    /**
+     * Conversion operator to the concrete database result set implementation
+     * @return
+     */
+    template <typename T>
+    explicit operator T&() const
+    {
+        return dynamic_cast<T&>(*rs_impl);
+    }
+
+    /**
+     * Function returns cell data converted to the given type, the getter is
+     * selected at compile time by the requested type. utils::string_view and
+     * utils::blob_span values are only valid until the next call to next()
+     * @param col_idx
+     * @return
+     */
+    template <typename T>
+    T get(size_t col_idx)
+    {
+        T val;
+        get_value(col_idx, val);
+        return val;
+    }
+
+    template <typename T>
+    T get(const std::string& colname)
+    {
+        return get<T>(rs_impl->column_index(colname));
+    }
+
+    /**
+     * Function resolves column name once and returns a handle which reads the
+     * column data of the current row without name lookup, the handle is valid
+     * while the current result data set is being processed
+     * e.g. auto px = rs.column_handle<double>("price"); while (rs.next()) px.get();
+     * @param colname
+     * @return column handle or exception is thrown if column name is invalid
+     */
+    template <typename T>
+    dbi::column_handle<T> column_handle(const std::string& colname)
+    {
+        auto col_idx = rs_impl->column_index(colname);
+        if (col_idx < 0)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column name: ").append(colname));
+        return dbi::column_handle<T>(*this, col_idx);
+    }
+
+    /**
+     * Function returns current row as std::tuple or as a structure mapped with
+     * DBCONN_MAP() macro, values are taken from the columns in their order
+     * e.g. rs.get_row<std::tuple<int64_t, utils::string_view, double>>()
+     * @return
+     */
+    template <typename T>
+    T get_row()
+    {
+        T row;
+        get_row(row);
+        return row;
+    }
+
+    /**
+     * Function reads current row into the tuple, including a tuple of
+     * references e.g. rs.get_row(std::tie(id, sym, px))
+     * @param row
+     */
+    template <typename... Args>
+    void get_row(std::tuple<Args...>& row)
+    {
+        get_fields(row, std::index_sequence_for<Args...>());
+    }
+
+    template <typename... Args>
+    void get_row(std::tuple<Args...>&& row)
+    {
+        get_fields(row, std::index_sequence_for<Args...>());
+    }
+
+    /**
+     * Function reads current row into the structure mapped with DBCONN_MAP()
+     * @param row
+     */
+    template <typename T>
+    void get_row(T& row)
+    {
+        auto fields = row_mapping<T>::tie(row);
+        get_fields(fields, std::make_index_sequence<std::tuple_size<decltype(fields)>::value>());
+    }
+
+    /**
+     * Function returns range of the remaining rows of the current result data
+     * set read as the given type, e.g. for (auto& row : rs.as<Order>())
+     * @return input range
+     */
+    template <typename T>
+    row_range<T> as()
+    {
+        return row_range<T>(*this);
+    }
+
 
 private:
     friend class statement;
     result_set(iresult_set* rs) : rs_impl(rs) { }
 
+    template <typename Tuple, size_t... I>
+    void get_fields(Tuple& row, std::index_sequence<I...>)
+    {
+        using expand = int[];
+        (void)expand{0, (get_value(I, std::get<I>(row)), 0)...};
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type get_value(size_t col_idx, T& val)
+    {
+        if (sizeof(T) <= sizeof(int16_t))
+            val = static_cast<T>(std::is_signed<T>::value ? rs_impl->get_short(col_idx) : rs_impl->get_ushort(col_idx));
+        else if (sizeof(T) == sizeof(int32_t))
+            val = static_cast<T>(std::is_signed<T>::value ? rs_impl->get_int(col_idx) : rs_impl->get_uint(col_idx));
+        else
+            val = static_cast<T>(std::is_signed<T>::value ? rs_impl->get_long(col_idx) : rs_impl->get_ulong(col_idx));
+    }
+
+    void get_value(size_t col_idx, bool& val) { val = rs_impl->get_bool(col_idx); }
+    void get_value(size_t col_idx, char& val) { val = rs_impl->get_char(col_idx); }
+    void get_value(size_t col_idx, char16_t& val) { val = rs_impl->get_u16char(col_idx); }
+    void get_value(size_t col_idx, float& val) { val = rs_impl->get_float(col_idx); }
+    void get_value(size_t col_idx, double& val) { val = rs_impl->get_double(col_idx); }
+    void get_value(size_t col_idx, std::string& val) { rs_impl->get_string(col_idx, val); }
+    void get_value(size_t col_idx, utils::string_view& val) { val = rs_impl->get_string_view(col_idx); }
+    void get_value(size_t col_idx, std::u16string& val) { val = rs_impl->get_u16string(col_idx); }
+    void get_value(size_t col_idx, std::vector<uint8_t>& val) { rs_impl->get_binary(col_idx, val); }
+    void get_value(size_t col_idx, utils::blob_span& val) { val = rs_impl->get_blob_span(col_idx); }
+
 private:
     iresult_set* rs_impl;
 
 }; // result_set
 
+
+/**
+ * column_handle - is a column of the current result data set resolved by name
+ * once, returned by result_set::column_handle() (or basic_result_set)
+ */
+template <typename T, typename ResultSet>
+class column_handle
+{
+public:
+    T get()
+    {
+        return rs->template get<T>(col_idx);
+    }
+
+    T operator()()
+    {
+        return rs->template get<T>(col_idx);
+    }
+
+    bool is_null()
+    {
+        return rs->is_null(col_idx);
+    }
+
+    size_t index() const
+    {
+        return col_idx;
+    }
+
+private:
+    friend ResultSet;
+
+    column_handle(ResultSet& rs, size_t col_idx) : rs(&rs), col_idx(col_idx)
+    {
+    }
+
+private:
+    ResultSet* rs;
+    size_t col_idx;
+
+}; // column_handle
+
+
+/**
+ * row_range - is an input range over the remaining rows of the current result
+ * data set, each row is read into the same object of type T which is reused
+ * between rows. The number of columns is checked once when iteration begins,
+ * per column getters are resolved at compile time from the row type.
+ */
+template <typename T, typename ResultSet>
+class row_range
+{
+public:
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        iterator() { }
+
+        T& operator*()
+        {
+            return row;
+        }
+
+        T* operator->()
+        {
+            return &row;
+        }
+
+        iterator& operator++()
+        {
+            advance();
+            return *this;
+        }
+
+        bool operator==(const iterator& it) const
+        {
+            return (rs == it.rs);
+        }
+
+        bool operator!=(const iterator& it) const
+        {
+            return (rs != it.rs);
+        }
+
+    private:
+        friend class row_range;
+
+        explicit iterator(ResultSet* rs) : rs(rs)
+        {
+            advance();
+        }
+
+        void advance()
+        {
+            if (nullptr != rs && rs->next())
+                rs->get_row(row);
+            else
+                rs = nullptr;
+        }
+
+    private:
+        ResultSet* rs = nullptr;
+        T row;
+    };
+
+    explicit row_range(ResultSet& rs) : rs(rs)
+    {
+    }
+
+    iterator begin()
+    {
+        T row;
+        if (0 < rs.column_count() && rs.column_count() < field_count(row))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Result set has less columns than row fields"));
+        return iterator(&rs);
+    }
+
+    iterator end()
+    {
+        return iterator();
+    }
+
+private:
+    template <typename... Args>
+    static constexpr size_t field_count(std::tuple<Args...>&)
+    {
+        return sizeof...(Args);
+    }
+
+    template <typename U>
+    static size_t field_count(U& row)
+    {
+        return std::tuple_size<decltype(row_mapping<U>::tie(row))>::value;
+    }
+
+private:
+    ResultSet& rs;
+
+}; // row_range
+
 } } } // namespace vgi::dbconn::dbi
 
+
+#define DBCONN_ARGS_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define DBCONN_ARGS_COUNT(...) DBCONN_ARGS_COUNT_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DBCONN_CONCAT_(a, b) a##b
+#define DBCONN_CONCAT(a, b) DBCONN_CONCAT_(a, b)
+#define DBCONN_FIELDS_1(obj, f) obj.f
+#define DBCONN_FIELDS_2(obj, f, ...) obj.f, DBCONN_FIELDS_1(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_3(obj, f, ...) obj.f, DBCONN_FIELDS_2(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_4(obj, f, ...) obj.f, DBCONN_FIELDS_3(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_5(obj, f, ...) obj.f, DBCONN_FIELDS_4(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_6(obj, f, ...) obj.f, DBCONN_FIELDS_5(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_7(obj, f, ...) obj.f, DBCONN_FIELDS_6(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_8(obj, f, ...) obj.f, DBCONN_FIELDS_7(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_9(obj, f, ...) obj.f, DBCONN_FIELDS_8(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_10(obj, f, ...) obj.f, DBCONN_FIELDS_9(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_11(obj, f, ...) obj.f, DBCONN_FIELDS_10(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_12(obj, f, ...) obj.f, DBCONN_FIELDS_11(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_13(obj, f, ...) obj.f, DBCONN_FIELDS_12(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_14(obj, f, ...) obj.f, DBCONN_FIELDS_13(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_15(obj, f, ...) obj.f, DBCONN_FIELDS_14(obj, __VA_ARGS__)
+#define DBCONN_FIELDS_16(obj, f, ...) obj.f, DBCONN_FIELDS_15(obj, __VA_ARGS__)
+
+/**
+ * DBCONN_MAP - maps up to 16 members of the structure to the result set
+ * columns in the given order, must be used in the global namespace
+ * e.g. DBCONN_MAP(Order, id, sym, px)
+ */
+#define DBCONN_MAP(type, ...) \
+namespace vgi { namespace dbconn { namespace dbi { \
+    template <> \
+    struct row_mapping<type> \
+    { \
+        static auto tie(type& obj) \
+        { \
+            return std::tie(DBCONN_CONCAT(DBCONN_FIELDS_, DBCONN_ARGS_COUNT(__VA_ARGS__))(obj, __VA_ARGS__)); \
+        } \
+    }; \
+} } }
+
 #endif // RESULT_SET_HPP
 
@@ -0,0 +1,99 @@
+#include "sqlite_driver.hpp"
+#include "basic_connection.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+using namespace std;
+using namespace vgi::dbconn::dbi;
+using namespace vgi::dbconn::dbd;
+
+/*
+ * Compares getter calls through statement/result_set (virtual calls via
+ * istatement/iresult_set) with basic_statement/basic_result_set (direct calls
+ * to the final sqlite classes). Note that when only one driver is linked in
+ * gcc may devirtualize the first path speculatively, build with
+ * -fno-devirtualize-speculatively to see the cost of the plain virtual call.
+ */
+
+constexpr auto DBNAME = "BENCH.db";
+constexpr int ROWS = 100000;
+constexpr int PASSES = 10;
+constexpr int ROUNDS = 5;
+constexpr int READS = 10;
+
+/**
+ * Function reads all rows of the table several times and sums up the values,
+ * each cell is read READS times so that the cost of the call itself is not
+ * hidden behind sqlite3_step()
+ */
+template <typename Statement>
+double scan(Statement& stmt, double& sum)
+{
+    auto start = chrono::steady_clock::now();
+    for (int pass = 0; pass < PASSES; ++pass)
+    {
+        auto rs = stmt.execute();
+        while (rs.next())
+        {
+            for (int i = 0; i < READS; ++i)
+                sum += rs.get_long(0) + rs.get_int(1) + rs.get_double(2);
+        }
+    }
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        cout.precision(2);
+        cout.setf(ios_base::fixed, ios::floatfield);
+
+        std::remove(DBNAME);
+        connection conn = driver<sqlite::driver>::load().get_connection(DBNAME);
+        basic_connection<sqlite::driver> bconn(driver<sqlite::driver>::load().get_connection(DBNAME));
+        // no per call mutex in sqlite so that the cost of the call itself is visible
+        auto flags = sqlite::open_flag::READWRITE | sqlite::open_flag::CREATE | sqlite::open_flag::NOMUTEX;
+        static_cast<sqlite::connection&>(conn).flags(flags);
+        static_cast<sqlite::connection&>(bconn).flags(flags);
+        if (false == conn.connect() || false == bconn.connect())
+        {
+            cout << "failed to connect!\n";
+            return 1;
+        }
+        statement stmt = conn.get_statement();
+        stmt.execute("create table bench (id integer not null, qty integer not null, px real not null)");
+        conn.autocommit(false);
+        stmt.prepare("insert into bench values (?, ?, ?)");
+        for (int i = 0; i < ROWS; ++i)
+            stmt.bind(i, i % 100, i * 0.5).execute();
+        conn.commit();
+        conn.autocommit(true);
+
+        stmt.prepare("select id, qty, px from bench");
+        basic_statement<sqlite::driver> bstmt = bconn.get_statement();
+        bstmt.prepare("select id, qty, px from bench");
+
+        // alternate both paths and keep the best time of each to reduce noise
+        double vsum = 0.0, ssum = 0.0;
+        double vtime = 1e12, stime = 1e12;
+        for (int round = 0; round < ROUNDS; ++round)
+        {
+            vtime = std::min(vtime, scan(stmt, vsum));
+            stime = std::min(stime, scan(bstmt, ssum));
+        }
+
+        cout << "rows: " << ROWS << " x " << PASSES << " passes, " << READS * 3 << " reads per row, best of " << ROUNDS << " rounds\n";
+        cout << "virtual dispatch (statement/result_set):             " << setw(10) << vtime << " ms\n";
+        cout << "static dispatch (basic_statement/basic_result_set):  " << setw(10) << stime << " ms\n";
+        cout << "speedup: " << vtime / stime << "x" << (vsum == ssum ? "" : " (checksum mismatch!)") << endl;
+    }
+    catch (const exception& e)
+    {
+        cout << "exception: " << e.what() << endl;
+    }
+    std::remove(DBNAME);
+    return 0;
+}
@@ -20,9 +20,17 @@
 #define SQLITE_DRIVER_HPP
 
 #include <climits>
+#include <cctype>
 #include <cstring>
 #include <sqlite3.h>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "driver.hpp"
 
@@ -189,6 +197,268 @@ class connection;
 
 
 
+//=====================================================================================
+
+
+/**
+ * statement_cache - is a bounded LRU cache of prepared sqlite3_stmt handles
+ * keyed by SQL text. Statements are checked out of the cache while in use and
+ * returned back after reset and clearing the bindings, so the same handle is
+ * never shared between two statement objects. Least recently used handles are
+ * finalized when the cache is full.
+ */
+class statement_cache
+{
+public:
+    ~statement_cache()
+    {
+        clear();
+    }
+
+    statement_cache() = default;
+    statement_cache(statement_cache&&) = default;
+    statement_cache& operator=(statement_cache&& sc)
+    {
+        if (this != &sc)
+        {
+            clear();
+            entries = std::move(sc.entries);
+            index = std::move(sc.index);
+            counters = sc.counters;
+        }
+        return *this;
+    }
+
+    sqlite3_stmt* acquire(const std::string& sql)
+    {
+        if (0 == counters.capacity)
+            return nullptr;
+        auto it = index.find(sql);
+        if (it == index.end())
+        {
+            counters.misses += 1;
+            return nullptr;
+        }
+        counters.hits += 1;
+        sqlite3_stmt* stmt = it->second->second;
+        entries.erase(it->second);
+        index.erase(it);
+        return stmt;
+    }
+
+    void release(const std::string& sql, sqlite3_stmt* stmt)
+    {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        if (0 == counters.capacity || index.find(sql) != index.end())
+        {
+            sqlite3_finalize(stmt);
+            return;
+        }
+        entries.emplace_front(sql, stmt);
+        index[sql] = entries.begin();
+        evict(counters.capacity);
+    }
+
+    void capacity(size_t cap)
+    {
+        counters.capacity = cap;
+        evict(cap);
+    }
+
+    size_t capacity() const
+    {
+        return counters.capacity;
+    }
+
+    void clear()
+    {
+        for (auto& e : entries)
+            sqlite3_finalize(e.second);
+        entries.clear();
+        index.clear();
+    }
+
+    dbi::cache_stats stats() const
+    {
+        dbi::cache_stats st = counters;
+        st.size = entries.size();
+        return st;
+    }
+
+private:
+    statement_cache(const statement_cache&) = delete;
+    statement_cache& operator=(const statement_cache&) = delete;
+
+    void evict(size_t cap)
+    {
+        while (entries.size() > cap)
+        {
+            index.erase(entries.back().first);
+            sqlite3_finalize(entries.back().second);
+            entries.pop_back();
+            counters.evictions += 1;
+        }
+    }
+
+private:
+    using lru_list = std::list<std::pair<std::string, sqlite3_stmt*>>;
+    lru_list entries;
+    std::unordered_map<std::string, lru_list::iterator> index;
+    dbi::cache_stats counters;
+}; // statement_cache
+
+
+
+//=====================================================================================
+
+
+/**
+ * busy_stats - lock contention counters of a connection, times are in microseconds
+ */
+struct busy_stats
+{
+    size_t waits = 0;           // busy handler sleeps
+    size_t timeouts = 0;        // statements failed with SQLITE_BUSY
+    size_t unlock_waits = 0;    // waits for shared cache unlock notification
+    uint64_t wait_time = 0;     // total time slept by busy handler
+    uint64_t max_wait = 0;      // longest wait for one lock
+};
+
+
+/**
+ * busy_handler - is a sqlite busy handler of a connection. It sleeps either
+ * by sqlite busy timeout schedule, or with exponential backoff and random
+ * jitter, until the lock is released or the total wait exceeds the timeout.
+ * With SQLITE_ENABLE_UNLOCK_NOTIFY defined statements locked by another
+ * connection of the shared cache can wait for the unlock notification.
+ */
+class busy_handler
+{
+public:
+    enum class mode { NONE, TIMEOUT, BACKOFF };
+
+    void timeout(std::chrono::milliseconds tout)
+    {
+        policy = (tout.count() > 0 ? mode::TIMEOUT : mode::NONE);
+        max_time = tout;
+    }
+
+    void backoff(std::chrono::milliseconds tout, std::chrono::microseconds initial, std::chrono::microseconds max)
+    {
+        if (initial.count() <= 0 || max < initial)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid backoff delays"));
+        policy = (tout.count() > 0 ? mode::BACKOFF : mode::NONE);
+        max_time = tout;
+        initial_delay = initial;
+        max_delay = max;
+    }
+
+    /**
+     * Function registers the handler with the connection, or removes it
+     * @param conn
+     */
+    void apply(sqlite3* conn)
+    {
+        if (nullptr != conn)
+            sqlite3_busy_handler(conn, (mode::NONE == policy ? nullptr : &busy_handler::handle), this);
+    }
+
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+    /**
+     * Function blocks until the connection holding the shared cache lock
+     * ends its transaction
+     * @param conn
+     * @return SQLITE_OK or SQLITE_LOCKED if waiting would deadlock
+     */
+    int wait_for_unlock(sqlite3* conn)
+    {
+        unlock_event ev;
+        int ret = sqlite3_unlock_notify(conn, &busy_handler::unlocked, &ev);
+        if (SQLITE_OK == ret)
+        {
+            std::unique_lock<std::mutex> ul(ev.lock);
+            ev.cond.wait(ul, [&ev]() { return ev.fired; });
+            counters.unlock_waits += 1;
+        }
+        return ret;
+    }
+#endif
+
+private:
+    friend class connection;
+    friend class result_set;
+
+    static int handle(void* ctx, int count)
+    {
+        return static_cast<busy_handler*>(ctx)->wait(count);
+    }
+
+    int wait(int count)
+    {
+        using namespace std::chrono;
+        if (0 == count)
+            waited = microseconds(0);
+        microseconds delay;
+        if (mode::TIMEOUT == policy)
+        {
+            // same schedule as sqlite3_busy_timeout()
+            static const int delays[] = { 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+            delay = milliseconds(delays[std::min<size_t>(count, sizeof(delays) / sizeof(delays[0]) - 1)]);
+        }
+        else
+        {
+            // exponential backoff with jitter in the upper half of the delay
+            delay = std::min<microseconds>(max_delay, initial_delay * (int64_t(1) << std::min(count, 20)));
+            delay = delay / 2 + microseconds(std::uniform_int_distribution<int64_t>(0, delay.count() / 2)(rng));
+        }
+        auto left = duration_cast<microseconds>(max_time) - waited;
+        if (left.count() <= 0)
+            return 0;
+        delay = std::min(delay, left);
+        auto start = steady_clock::now();
+        std::this_thread::sleep_for(delay);
+        auto slept = duration_cast<microseconds>(steady_clock::now() - start);
+        waited += slept;
+        counters.waits += 1;
+        counters.wait_time += slept.count();
+        counters.max_wait = std::max<uint64_t>(counters.max_wait, waited.count());
+        return 1;
+    }
+
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+    struct unlock_event
+    {
+        std::mutex lock;
+        std::condition_variable cond;
+        bool fired = false;
+    };
+
+    static void unlocked(void** args, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            auto ev = static_cast<unlock_event*>(args[i]);
+            std::lock_guard<std::mutex> lg(ev->lock);
+            ev->fired = true;
+            ev->cond.notify_all();
+        }
+    }
+#endif
+
+private:
+    mode policy = mode::NONE;
+    bool use_unlock_notify = false;
+    std::chrono::milliseconds max_time = std::chrono::milliseconds(0);
+    std::chrono::microseconds initial_delay = std::chrono::microseconds(100);
+    std::chrono::microseconds max_delay = std::chrono::milliseconds(100);
+    std::chrono::microseconds waited = std::chrono::microseconds(0);
+    std::minstd_rand rng{std::random_device()()};
+    busy_stats counters;
+}; // busy_handler
+
+
+
 //=====================================================================================
 
 
@@ -200,16 +470,18 @@ class connection;
  * function call. result_set objects automatically cancel executed
  * queries and destroy allocated memory as they go out of scope.
  */
-class result_set : public dbi::iresult_set
+class result_set final : public dbi::iresult_set
 {
 public:
     void clear()
     {
         stepped = false;
-        name2index.clear();
+        done = false;
+        batch_end = false;
         row_cnt = 0;
         column_cnt = 0;
         affected_rows = 0;
+        next_affected = 0;
     }
 
     virtual bool has_data()
@@ -219,7 +491,10 @@ public:
 
     virtual bool more_results()
     {
-        return (stmts_index > 0 && (stmts_index < sqlite_stmts.size() || (stmts_index == sqlite_stmts.size() && stepped)));
+        batch_end = false;
+        if (more)
+            affected_rows = next_affected;
+        return more;
     }
 
     virtual size_t row_count() const
@@ -245,10 +520,7 @@ public:
 
     virtual int column_index(const std::string& col_name)
     {
-        auto it = name2index.find(col_name);
-        if (it != name2index.end())
-            return it->second;
-        return -1;
+        return (0 == column_cnt ? -1 : name2index.find(col_name));
     }
 
     virtual bool prev()
@@ -268,43 +540,41 @@ public:
 
     virtual bool next()
     {
-        validate();
         if (stepped && column_cnt > 0)
         {
             stepped = false;
             return true;
         }
-        auto res = sqlite3_step(sqlite_stmt);
+        // stepping after the last row would restart the statement
+        if (done)
+            return false;
+        validate();
+        auto res = step();
         switch (res)
         {
             case SQLITE_DONE:
-                affected_rows = (row_cnt > 0 ? row_cnt : sqlite3_changes(sqlite_conn));
-                sqlite3_reset(sqlite_stmt);
-                if (stmts_index > 0 && stmts_index < sqlite_stmts.size())
                 {
-                    name2index.clear();
-                    row_cnt = column_cnt = 0;
-                    sqlite_stmt = sqlite_stmts[stmts_index++];
-                    int tmp = affected_rows;
-                    next();
-                    stepped = true;
-                    affected_rows = tmp;
+                    stmt_affected.push_back(row_cnt);
+                    sqlite3_reset(sqlite_stmt);
+                    done = true;
+                    // statements run through up to the next data set are counted by it
+                    size_t current = affected_rows + row_cnt;
+                    affected_rows = 0;
+                    more = (nullptr != script && prepare_next() && run());
+                    done = (false == more);
+                    next_affected = affected_rows;
+                    affected_rows = (more ? current : current + next_affected);
                 }
                 break;
             case SQLITE_ROW:
-                {
-                    row_cnt += 1;
-                    if (0 == column_cnt)
-                    {
-                        column_cnt = sqlite3_column_count(sqlite_stmt);
-                        for (auto i = 0; i < column_cnt; ++i)
-                            name2index[sqlite3_column_name(sqlite_stmt, i)] = i;
-                    }
-                }
+                row_cnt += 1;
+                if (0 == column_cnt)
+                    index_columns();
                 return true;
             case SQLITE_BUSY:
-                cancel();
-                break;
+                // other connections of the database did not release their locks within busy timeout
+                reset();
+                throw std::runtime_error(std::string(__FUNCTION__).append(": ").append(decode_errcode(res)).append(", busy timeout expired"));
             default:
                 cancel();
                 throw std::runtime_error(std::string(__FUNCTION__).append(": ").append(decode_errcode(res)));
@@ -377,6 +647,20 @@ public:
         return std::move(std::string(start, sqlite3_column_bytes(sqlite_stmt, col_idx)));
     }
 
+    virtual void get_string(size_t col_idx, std::string& out)
+    {
+        validate();
+        auto start = reinterpret_cast<const char*>(sqlite3_column_text(sqlite_stmt, col_idx));
+        out.assign(start, sqlite3_column_bytes(sqlite_stmt, col_idx));
+    }
+
+    virtual utils::string_view get_string_view(size_t col_idx)
+    {
+        validate();
+        auto start = reinterpret_cast<const char*>(sqlite3_column_text(sqlite_stmt, col_idx));
+        return utils::string_view(start, sqlite3_column_bytes(sqlite_stmt, col_idx));
+    }
+
     virtual int get_date(size_t col_idx)
     {
         auto s = get_string(col_idx);
@@ -425,11 +709,105 @@ public:
         return std::move(t);
     }
 
+    virtual void get_binary(size_t col_idx, std::vector<uint8_t>& out)
+    {
+        auto blob = get_blob_span(col_idx);
+        out.assign(blob.begin(), blob.end());
+    }
+
+    virtual utils::blob_span get_blob_span(size_t col_idx)
+    {
+        validate();
+        auto data = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(sqlite_stmt, col_idx));
+        return utils::blob_span(data, sqlite3_column_bytes(sqlite_stmt, col_idx));
+    }
+
+    virtual size_t fetch_batch(size_t rows, dbi::column_batch& batch)
+    {
+        batch.clear();
+        // the rows of the next data set are fetched after more_results() call
+        if (batch_end)
+            return 0;
+        while (batch.rows < rows)
+        {
+            // stepping after the last row would restart the statement
+            if (done || false == result_set::next())
+            {
+                batch_end = true;
+                break;
+            }
+            if (0 == batch.rows)
+            {
+                batch.columns.resize(column_cnt);
+                for (auto i = 0; i < column_cnt; ++i)
+                {
+                    batch.columns[i].name = sqlite3_column_name(sqlite_stmt, i);
+                    batch.columns[i].type = batch_type(i);
+                    batch.columns[i].clear();
+                }
+            }
+            for (auto i = 0; i < column_cnt; ++i)
+            {
+                auto& col = batch.columns[i];
+                auto storage = sqlite3_column_type(sqlite_stmt, i);
+                if (SQLITE_NULL == storage)
+                {
+                    col.append_null();
+                    continue;
+                }
+                // values are dynamically typed, column which can't hold the value is converted to text
+                if (false == fits(col.type, storage))
+                    to_text(col);
+                switch (col.type)
+                {
+                    case dbi::data_type::INTEGER:
+                        col.append(static_cast<int64_t>(sqlite3_column_int64(sqlite_stmt, i)));
+                        break;
+                    case dbi::data_type::REAL:
+                        col.append(sqlite3_column_double(sqlite_stmt, i));
+                        break;
+                    case dbi::data_type::TEXT:
+                        col.append(reinterpret_cast<const char*>(sqlite3_column_text(sqlite_stmt, i)), sqlite3_column_bytes(sqlite_stmt, i));
+                        break;
+                    case dbi::data_type::BLOB:
+                        col.append(reinterpret_cast<const char*>(sqlite3_column_blob(sqlite_stmt, i)), sqlite3_column_bytes(sqlite_stmt, i));
+                        break;
+                }
+            }
+            ++batch.rows;
+        }
+        return batch.rows;
+    }
+
     bool cancel()
     {
-        clear();
         if (nullptr != sqlite_conn)
             sqlite3_interrupt(sqlite_conn);
+        return reset();
+    }
+
+    /**
+     * Function returns number of rows affected by each executed statement of
+     * the last executed SQL command in statement order, statements returning
+     * rows report the number of rows fetched
+     * @return
+     */
+    const std::vector<size_t>& statement_rows_affected() const
+    {
+        return stmt_affected;
+    }
+
+    /**
+     * Function resets current statement so that it can be executed again,
+     * unlike cancel() it does not interrupt other statements running on the
+     * connection
+     * @return true if reset, false otherwise
+     */
+    bool reset()
+    {
+        clear();
+        more = false;
+        stmt_affected.clear();
         if (nullptr != sqlite_stmt)
             return (SQLITE_OK == sqlite3_reset(sqlite_stmt));
         return true;
@@ -456,23 +834,244 @@ private:
         return static_cast<T>(sqlite3_column_int64(sqlite_stmt, col_idx));
     }
     
+    /**
+     * Function returns batch column type by the affinity of the declared
+     * column type, columns of NUMERIC affinity (eg NUMERIC, DATE, DATETIME,
+     * BOOLEAN) and expressions are typed by the storage class of the current
+     * value, text is used for null values
+     * @param col_idx
+     * @return
+     */
+    dbi::data_type batch_type(size_t col_idx)
+    {
+        const char* decl = sqlite3_column_decltype(sqlite_stmt, col_idx);
+        std::string decltype_str(nullptr == decl ? "" : decl);
+        std::transform(decltype_str.begin(), decltype_str.end(), decltype_str.begin(), ::toupper);
+        if (std::string::npos != decltype_str.find("INT"))
+            return dbi::data_type::INTEGER;
+        if (std::string::npos != decltype_str.find("CHAR") || std::string::npos != decltype_str.find("CLOB") || std::string::npos != decltype_str.find("TEXT"))
+            return dbi::data_type::TEXT;
+        if (std::string::npos != decltype_str.find("BLOB"))
+            return dbi::data_type::BLOB;
+        if (std::string::npos != decltype_str.find("REAL") || std::string::npos != decltype_str.find("FLOA") || std::string::npos != decltype_str.find("DOUB"))
+            return dbi::data_type::REAL;
+        switch (sqlite3_column_type(sqlite_stmt, col_idx))
+        {
+            case SQLITE_INTEGER:
+                return dbi::data_type::INTEGER;
+            case SQLITE_FLOAT:
+                return dbi::data_type::REAL;
+            case SQLITE_BLOB:
+                return dbi::data_type::BLOB;
+            default:
+                return dbi::data_type::TEXT;
+        }
+    }
+
+    /**
+     * Function checks whether the current value of given storage class can
+     * be stored in the batch column of given type without loss, integers of
+     * REAL affinity columns are read as floating point values by sqlite
+     * @param type
+     * @param storage
+     * @return
+     */
+    static bool fits(dbi::data_type type, int storage)
+    {
+        switch (type)
+        {
+            case dbi::data_type::INTEGER:
+                return (SQLITE_INTEGER == storage);
+            case dbi::data_type::REAL:
+                return (SQLITE_FLOAT == storage);
+            case dbi::data_type::BLOB:
+                return (SQLITE_BLOB == storage || SQLITE_TEXT == storage);
+            default:
+                return true;
+        }
+    }
+
+    /**
+     * Function converts batch column values to text the way sqlite does
+     * @param col
+     */
+    static void to_text(dbi::column_batch::column& col)
+    {
+        dbi::column_batch::column txt;
+        txt.name = std::move(col.name);
+        txt.type = dbi::data_type::TEXT;
+        char buf[32];
+        for (size_t row = 0; row < col.size(); ++row)
+        {
+            if (col.is_null(row))
+                txt.append_null();
+            else if (dbi::data_type::INTEGER == col.type)
+            {
+                auto str = std::to_string(col.get_long(row));
+                txt.append(str.data(), str.size());
+            }
+            else if (dbi::data_type::REAL == col.type)
+            {
+                sqlite3_snprintf(sizeof(buf), buf, "%!.15g", col.get_double(row));
+                txt.append(buf, std::strlen(buf));
+            }
+            else
+                txt.append(col.data(row), col.length(row));
+        }
+        col = std::move(txt);
+    }
+
     void validate()
     {
         if (sqlite_stmt == nullptr)
             throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid result state object state"));
     }
 
+    /**
+     * Function steps the statement, a statement locked by another connection
+     * of the shared cache is restarted after the lock is released when unlock
+     * notification is enabled, which is only done before the first row
+     * @return sqlite3_step() result
+     */
+    int step()
+    {
+        auto res = sqlite3_step(sqlite_stmt);
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+        while (SQLITE_LOCKED == res && 0 == row_cnt && nullptr != busy && busy->use_unlock_notify &&
+               SQLITE_LOCKED_SHAREDCACHE == sqlite3_extended_errcode(sqlite_conn))
+        {
+            if (SQLITE_OK != busy->wait_for_unlock(sqlite_conn))
+                break;
+            sqlite3_reset(sqlite_stmt);
+            res = sqlite3_step(sqlite_stmt);
+        }
+#endif
+        if (SQLITE_BUSY == res && nullptr != busy)
+            busy->counters.timeouts += 1;
+        return res;
+    }
+
+    void index_columns()
+    {
+        column_cnt = sqlite3_column_count(sqlite_stmt);
+        // column names of a prepared statement are the same on re-execution
+        if (indexed_stmt != sqlite_stmt || indexed_cnt != column_cnt)
+        {
+            name2index.clear();
+            for (auto i = 0; i < column_cnt; ++i)
+                name2index.insert(sqlite3_column_name(sqlite_stmt, i), i);
+            indexed_stmt = sqlite_stmt;
+            indexed_cnt = column_cnt;
+        }
+    }
+
+    /**
+     * Function runs statements starting from the current one up to the first
+     * statement returning rows, which is stepped to its first row. Statements
+     * of multi-statement script are prepared one at a time from the script
+     * buffer as the previous ones complete, the previous statement handle is
+     * finalized. Failed statements do not stop the script, they are reported
+     * by the exception thrown afterwards.
+     * @return true if the current statement has a row, false otherwise
+     */
+    bool run()
+    {
+        size_t failed_cnt = 0;
+        std::string err;
+        do
+        {
+            stepped = false;
+            row_cnt = column_cnt = 0;
+            // sqlite3_changes() keeps the count of the last insert, update or delete, so it is only read when this statement changed rows
+            auto total = sqlite3_total_changes(sqlite_conn);
+            auto res = step();
+            if (SQLITE_ROW == res)
+            {
+                row_cnt = 1;
+                index_columns();
+                stepped = true;
+                break;
+            }
+            if (SQLITE_DONE == res)
+            {
+                stmt_affected.push_back(total != sqlite3_total_changes(sqlite_conn) ? sqlite3_changes(sqlite_conn) : 0);
+                affected_rows += stmt_affected.back();
+            }
+            else
+            {
+                stmt_affected.push_back(0);
+                failed_cnt += 1;
+                err.append(decode_errcode(res)).append(": ").append(sqlite3_errmsg(sqlite_conn)).append("; ");
+            }
+            sqlite3_reset(sqlite_stmt);
+        }
+        while (nullptr != script && prepare_next());
+        if (failed_cnt > 0)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to execute ").append(std::to_string(failed_cnt)).append(" command(s): ").append(err));
+        return stepped;
+    }
+
+    /**
+     * Function prepares next statement of multi-statement script, white space
+     * and comments between statements are skipped by sqlite
+     * @param flags sqlite3_prepare_v3 flags
+     * @return true if prepared, false at the end of the script
+     */
+    bool prepare_next(unsigned int flags = 0)
+    {
+        while (script < script_end)
+        {
+            sqlite3_stmt* stmt = nullptr;
+            const char* tail = nullptr;
+            // the length includes null terminator so that sqlite does not copy the rest of the script
+#ifdef SQLITE_PREPARE_PERSISTENT
+            auto ret = sqlite3_prepare_v3(sqlite_conn, script, script_end - script + 1, flags, &stmt, &tail);
+#else
+            auto ret = sqlite3_prepare_v2(sqlite_conn, script, script_end - script + 1, &stmt, &tail);
+#endif
+            if (SQLITE_OK != ret)
+            {
+                script = nullptr;
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to prepare command, error code: ").append(decode_errcode(ret)).append(": ").append(sqlite3_errmsg(sqlite_conn)));
+            }
+            script = tail;
+            if (nullptr == stmt)
+                continue;
+            if (sqlite_stmts.empty())
+                sqlite_stmts.push_back(stmt);
+            else
+            {
+                sqlite3_finalize(sqlite_stmts.front());
+                sqlite_stmts.front() = stmt;
+            }
+            sqlite_stmt = stmt;
+            // the new statement may get the address of the finalized one
+            indexed_stmt = nullptr;
+            return true;
+        }
+        return false;
+    }
+
 private:
     bool stepped = false;
+    bool done = false;
+    bool more = false;
+    bool batch_end = false;             // fetch_batch() reached the end of the current data set
     long row_cnt = 0;
     long column_cnt = 0;
-    size_t stmts_index = 0;
-    size_t affected_rows = 0;
+    size_t affected_rows = 0;           // of the current data set and the statements run before it
+    size_t next_affected = 0;           // of the statements run before the next data set
+    const char* script = nullptr;       // unprepared rest of multi-statement script
+    const char* script_end = nullptr;
+    std::vector<size_t> stmt_affected;
     sqlite3* sqlite_conn = nullptr;
     sqlite3_stmt* sqlite_stmt = nullptr;
+    busy_handler* busy = nullptr;
     struct tm stm;
     std::vector<sqlite3_stmt*>& sqlite_stmts;
-    std::map<std::string, int> name2index;
+    utils::index_map name2index;
+    sqlite3_stmt* indexed_stmt = nullptr;  // statement name2index was built for
+    long indexed_cnt = 0;
 }; // result_set
 
 
@@ -485,7 +1084,11 @@ private:
  */
 class driver : public idriver
 {
-public:    
+public:
+    using connection_type = connection;
+    using statement_type = statement;
+    using result_set_type = result_set;
+
     dbi::connection get_connection(const std::string& server);
 
     driver& version(long& ver)
@@ -577,7 +1180,7 @@ private:
  * get_connection() function call. connection objects automatically delete the
  * native connection handle they manage as soon as they themselves are destroyed.
  */
-class connection : public dbi::iconnection
+class connection final : public dbi::iconnection
 {
 public:
     virtual ~connection()
@@ -588,9 +1191,12 @@ public:
     connection(connection&& conn)
         : sqlite_conn(conn.sqlite_conn), is_utf16(conn.is_utf16),
         is_autocommit(conn.is_autocommit), oflag(conn.oflag),
-        vfsname(std::move(conn.vfsname)), server(std::move(conn.server))
+        vfsname(std::move(conn.vfsname)), server(std::move(conn.server)),
+        stmt_cache(std::move(conn.stmt_cache)), busy(conn.busy),
+        autocheckpoint_pages(conn.autocheckpoint_pages)
     {
         conn.sqlite_conn = nullptr;
+        busy.apply(sqlite_conn);
     }
 
     connection& operator=(connection&& conn)
@@ -605,6 +1211,10 @@ public:
             oflag = conn.oflag;
             vfsname = std::move(conn.vfsname);
             server = std::move(conn.server);
+            stmt_cache = std::move(conn.stmt_cache);
+            busy = conn.busy;
+            busy.apply(sqlite_conn);
+            autocheckpoint_pages = conn.autocheckpoint_pages;
         }
         return *this;
     }
@@ -638,6 +1248,9 @@ public:
                 throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to connect: ").append(server));
         }
         drv->upd_conn_count(1);
+        busy.apply(sqlite_conn);
+        if (autocheckpoint_pages >= 0)
+            sqlite3_wal_autocheckpoint(sqlite_conn, autocheckpoint_pages);
         return alive();
     }
 
@@ -645,6 +1258,7 @@ public:
     {
         if (nullptr != sqlite_conn)
         {
+            stmt_cache.clear();
             sqlite3_close(sqlite_conn);
             sqlite_conn = nullptr;
             drv->upd_conn_count(-1);
@@ -696,6 +1310,16 @@ public:
 
     virtual dbi::istatement* get_statement(dbi::iconnection& iconn);
 
+    virtual void statement_cache(size_t capacity)
+    {
+        stmt_cache.capacity(capacity);
+    }
+
+    virtual dbi::cache_stats statement_cache_stats() const
+    {
+        return stmt_cache.stats();
+    }
+
     connection& flags(open_flag flag)
     {
         oflag = utils::base_type(flag);
@@ -714,6 +1338,81 @@ public:
         return *this;
     }
 
+    /**
+     * Function sets busy handler sleeping by sqlite busy timeout schedule
+     * while other connections hold the database locked, a statement fails
+     * with SQLITE_BUSY once the total wait exceeds the timeout. Zero timeout
+     * (default) fails immediately.
+     * @param timeout
+     * @return
+     */
+    connection& busy_timeout(std::chrono::milliseconds timeout)
+    {
+        busy.timeout(timeout);
+        busy.apply(sqlite_conn);
+        return *this;
+    }
+
+    /**
+     * Function sets busy handler sleeping with exponential backoff: the delay
+     * doubles from initial up to max, each sleep is randomly shortened by up
+     * to a half so that competing writers do not retry in lockstep
+     * @param timeout maximum total wait for a lock
+     * @param initial first delay
+     * @param max maximum delay
+     * @return
+     */
+    connection& busy_backoff(std::chrono::milliseconds timeout, std::chrono::microseconds initial = std::chrono::microseconds(100),
+                             std::chrono::microseconds max = std::chrono::milliseconds(100))
+    {
+        busy.backoff(timeout, initial, max);
+        busy.apply(sqlite_conn);
+        return *this;
+    }
+
+    /**
+     * Function enables waiting for sqlite3_unlock_notify() when a statement
+     * is locked by another connection of the shared cache, which requires
+     * sqlite and this driver to be compiled with SQLITE_ENABLE_UNLOCK_NOTIFY
+     * @param flag
+     * @return
+     */
+    connection& unlock_notify(bool flag)
+    {
+#ifdef SQLITE_ENABLE_UNLOCK_NOTIFY
+        busy.use_unlock_notify = flag;
+        return *this;
+#else
+        if (flag)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Driver is compiled without SQLITE_ENABLE_UNLOCK_NOTIFY"));
+        return *this;
+#endif
+    }
+
+    /**
+     * Function returns lock contention counters
+     * @return
+     */
+    busy_stats busy_statistics() const
+    {
+        return busy.counters;
+    }
+
+    /**
+     * Function sets the number of WAL pages after which a commit of this
+     * connection runs a checkpoint, zero disables automatic checkpoints so
+     * that they can be left to a background thread (see sqlite::maintenance)
+     * @param pages
+     * @return
+     */
+    connection& wal_autocheckpoint(int pages)
+    {
+        autocheckpoint_pages = std::max(0, pages);
+        if (nullptr != sqlite_conn)
+            sqlite3_wal_autocheckpoint(sqlite_conn, autocheckpoint_pages);
+        return *this;
+    }
+
     sqlite3* native_connection() const
     {
         return sqlite_conn;
@@ -752,6 +1451,9 @@ private:
     int oflag = 0;
     std::string vfsname;
     std::string server;
+    sqlite::statement_cache stmt_cache;
+    busy_handler busy;
+    int autocheckpoint_pages = -1;
 }; // connection
 
 
@@ -774,47 +1476,59 @@ dbi::connection driver::get_connection(const std::string& server)
  * get_statement() function call. statement objects automatically cancel executed
  * queries and destroy result set as they go out of scope.
  */
-class statement : public dbi::istatement
+class statement final : public dbi::istatement
 {
 public:
     ~statement()
     {
-        cancel();
+        release(false);
     }
 
     virtual bool cancel()
     {
-        bool res = rs.cancel();
+        return release(true);
+    }
+
+    /**
+     * Function sets all parameters of prepared statement to NULL, otherwise
+     * bound values are kept between executions
+     */
+    void clear_params()
+    {
         for (auto stmt : sqlite_stmts)
-        {
-            if (SQLITE_OK != sqlite3_finalize(stmt))
-                res = false;
-        }
-        sqlite_stmts.clear();
-        rs.sqlite_stmt = nullptr;
-        rs.stmts_index = 0;
-        return res;
+            sqlite3_clear_bindings(stmt);
+        owned_strings.clear();
+        owned_blobs.clear();
     }
 
     virtual dbi::iresult_set* execute()
     {
-        rs.cancel();
+        // statement is reset for re-execution, bindings and column name index are kept
+        rs.reset();
+        // script statements are prepared again one by one
+        if (false == command.empty())
+            start_script(0);
         return fetch();
     }
 
     virtual dbi::iresult_set* execute(const std::string& cmd, bool usecursor = false, bool scrollable = false)
     {
-        cancel();
+        release(false);
+        if (acquire(cmd))
+            return fetch();
         command = cmd;
-        command.erase(std::find_if(command.rbegin(), command.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), command.end());
-        size_t plen = 0;
-        while (command.length() > 0 && plen != command.length())
+#ifdef SQLITE_PREPARE_PERSISTENT
+        start_script(conn.stmt_cache.capacity() > 0 ? SQLITE_PREPARE_PERSISTENT : 0);
+#else
+        start_script(0);
+#endif
+        // only single statement commands are cached and kept prepared for re-execution
+        if (std::all_of(rs.script, rs.script_end, [](char c) { return std::isspace(static_cast<unsigned char>(c)); }))
         {
-            command.erase(command.begin(), std::find_if(command.begin(), command.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
-            sqlite_stmts.push_back(nullptr);
-            prepare(command, &sqlite_stmts[sqlite_stmts.size() - 1]);
-            plen = command.length();
-            command = tail;
+            rs.script = nullptr;
+            command.clear();
+            if (false == sqlite_stmts.empty() && conn.stmt_cache.capacity() > 0)
+                cache_key = cmd;
         }
         return fetch();
     }
@@ -825,9 +1539,13 @@ public:
             throw std::runtime_error(std::string(__FUNCTION__).append(": SQL command is not set"));
         if (false == conn.alive())
             throw std::runtime_error(std::string(__FUNCTION__).append(": Database connection is dead"));
-        cancel();
+        release(false);
+        if (acquire(cmd))
+            return;
         sqlite_stmts.resize(1);
         prepare(cmd, &sqlite_stmts[0]);
+        if (conn.stmt_cache.capacity() > 0)
+            cache_key = cmd;
     }
 
     virtual void call(const std::string& cmd)
@@ -839,6 +1557,18 @@ public:
     {
         throw std::runtime_error(std::string(__FUNCTION__).append(": Stored procedures are not supported by database"));
     }
+
+    /**
+     * Function checks whether prepared statement makes no direct changes to
+     * the database file (sqlite3_stmt_readonly), eg to route it to a read-only
+     * connection
+     * @return true if all prepared statements are read-only, false otherwise
+     */
+    bool readonly() const
+    {
+        return (false == sqlite_stmts.empty() &&
+                std::all_of(sqlite_stmts.begin(), sqlite_stmts.end(), [](sqlite3_stmt* stmt) { return (0 != sqlite3_stmt_readonly(stmt)); }));
+    }
     
     virtual void set_null(size_t param_idx)
     {
@@ -905,6 +1635,21 @@ public:
         if (SQLITE_OK != sqlite3_bind_text(sqlite_stmts.front(), param_idx + 1, val.c_str(), val.size(), SQLITE_TRANSIENT))
             throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set string at index ").append(std::to_string(param_idx)));
     }
+
+    virtual void set_string(size_t param_idx, std::string&& val)
+    {
+        validate();
+        auto& str = owned_strings[param_idx];
+        str = std::move(val);
+        set_string_view(param_idx, str);
+    }
+
+    virtual void set_string_view(size_t param_idx, utils::string_view val)
+    {
+        validate();
+        if (SQLITE_OK != sqlite3_bind_text(sqlite_stmts.front(), param_idx + 1, val.data(), val.size(), SQLITE_STATIC))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set string at index ").append(std::to_string(param_idx)));
+    }
     
     virtual void set_date(size_t param_idx, int val)
     {
@@ -960,6 +1705,83 @@ public:
             throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set blob at index ").append(std::to_string(param_idx)));
     }
 
+    virtual void set_binary(size_t param_idx, std::vector<uint8_t>&& val)
+    {
+        validate();
+        auto& blob = owned_blobs[param_idx];
+        blob = std::move(val);
+        set_blob_span(param_idx, utils::blob_span(blob.data(), blob.size()));
+    }
+
+    virtual void set_blob_span(size_t param_idx, utils::blob_span val)
+    {
+        validate();
+        if (SQLITE_OK != sqlite3_bind_blob(sqlite_stmts.front(), param_idx + 1, val.data(), val.size(), SQLITE_STATIC))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set blob at index ").append(std::to_string(param_idx)));
+    }
+
+    /**
+     * Function binds parameters of prepared statement by their C++ types calling
+     * sqlite3_bind_* functions directly, see dbi::statement::bind()
+     * @param args parameter values
+     * @return
+     */
+    template <typename... Args>
+    statement& bind(Args&&... args)
+    {
+        validate();
+        bind_params(std::index_sequence_for<Args...>(), std::forward<Args>(args)...);
+        return *this;
+    }
+
+    virtual dbi::batch_result execute_batch(const dbi::column_batch& params)
+    {
+        validate();
+        if (1 != sqlite_stmts.size() || false == command.empty())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Batch execution requires a single prepared statement"));
+        auto stmt = sqlite_stmts.front();
+        dbi::batch_result res;
+        res.affected.reserve(params.rows);
+        rs.clear();
+        sqlite3_reset(stmt);
+        bool tx = (conn.is_autocommit && 0 != sqlite3_get_autocommit(conn.sqlite_conn));
+        if (tx)
+            conn.sqlite_exec("begin transaction;");
+        try
+        {
+            for (size_t row = 0; row < params.rows; ++row)
+            {
+                auto ret = bind_row(stmt, params, row);
+                if (SQLITE_OK == ret)
+                {
+                    while (SQLITE_ROW == (ret = sqlite3_step(stmt)))
+                    { }
+                }
+                if (SQLITE_DONE == ret)
+                    res.affected.push_back(sqlite3_changes(conn.sqlite_conn));
+                else
+                {
+                    res.affected.push_back(0);
+                    res.failed.push_back(row);
+                    res.errors.push_back(sqlite3_errmsg(conn.sqlite_conn));
+                }
+                sqlite3_reset(stmt);
+            }
+            // bindings point into the parameter batch
+            sqlite3_clear_bindings(stmt);
+            if (tx)
+                conn.sqlite_exec("commit transaction;");
+        }
+        catch (...)
+        {
+            sqlite3_clear_bindings(stmt);
+            if (tx)
+                sqlite3_exec(conn.sqlite_conn, "rollback transaction;", nullptr, nullptr, nullptr);
+            throw;
+        }
+        return res;
+    }
+
 private:
     friend class connection;
     statement() = delete;
@@ -968,8 +1790,117 @@ private:
     statement(connection& conn) : conn(conn), rs(sqlite_stmts)
     {
         rs.sqlite_conn = conn.sqlite_conn;
+        rs.busy = &conn.busy;
+    }
+
+    /**
+     * Function resets the result set and releases prepared statements back to
+     * the statement cache or finalizes them
+     * @param interrupt true to interrupt running statements of the connection
+     * @return true if released, false otherwise
+     */
+    bool release(bool interrupt)
+    {
+        bool res = (interrupt ? rs.cancel() : rs.reset());
+        if (false == cache_key.empty() && 1 == sqlite_stmts.size() && conn.connected())
+            conn.stmt_cache.release(cache_key, sqlite_stmts.front());
+        else
+        {
+            for (auto stmt : sqlite_stmts)
+            {
+                if (SQLITE_OK != sqlite3_finalize(stmt))
+                    res = false;
+            }
+        }
+        cache_key.clear();
+        sqlite_stmts.clear();
+        owned_strings.clear();
+        owned_blobs.clear();
+        command.clear();
+        rs.sqlite_stmt = nullptr;
+        rs.script = nullptr;
+        rs.indexed_stmt = nullptr;
+        return res;
     }
     
+    template <size_t... I, typename... Args>
+    void bind_params(std::index_sequence<I...>, Args&&... args)
+    {
+        int expand[] = { 0, (check_bind(bind_param(sqlite_stmts.front(), I + 1, std::forward<Args>(args)), I), 0)... };
+        (void)expand;
+    }
+
+    void check_bind(int ret, size_t param_idx)
+    {
+        if (SQLITE_OK != ret)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to bind parameter at index ").append(std::to_string(param_idx)).append(": ").append(decode_errcode(ret)));
+    }
+
+    int bind_param(sqlite3_stmt* stmt, int idx, std::nullptr_t) { return sqlite3_bind_null(stmt, idx); }
+    int bind_param(sqlite3_stmt* stmt, int idx, bool val) { return sqlite3_bind_int(stmt, idx, val); }
+    int bind_param(sqlite3_stmt* stmt, int idx, char val) { return sqlite3_bind_text(stmt, idx, &val, 1, SQLITE_TRANSIENT); }
+    int bind_param(sqlite3_stmt* stmt, int idx, char16_t val) { return sqlite3_bind_text16(stmt, idx, &val, sizeof(val), SQLITE_TRANSIENT); }
+    int bind_param(sqlite3_stmt* stmt, int idx, double val) { return sqlite3_bind_double(stmt, idx, val); }
+    int bind_param(sqlite3_stmt* stmt, int idx, const char* val) { return sqlite3_bind_text(stmt, idx, val, -1, SQLITE_TRANSIENT); }
+    int bind_param(sqlite3_stmt* stmt, int idx, const std::string& val) { return sqlite3_bind_text(stmt, idx, val.data(), val.size(), SQLITE_TRANSIENT); }
+    int bind_param(sqlite3_stmt* stmt, int idx, utils::string_view val) { return sqlite3_bind_text(stmt, idx, val.data(), val.size(), SQLITE_STATIC); }
+    int bind_param(sqlite3_stmt* stmt, int idx, const std::u16string& val) { return sqlite3_bind_text16(stmt, idx, val.data(), val.size() * sizeof(char16_t), SQLITE_TRANSIENT); }
+    int bind_param(sqlite3_stmt* stmt, int idx, const std::vector<uint8_t>& val) { return sqlite3_bind_blob(stmt, idx, val.data(), val.size(), SQLITE_TRANSIENT); }
+    int bind_param(sqlite3_stmt* stmt, int idx, utils::blob_span val) { return sqlite3_bind_blob(stmt, idx, val.data(), val.size(), SQLITE_STATIC); }
+
+    int bind_param(sqlite3_stmt* stmt, int idx, std::string&& val)
+    {
+        auto& str = owned_strings[idx - 1];
+        str = std::move(val);
+        return sqlite3_bind_text(stmt, idx, str.data(), str.size(), SQLITE_STATIC);
+    }
+
+    int bind_param(sqlite3_stmt* stmt, int idx, std::vector<uint8_t>&& val)
+    {
+        auto& blob = owned_blobs[idx - 1];
+        blob = std::move(val);
+        return sqlite3_bind_blob(stmt, idx, blob.data(), blob.size(), SQLITE_STATIC);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value && !std::is_same<T, char16_t>::value, int>::type
+    bind_param(sqlite3_stmt* stmt, int idx, T val)
+    {
+        if (sizeof(T) < sizeof(int) || (sizeof(T) == sizeof(int) && std::is_signed<T>::value))
+            return sqlite3_bind_int(stmt, idx, static_cast<int>(val));
+        return sqlite3_bind_int64(stmt, idx, static_cast<sqlite3_int64>(val));
+    }
+
+    int bind_row(sqlite3_stmt* stmt, const dbi::column_batch& params, size_t row)
+    {
+        auto ret = SQLITE_OK;
+        for (size_t i = 0; i < params.columns.size() && SQLITE_OK == ret; ++i)
+        {
+            auto& col = params.columns[i];
+            if (col.is_null(row))
+                ret = sqlite3_bind_null(stmt, i + 1);
+            else
+            {
+                switch (col.type)
+                {
+                    case dbi::data_type::INTEGER:
+                        ret = sqlite3_bind_int64(stmt, i + 1, col.get_long(row));
+                        break;
+                    case dbi::data_type::REAL:
+                        ret = sqlite3_bind_double(stmt, i + 1, col.get_double(row));
+                        break;
+                    case dbi::data_type::TEXT:
+                        ret = sqlite3_bind_text(stmt, i + 1, col.data(row), col.length(row), SQLITE_STATIC);
+                        break;
+                    case dbi::data_type::BLOB:
+                        ret = sqlite3_bind_blob(stmt, i + 1, col.data(row), col.length(row), SQLITE_STATIC);
+                        break;
+                }
+            }
+        }
+        return ret;
+    }
+
     template<typename T>
     void set_slint(size_t param_idx, T val)
     {
@@ -988,41 +1919,49 @@ private:
             throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set int64 at index ").append(std::to_string(param_idx)).append(": ").append(decode_errcode(ret)));
     }
 
+    bool acquire(const std::string& cmd)
+    {
+        sqlite3_stmt* stmt = conn.stmt_cache.acquire(cmd);
+        if (nullptr == stmt)
+            return false;
+        sqlite_stmts.push_back(stmt);
+        cache_key = cmd;
+        return true;
+    }
+
     void prepare(const std::string& cmd, sqlite3_stmt** stmtptr)
     {
+#ifdef SQLITE_PREPARE_PERSISTENT
+        auto ret = sqlite3_prepare_v3(conn.sqlite_conn, cmd.c_str(), cmd.length(), (conn.stmt_cache.capacity() > 0 ? SQLITE_PREPARE_PERSISTENT : 0), stmtptr, &tail);
+#else
         auto ret = sqlite3_prepare_v2(conn.sqlite_conn, cmd.c_str(), cmd.length(), stmtptr, &tail);
+#endif
         if (SQLITE_OK != ret)
             throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to prepare command, error code: ").append(decode_errcode(ret)));
     }
+    /**
+     * Function sets the result set to walk the script in command buffer and
+     * prepares its first statement
+     * @param flags sqlite3_prepare_v3 flags
+     */
+    void start_script(unsigned int flags)
+    {
+        rs.script = command.c_str();
+        rs.script_end = rs.script + command.length();
+        rs.prepare_next(flags);
+    }
+
     dbi::iresult_set* fetch()
     {
-        size_t rows_affected = 0;
-        int failed_cnt = 0;
-        std::string err = "";
-        for (size_t i = 0; i < sqlite_stmts.size(); ++i)
+        rs.clear();
+        if (sqlite_stmts.empty())
         {
-            rs.clear();
-            rs.sqlite_stmt = sqlite_stmts[i];
-            try
-            {
-                rs.next();
-            }
-            catch (const std::exception& e)
-            {
-                failed_cnt += 1;
-                err.append(e.what()).append("; ");
-            }
-            rs.stepped = true;
-            rows_affected += rs.rows_affected();
-            if (rs.has_data())
-            {
-                rs.stmts_index = i + 1;
-                break;
-            }
+            rs.done = true;
+            return &rs;
         }
-        rs.affected_rows = rows_affected;
-        if (failed_cnt > 0)
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to execute ").append(std::to_string(failed_cnt)).append(" command(s): ").append(err));
+        rs.sqlite_stmt = sqlite_stmts.front();
+        // statements without rows are run through, the result set is stepped to its first row
+        rs.done = (false == rs.run());
         return &rs;
     }
     
@@ -1030,6 +1969,9 @@ private:
     {
         if (sqlite_stmts.size() == 0)
             throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid statement object state"));
+        // parameters of a statement still stepping through the previous result cannot be rebound
+        if (0 != sqlite3_stmt_busy(sqlite_stmts.front()))
+            rs.reset();
     }
 
 private:
@@ -1038,6 +1980,10 @@ private:
     connection& conn;
     bool cursor = false;
     std::string command;
+    std::string cache_key;
+    // parameter values owned by the statement and bound without copying
+    std::unordered_map<size_t, std::string> owned_strings;
+    std::unordered_map<size_t, std::vector<uint8_t>> owned_blobs;
     result_set rs;
     struct tm stm;
 }; // statement
@@ -0,0 +1,437 @@
+/*
+ * File:   sqlite_maintenance.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SQLITE_MAINTENANCE_HPP
+#define SQLITE_MAINTENANCE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "sqlite_driver.hpp"
+
+namespace vgi { namespace dbconn { namespace dbd { namespace sqlite {
+
+enum class checkpoint_mode : int
+{
+    PASSIVE     = SQLITE_CHECKPOINT_PASSIVE,
+    FULL        = SQLITE_CHECKPOINT_FULL,
+    RESTART     = SQLITE_CHECKPOINT_RESTART,
+#ifdef SQLITE_CHECKPOINT_TRUNCATE
+    TRUNCATE    = SQLITE_CHECKPOINT_TRUNCATE
+#endif
+};
+
+
+/**
+ * maintenance - is a background thread with its own connection which runs
+ * WAL checkpoints, PRAGMA optimize, incremental vacuum and ANALYZE on the
+ * database, so that the connections doing the work never pay for them. The
+ * writers should have automatic checkpoints disabled, eg:
+ *
+ *     wal_pool pool("test.db", 4);
+ *     pool.wal_autocheckpoint(0);
+ *     maintenance mnt("test.db");
+ *     mnt.checkpoint(std::chrono::seconds(1)).checkpoint_threshold(10000, checkpoint_mode::TRUNCATE)
+ *        .optimize(std::chrono::hours(1)).start();
+ *
+ * Each task runs when its interval elapses, zero interval disables the task.
+ * Tasks are run one at a time with throttle pause between them, so that the
+ * maintenance does not saturate database I/O. Errors are counted and do not
+ * stop the thread, the connection is reopened after a failure.
+ */
+class maintenance
+{
+    using clock = std::chrono::steady_clock;
+
+public:
+    /**
+     * task_stats - counters of one maintenance task, times in microseconds
+     */
+    struct task_stats
+    {
+        size_t runs = 0;
+        size_t failures = 0;
+        uint64_t total_time = 0;
+        uint64_t max_time = 0;
+    };
+
+    /**
+     * stats - maintenance counters snapshot. Checkpoint failures include
+     * checkpoints which returned SQLITE_BUSY, wal_frames is the WAL size in
+     * pages after the last checkpoint.
+     */
+    struct stats
+    {
+        task_stats checkpoint;
+        task_stats optimize;
+        task_stats vacuum;
+        task_stats analyze;
+        size_t busy_checkpoints = 0;
+        size_t escalated_checkpoints = 0;
+        uint64_t checkpointed_frames = 0;
+        uint64_t wal_frames = 0;
+        uint64_t vacuumed_pages = 0;
+        std::string last_error;
+    };
+
+    /**
+     * Constructor, the thread is not started until start() is called
+     * @param database database file name
+     * @param busy_timeout busy timeout of the maintenance connection, which
+     * bounds the time RESTART and TRUNCATE checkpoints hold writers off
+     */
+    explicit maintenance(const std::string& database, std::chrono::milliseconds busy_timeout = std::chrono::milliseconds(100))
+        : conn(dbd::driver<sqlite::driver>::load().get_connection(database))
+    {
+        static_cast<sqlite::connection&>(conn).flags(open_flag::READWRITE | open_flag::NOMUTEX).busy_timeout(busy_timeout);
+    }
+
+    ~maintenance()
+    {
+        stop();
+    }
+
+    /**
+     * Function starts the maintenance thread
+     */
+    void start()
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        if (worker.joinable())
+            return;
+        stopped = false;
+        auto now = clock::now();
+        for (auto t : {&ckpt, &opt, &vacuum, &anlz})
+            t->due = now + t->interval;
+        worker = std::thread(&maintenance::run, this);
+    }
+
+    /**
+     * Function stops the maintenance thread, waiting for the running task
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            stopped = true;
+        }
+        cond.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    /**
+     * Function sets checkpoint interval and mode, default mode PASSIVE does
+     * not wait for readers and writers
+     * @param interval
+     * @param mode
+     * @return
+     */
+    maintenance& checkpoint(std::chrono::milliseconds interval, checkpoint_mode mode = checkpoint_mode::PASSIVE)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        schedule(ckpt, interval);
+        ckpt_mode = mode;
+        return *this;
+    }
+
+    /**
+     * Function sets WAL size in pages at which a checkpoint is escalated to
+     * the given mode, eg RESTART or TRUNCATE, which let the WAL file be reused
+     * or truncated rather than grow. The escalated checkpoint is run only when
+     * the regular one has copied all WAL frames. Zero pages disables it.
+     * @param pages
+     * @param mode
+     * @return
+     */
+    maintenance& checkpoint_threshold(size_t pages, checkpoint_mode mode)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        escalate_pages = pages;
+        escalate_mode = mode;
+        return *this;
+    }
+
+    /**
+     * Function sets interval of PRAGMA optimize
+     * @param interval
+     * @return
+     */
+    maintenance& optimize(std::chrono::milliseconds interval)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        schedule(opt, interval);
+        return *this;
+    }
+
+    /**
+     * Function sets interval of incremental vacuum, which is run only when
+     * the database has free pages (auto_vacuum = INCREMENTAL is required)
+     * @param interval
+     * @return
+     */
+    maintenance& incremental_vacuum(std::chrono::milliseconds interval)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        schedule(vacuum, interval);
+        return *this;
+    }
+
+    /**
+     * Function sets interval of ANALYZE
+     * @param interval
+     * @return
+     */
+    maintenance& analyze(std::chrono::milliseconds interval)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        schedule(anlz, interval);
+        return *this;
+    }
+
+    /**
+     * Function sets I/O throttling: incremental vacuum frees at most pages
+     * per step and the thread pauses between tasks and vacuum steps
+     * @param pages
+     * @param pause
+     * @return
+     */
+    maintenance& throttle(size_t pages, std::chrono::milliseconds pause)
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        step_pages = std::max<size_t>(1, pages);
+        step_pause = pause;
+        return *this;
+    }
+
+    /**
+     * Function returns maintenance counters
+     * @return stats
+     */
+    stats statistics() const
+    {
+        std::lock_guard<std::mutex> lg(lock);
+        return counters;
+    }
+
+private:
+    struct task
+    {
+        std::chrono::milliseconds interval = std::chrono::milliseconds(0);
+        clock::time_point due;
+    };
+
+    maintenance(const maintenance&) = delete;
+    maintenance& operator=(const maintenance&) = delete;
+
+    void schedule(task& t, std::chrono::milliseconds interval)
+    {
+        t.interval = interval;
+        t.due = clock::now() + interval;
+        cond.notify_all();
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> ul(lock);
+        while (false == stopped)
+        {
+            task* next = nullptr;
+            for (auto t : {&ckpt, &opt, &vacuum, &anlz})
+            {
+                if (t->interval.count() > 0 && (nullptr == next || t->due < next->due))
+                    next = t;
+            }
+            if (nullptr == next)
+            {
+                cond.wait(ul);
+                continue;
+            }
+            if (next->due > clock::now())
+            {
+                cond.wait_until(ul, next->due);
+                continue;
+            }
+            next->due = clock::now() + next->interval;
+            ul.unlock();
+            run_task(next);
+            ul.lock();
+            if (step_pause.count() > 0)
+                cond.wait_for(ul, step_pause, [this]() { return stopped; });
+        }
+        ul.unlock();
+        conn.disconnect();
+    }
+
+    void run_task(task* t)
+    {
+        task_stats& ts = (t == &ckpt ? counters.checkpoint : t == &opt ? counters.optimize : t == &vacuum ? counters.vacuum : counters.analyze);
+        auto start = clock::now();
+        bool ok = true;
+        std::string err;
+        try
+        {
+            if (false == conn.connected())
+            {
+                if (false == conn.connect())
+                    throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to connect"));
+                // checkpoints are no-op until the connection reads the database and opens its WAL
+                conn.get_statement().execute("select count(*) from sqlite_master").next();
+            }
+            if (t == &ckpt)
+                ok = run_checkpoint();
+            else if (t == &opt)
+                execute("pragma optimize");
+            else if (t == &vacuum)
+                run_vacuum();
+            else
+                execute("analyze");
+        }
+        catch (const std::exception& e)
+        {
+            ok = false;
+            err = e.what();
+            conn.disconnect();
+        }
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - start).count();
+        std::lock_guard<std::mutex> lg(lock);
+        ts.runs += 1;
+        ts.failures += (ok ? 0 : 1);
+        ts.total_time += us;
+        ts.max_time = std::max(ts.max_time, us);
+        if (false == err.empty())
+            counters.last_error = err;
+    }
+
+    // returns false if the checkpoint could not complete because of locks
+    bool run_checkpoint()
+    {
+        checkpoint_mode mode;
+        checkpoint_mode emode;
+        size_t pages;
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            mode = ckpt_mode;
+            emode = escalate_mode;
+            pages = escalate_pages;
+        }
+        int log = 0;
+        int done = 0;
+        bool ok = wal_checkpoint(mode, log, done);
+        // checkpointed frames are counted from the start of the WAL, which
+        // is reset once all its frames were checkpointed
+        uint64_t copied = ((log < last_log || done < last_done) ? done : done - last_done);
+        bool escalated = false;
+        // escalate only once the whole WAL is copied, so that the escalated
+        // checkpoint does not hold writers off waiting for readers, it copies
+        // no frames but TRUNCATE resets the WAL counts to zero
+        if (ok && pages > 0 && static_cast<size_t>(log) >= pages && log == done && mode != emode)
+        {
+            escalated = true;
+            ok = wal_checkpoint(emode, log, done);
+        }
+        last_log = log;
+        last_done = done;
+        std::lock_guard<std::mutex> lg(lock);
+        counters.busy_checkpoints += (ok ? 0 : 1);
+        counters.escalated_checkpoints += (escalated ? 1 : 0);
+        counters.checkpointed_frames += copied;
+        counters.wal_frames = log;
+        return ok;
+    }
+
+    bool wal_checkpoint(checkpoint_mode mode, int& log, int& done)
+    {
+        sqlite3* db = static_cast<sqlite::connection&>(conn).native_connection();
+        int ret = sqlite3_wal_checkpoint_v2(db, nullptr, utils::base_type(mode), &log, &done);
+        log = std::max(0, log);
+        done = std::max(0, done);
+        if (SQLITE_BUSY == ret)
+            return false;
+        if (SQLITE_OK != ret)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to checkpoint: ").append(sqlite3_errmsg(db)));
+        return true;
+    }
+
+    void run_vacuum()
+    {
+        while (true)
+        {
+            size_t pages;
+            std::chrono::milliseconds pause;
+            {
+                std::lock_guard<std::mutex> lg(lock);
+                if (stopped)
+                    return;
+                pages = step_pages;
+                pause = step_pause;
+            }
+            int64_t free_pages = execute("pragma freelist_count");
+            if (free_pages <= 0)
+                return;
+            execute(std::string("pragma incremental_vacuum(").append(std::to_string(std::min<int64_t>(free_pages, pages))).append(")"));
+            int64_t left = execute("pragma freelist_count");
+            std::unique_lock<std::mutex> ul(lock);
+            counters.vacuumed_pages += std::max<int64_t>(0, free_pages - left);
+            // auto_vacuum is not INCREMENTAL, nothing can be freed
+            if (left >= free_pages || left <= 0)
+                return;
+            cond.wait_for(ul, pause, [this]() { return stopped; });
+        }
+    }
+
+    // runs the statement to completion, returns the first column of the first row
+    int64_t execute(const std::string& sql)
+    {
+        int64_t val = 0;
+        dbi::statement stmt = conn.get_statement();
+        dbi::result_set rs = stmt.execute(sql);
+        if (rs.next() && rs.column_count() > 0)
+            val = rs.get_long(0);
+        while (rs.next());
+        return val;
+    }
+
+private:
+    dbi::connection conn;
+    task ckpt;
+    task opt;
+    task vacuum;
+    task anlz;
+    checkpoint_mode ckpt_mode = checkpoint_mode::PASSIVE;
+    checkpoint_mode escalate_mode = checkpoint_mode::RESTART;
+    size_t escalate_pages = 0;
+    int last_log = 0;
+    int last_done = 0;
+    size_t step_pages = 1000;
+    std::chrono::milliseconds step_pause = std::chrono::milliseconds(0);
+    bool stopped = true;
+    stats counters;
+    mutable std::mutex lock;
+    std::condition_variable cond;
+    std::thread worker;
+}; // maintenance
+
+} } } } // namespace vgi::dbconn::dbd::sqlite
+
+#endif // SQLITE_MAINTENANCE_HPP
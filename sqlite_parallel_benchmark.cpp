@@ -0,0 +1,108 @@
+#include "sqlite_driver.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
+using namespace std;
+using namespace vgi::dbconn::dbi;
+using namespace vgi::dbconn::dbd;
+
+/*
+ * Compares a per row transformation done on the fetching thread (while
+ * rs.next()) with parallel_for_each() on 1, 2, 4... worker threads. The
+ * transformation parses the text column and hashes it a number of times to
+ * stand for parsing/enrichment work done by jobs after fetching.
+ */
+
+constexpr auto DBNAME = "PBENCH.db";
+constexpr int ROWS = 1000000;
+constexpr int WORK = 20;
+constexpr int ROUNDS = 3;
+
+/**
+ * Function stands for the per row work, returns a checksum of the row
+ */
+uint64_t transform(int64_t id, vgi::dbconn::utils::string_view name, double px)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < WORK; ++i)
+    {
+        for (size_t c = 0; c < name.size(); ++c)
+            hash = (hash ^ static_cast<uint8_t>(name[c])) * 1099511628211ULL;
+    }
+    return (hash ^ static_cast<uint64_t>(id)) + static_cast<uint64_t>(px);
+}
+
+double sequential(statement& stmt, uint64_t& sum)
+{
+    auto start = chrono::steady_clock::now();
+    auto rs = stmt.execute();
+    sum = 0;
+    while (rs.next())
+        sum += transform(rs.get_long(0), rs.get_string_view(1), rs.get_double(2));
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+double parallel(statement& stmt, size_t threads, uint64_t& sum)
+{
+    auto start = chrono::steady_clock::now();
+    auto rs = stmt.execute();
+    parallel_options opts;
+    opts.threads = threads;
+    sum = parallel_for_each(rs, [](const batch_row& row) { return transform(row.get_long(0), row.get_string_view(1), row.get_double(2)); },
+                            uint64_t(0), std::plus<uint64_t>(), opts);
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        cout.precision(2);
+        cout.setf(ios_base::fixed, ios::floatfield);
+
+        std::remove(DBNAME);
+        connection conn = driver<sqlite::driver>::load().get_connection(DBNAME);
+        if (false == conn.connect())
+        {
+            cout << "failed to connect!\n";
+            return 1;
+        }
+        statement stmt = conn.get_statement();
+        stmt.execute("create table bench (id integer not null, name varchar(64) not null, px real not null)");
+        conn.autocommit(false);
+        stmt.prepare("insert into bench values (?, ?, ?)");
+        for (int i = 0; i < ROWS; ++i)
+            stmt.bind(i, "customer name #" + to_string(i), i * 0.5).execute();
+        conn.commit();
+        conn.autocommit(true);
+        stmt.prepare("select id, name, px from bench");
+
+        uint64_t ssum = 0;
+        double stime = 1e12;
+        for (int round = 0; round < ROUNDS; ++round)
+            stime = std::min(stime, sequential(stmt, ssum));
+        cout << "rows: " << ROWS << ", best of " << ROUNDS << " rounds\n";
+        cout << "sequential (while rs.next()):      " << setw(10) << stime << " ms\n";
+
+        size_t max_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        for (size_t threads = 1; threads <= max_threads; threads *= 2)
+        {
+            uint64_t psum = 0;
+            double ptime = 1e12;
+            for (int round = 0; round < ROUNDS; ++round)
+                ptime = std::min(ptime, parallel(stmt, threads, psum));
+            cout << "parallel_for_each, " << setw(2) << threads << " threads:    " << setw(10) << ptime << " ms, speedup: "
+                 << stime / ptime << "x" << (psum == ssum ? "" : " (checksum mismatch!)") << "\n";
+        }
+    }
+    catch (const exception& e)
+    {
+        cout << "exception: " << e.what() << endl;
+    }
+    std::remove(DBNAME);
+    return 0;
+}
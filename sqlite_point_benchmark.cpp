@@ -0,0 +1,86 @@
+#include "sqlite_driver.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+using namespace std;
+using namespace vgi::dbconn::dbi;
+using namespace vgi::dbconn::dbd;
+
+/*
+ * Point query loop: a primary key lookup executed many times with different
+ * parameter values. Compares preparing the statement on every execution,
+ * getting it from the statement cache and the prepare-once path, where
+ * execute() only resets the statement and rebinds the parameter.
+ */
+
+constexpr auto DBNAME = "QBENCH.db";
+constexpr int ROWS = 100000;
+constexpr int QUERIES = 200000;
+constexpr int ROUNDS = 5;
+constexpr auto SQL = "select id, qty, px from bench where id = ?";
+
+template <typename F>
+double run(F&& query, int64_t& sum)
+{
+    auto start = chrono::steady_clock::now();
+    sum = 0;
+    for (int i = 0; i < QUERIES; ++i)
+    {
+        auto rs = query((i * 7919) % ROWS);
+        if (rs.next())
+            sum += rs.get_long(0) + rs.get_int("qty");
+    }
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / QUERIES;
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        cout.precision(3);
+        cout.setf(ios_base::fixed, ios::floatfield);
+
+        std::remove(DBNAME);
+        connection conn = driver<sqlite::driver>::load().get_connection(DBNAME);
+        if (false == conn.connect())
+        {
+            cout << "failed to connect!\n";
+            return 1;
+        }
+        statement stmt = conn.get_statement();
+        stmt.execute("create table bench (id integer primary key, qty integer not null, px real not null)");
+        conn.autocommit(false);
+        stmt.prepare("insert into bench values (?, ?, ?)");
+        for (int i = 0; i < ROWS; ++i)
+            stmt.bind(i, i % 100, i * 0.5).execute();
+        conn.commit();
+        conn.autocommit(true);
+
+        int64_t psum = 0, csum = 0, esum = 0;
+        double ptime = 1e12, ctime = 1e12, etime = 1e12;
+        for (int round = 0; round < ROUNDS; ++round)
+        {
+            conn.statement_cache(0);
+            ptime = std::min(ptime, run([&stmt](int id) { return stmt.execute(SQL, id); }, psum));
+            conn.statement_cache(16);
+            ctime = std::min(ctime, run([&stmt](int id) { return stmt.execute(SQL, id); }, csum));
+            stmt.prepare(SQL);
+            etime = std::min(etime, run([&stmt](int id) { return stmt.bind(id).execute(); }, esum));
+        }
+
+        cout << "queries: " << QUERIES << ", best of " << ROUNDS << " rounds\n";
+        cout << "prepare on each execution:      " << setw(8) << ptime << " us/query\n";
+        cout << "statement cache:                " << setw(8) << ctime << " us/query\n";
+        cout << "prepare once, rebind/execute:   " << setw(8) << etime << " us/query\n";
+        cout << "speedup over prepare: " << ptime / etime << "x"
+             << (psum == esum && csum == esum ? "" : " (checksum mismatch!)") << endl;
+    }
+    catch (const exception& e)
+    {
+        cout << "exception: " << e.what() << endl;
+    }
+    std::remove(DBNAME);
+    return 0;
+}
@@ -0,0 +1,592 @@
+#include "sqlite_driver.hpp"
+#include "basic_connection.hpp"
+#include "connection_pool.hpp"
+#include "async_connection.hpp"
+#include "parallel.hpp"
+#include "sqlite_wal_pool.hpp"
+#include "sqlite_maintenance.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <thread>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+using namespace std;
+using namespace vgi::dbconn::dbi;
+using namespace vgi::dbconn::dbd;
+namespace utils = vgi::dbconn::utils;
+
+/*
+ * Regression checks of the driver, each test prints failed checks and the
+ * program exits with non-zero status if any check failed.
+ */
+
+constexpr auto DBNAME = "DBREGRESS.db";
+
+static int failures = 0;
+
+#define CHECK(expr) \
+    do { if (false == static_cast<bool>(expr)) { ++failures; cout << __FILE__ << ":" << __LINE__ << ": check failed: " #expr "\n"; } } while (false)
+
+struct item
+{
+    int64_t id;
+    std::string name;
+    double price;
+};
+DBCONN_MAP(item, id, name, price)
+
+static void remove_database()
+{
+    std::remove(DBNAME);
+    std::remove((string(DBNAME) + "-wal").c_str());
+    std::remove((string(DBNAME) + "-shm").c_str());
+}
+
+static connection get_connection()
+{
+    connection conn = driver<sqlite::driver>::load().get_connection(DBNAME);
+    if (false == conn.connect())
+        throw runtime_error("failed to connect");
+    return conn;
+}
+
+/*
+ * reap() which fails to open a connection must not keep the slots reserved
+ * for the connections it did not open
+ */
+static void test_pool_reap_failure()
+{
+    bool fail = false;
+    size_t calls = 0;
+    connection_pool pool([&fail, &calls]()
+    {
+        if (fail && 1 == calls++)
+            throw runtime_error("connect failure");
+        return driver<sqlite::driver>::load().get_connection(DBNAME);
+    });
+    pool.max_size(3).min_size(3);
+    fail = true;
+    bool thrown = false;
+    try
+    {
+        pool.reap();
+    }
+    catch (const exception&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    fail = false;
+    pool.reap();
+    CHECK(3 == pool.statistics().idle);
+}
+
+/*
+ * fetch_batch() types columns by sqlite affinity and falls back to text when
+ * a value does not fit the column type
+ */
+static void test_batch_types()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.execute("create table types (dt datetime, num numeric, flag boolean, i int, r real, x)");
+    stmt.execute("insert into types values ('2020-01-02 03:04:05', 1.5, 1, 1, 0.5, 1)");
+    stmt.execute("insert into types values ('2020-01-03', 2, 0, 1.5, 2, 'abc')");
+    stmt.execute("insert into types values (null, 'n/a', null, 'abc', null, x'00ff')");
+    result_set rs = stmt.execute("select dt, num, flag, i, r, x from types order by rowid");
+    column_batch batch;
+    CHECK(3 == rs.fetch_batch(10, batch));
+    CHECK(6 == batch.columns.size());
+    auto& dt = batch.columns[0];
+    CHECK(data_type::TEXT == dt.type);
+    CHECK("2020-01-02 03:04:05" == dt.get_string(0));
+    CHECK("2020-01-03" == dt.get_string(1));
+    CHECK(dt.is_null(2));
+    auto& num = batch.columns[1];
+    CHECK(data_type::TEXT == num.type);
+    CHECK("1.5" == num.get_string(0) && "2" == num.get_string(1) && "n/a" == num.get_string(2));
+    auto& flag = batch.columns[2];
+    CHECK(data_type::INTEGER == flag.type);
+    CHECK(1 == flag.get_long(0) && 0 == flag.get_long(1) && flag.is_null(2));
+    auto& i = batch.columns[3];
+    CHECK(data_type::TEXT == i.type);
+    CHECK("1" == i.get_string(0) && "1.5" == i.get_string(1) && "abc" == i.get_string(2));
+    auto& r = batch.columns[4];
+    CHECK(data_type::REAL == r.type);
+    CHECK(0.5 == r.get_double(0) && 2.0 == r.get_double(1) && r.is_null(2));
+    auto& x = batch.columns[5];
+    CHECK(data_type::TEXT == x.type);
+    CHECK("1" == x.get_string(0) && "abc" == x.get_string(1) && string("\x00\xff", 2) == x.get_string(2));
+    CHECK(0 == rs.fetch_batch(10, batch));
+}
+
+/*
+ * fetch_batch() stops at the end of the current data set of a multi-statement
+ * script, rows of the next one are fetched after more_results() call
+ */
+static void test_batch_data_sets()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    result_set rs = stmt.execute("select 1 as a union all select 2; select 1 as b, 2 as c");
+    column_batch batch;
+    CHECK(1 == rs.fetch_batch(1, batch));
+    CHECK(1 == batch.columns.size() && "a" == batch.columns[0].name);
+    CHECK(1 == rs.fetch_batch(10, batch));
+    CHECK(0 == rs.fetch_batch(10, batch));
+    CHECK(0 == rs.fetch_batch(10, batch));
+    CHECK(rs.more_results());
+    CHECK(1 == rs.fetch_batch(10, batch));
+    CHECK(2 == batch.columns.size() && "b" == batch.columns[0].name && "c" == batch.columns[1].name);
+    CHECK(0 == rs.fetch_batch(10, batch));
+    CHECK(false == rs.more_results());
+    CHECK(0 == rs.fetch_batch(10, batch));
+}
+
+/*
+ * async_connection worker survives callbacks throwing exceptions and views
+ * passed as parameters are copied before the caller's data is gone
+ */
+static void test_async_callbacks_and_views()
+{
+    async_connection aconn(driver<sqlite::driver>::load().get_connection(DBNAME));
+    promise<void> release;
+    auto blocked = release.get_future().share();
+    // keep the worker busy until the parameters below are overwritten
+    auto busy = aconn.submit([blocked](connection&) { blocked.wait(); });
+    string text = "abc";
+    vector<uint8_t> bytes = {1, 2, 3};
+    char cstr[] = "xyz";
+    auto res = aconn.execute_async("select ?, ?, ?", utils::string_view(text), utils::blob_span(bytes.data(), bytes.size()), static_cast<char*>(cstr));
+    aconn.execute_async([](exception_ptr ex, materialized_result&&)
+    {
+        if (ex)
+            rethrow_exception(ex);
+        throw runtime_error("callback failure");
+    }, "select 1");
+    text.assign("ABC");
+    bytes.assign(3, 0);
+    cstr[0] = 'X';
+    release.set_value();
+    busy.get();
+    materialized_result mr = res.get();
+    CHECK(1 == mr.result_sets.size() && 1 == mr.result_sets[0].rows);
+    if (1 == mr.result_sets.size() && 1 == mr.result_sets[0].rows)
+    {
+        auto& batch = mr.result_sets[0];
+        CHECK("abc" == batch.columns[0].get_string(0));
+        CHECK(string("\x01\x02\x03", 3) == batch.columns[1].get_string(0));
+        CHECK("xyz" == batch.columns[2].get_string(0));
+    }
+    CHECK(1 == aconn.execute_async("select 1").get().result_sets.size());
+    // counters of a command are updated after its result is set, the commands before the last one are counted
+    aconn.submit([](connection&) { }).get();
+    auto st = aconn.statistics();
+    CHECK(st.executed >= 4 && 1 == st.failed);
+}
+
+/*
+ * result set returned in prefetch mode stays valid after the statement is
+ * prepared again, like the result set of the driver
+ */
+static void test_prefetch_after_prepare()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.execute("create table t (a integer)");
+    stmt.execute("insert into t values (1), (2), (3)");
+    stmt.prefetch(100);
+    result_set rs = stmt.execute("select a from t");
+    CHECK(rs.next() && 1 == rs.get_long(0));
+    stmt.prepare("select 1");
+    CHECK(false == rs.next());
+    CHECK(false == rs.more_results());
+    rs = stmt.execute("select a from t order by a desc");
+    CHECK(rs.next() && 3 == rs.get_long(0));
+}
+
+/*
+ * prefetch stops at the end of each data set of a multi-statement script
+ */
+static void test_prefetch_data_sets()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.prefetch(100);
+    result_set rs = stmt.execute("select 1 union all select 2; select 'x', 'y'");
+    vector<string> rows;
+    while (rs.next())
+    {
+        CHECK(1 == rs.column_count());
+        rows.push_back(rs.get_string(0));
+    }
+    CHECK((vector<string>{"1", "2"}) == rows);
+    CHECK(rs.more_results());
+    CHECK(rs.next() && 2 == rs.column_count() && "x" == rs.get_string(0) && "y" == rs.get_string(1));
+    CHECK(false == rs.next());
+    CHECK(false == rs.more_results());
+}
+
+/*
+ * getters return the same values in prefetch mode as the driver does
+ */
+static void test_prefetch_getters()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.execute("create table m (i integer, r real, t text, n numeric, b blob, x)");
+    stmt.execute("insert into m values (1, 1.5, '12abc', 2.5, x'3132', 'abc')");
+    stmt.execute("insert into m values (-7, 2, 'abc', 'n/a', null, -2.5e-3)");
+    stmt.execute("insert into m values (null, 1e20, ' 7', 100, x'', 3.25)");
+    stmt.execute("insert into m values (9223372036854775807, 0.1, '1.9', '1e3', 'z', '-.5')");
+    stmt.execute("insert into m values (0, 1e-300, '0x10', '+4', '3.5e2x', 'inf')");
+    stmt.execute("insert into m values (1, -1e-7, '', ' 1e3 ', '-.5', '9999999999999999999')");
+    const string sql = "select i, r, t, n, b, x from m order by rowid";
+    vector<vector<string>> native, prefetched;
+    for (auto rows : {0, 2})
+    {
+        auto& out = (0 == rows ? native : prefetched);
+        stmt.prefetch(rows);
+        result_set rs = stmt.execute(sql);
+        while (rs.next())
+        {
+            for (size_t i = 0; i < rs.column_count(); ++i)
+            {
+                if (rs.is_null(i))
+                {
+                    out.push_back({"null"});
+                    continue;
+                }
+                out.push_back({rs.get_string(i), to_string(rs.get_long(i)), to_string(rs.get_int(i)), to_string(rs.get_double(i)), to_string(rs.get_bool(i))});
+            }
+        }
+    }
+    CHECK(36 == native.size());
+    CHECK(native.size() == prefetched.size());
+    for (size_t i = 0; i < native.size() && i < prefetched.size(); ++i)
+    {
+        if (native[i] != prefetched[i])
+        {
+            ++failures;
+            cout << "value " << i << " differs: " << native[i][0] << " vs " << prefetched[i][0] << "\n";
+            for (size_t j = 1; j < native[i].size() && j < prefetched[i].size(); ++j)
+                cout << "  " << native[i][j] << " vs " << prefetched[i][j] << "\n";
+        }
+    }
+}
+
+/*
+ * producer blocked on the full read ahead ring and idle consumer do not
+ * burn CPU time
+ */
+static void test_prefetch_idle()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.execute("create table t (a integer)");
+    stmt.execute("with recursive n(i) as (select 1 union all select i + 1 from n where i < 10000) insert into t select i from n");
+    stmt.prefetch(16);
+    result_set rs = stmt.execute("select a from t");
+    CHECK(rs.next());
+    auto cpu = std::clock();
+    this_thread::sleep_for(chrono::milliseconds(300));
+    CHECK(std::clock() - cpu < CLOCKS_PER_SEC / 10);
+    size_t rows = 1;
+    while (rs.next())
+        ++rows;
+    CHECK(10000 == rows);
+}
+
+/*
+ * parallel_for_each() processes rows of the current data set only, the next
+ * one is left for more_results() call
+ */
+static void test_parallel_data_sets()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    result_set rs = stmt.execute("select 1 union all select 2 union all select 3; select 'x', 'y'");
+    parallel_options opts;
+    opts.threads = 2;
+    opts.batch_rows = 2;
+    mutex lock;
+    vector<int64_t> rows;
+    parallel_for_each(rs, [&lock, &rows](const batch_row& row)
+    {
+        CHECK(1 == row.column_count());
+        lock_guard<mutex> lg(lock);
+        rows.push_back(row.get_long(0));
+    }, opts);
+    sort(rows.begin(), rows.end());
+    CHECK((vector<int64_t>{1, 2, 3}) == rows);
+    CHECK(rs.more_results());
+    CHECK(rs.next() && 2 == rs.column_count() && "x" == rs.get_string(0));
+}
+
+/*
+ * data sets of a multi-statement script are named by the statement returning
+ * them, statements without rows in between are run through
+ */
+static void test_script_data_sets()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.execute("create table t (a integer)");
+    result_set rs = stmt.execute("select 1 as a; insert into t values (1); select 2 as b");
+    CHECK(rs.next() && "a" == rs.column_name(0) && 0 == rs.column_index("a"));
+    CHECK(1 == rs.get<int>("a"));
+    CHECK(false == rs.next());
+    CHECK(rs.more_results());
+    CHECK(rs.next() && 1 == rs.column_count() && "b" == rs.column_name(0));
+    CHECK(0 == rs.column_index("b") && -1 == rs.column_index("a"));
+    CHECK(2 == rs.get<int>("b"));
+    auto b = rs.column_handle<int>("b");
+    CHECK(2 == b.get());
+    CHECK(false == rs.next());
+    CHECK(false == rs.more_results());
+}
+
+/*
+ * each data set reports rows affected by the statements run before it and
+ * rows it returned, statements which do not change rows count zero
+ */
+static void test_script_rows_affected()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.execute("create table t (a integer)");
+    result_set rs = stmt.execute("insert into t values (1), (2), (3); create table u (b integer)");
+    CHECK(3 == rs.rows_affected());
+    auto& srs = static_cast<sqlite::result_set&>(rs);
+    CHECK((vector<size_t>{3, 0}) == srs.statement_rows_affected());
+    rs = stmt.execute("update t set a = a + 10 where a > 1; select a from t; create table v (c integer); select count(*) from t; delete from t");
+    CHECK(2 == rs.rows_affected());
+    size_t rows = 0;
+    while (rs.next())
+        ++rows;
+    CHECK(3 == rows && 5 == rs.rows_affected());
+    CHECK(rs.more_results());
+    CHECK(0 == rs.rows_affected());
+    CHECK(rs.next() && 3 == rs.get_int(0) && false == rs.next());
+    CHECK(4 == rs.rows_affected());
+    CHECK(false == rs.more_results());
+    CHECK((vector<size_t>{2, 3, 0, 1, 3}) == static_cast<sqlite::result_set&>(rs).statement_rows_affected());
+}
+
+/*
+ * wal_pool routes read-only statements to readers and the others to the
+ * writer, a routed statement returns its connection when it is replaced
+ */
+static void test_wal_routing()
+{
+    sqlite::wal_pool pool(DBNAME, 2);
+    {
+        auto ddl = pool.prepare("create table t (a integer)");
+        CHECK(false == ddl.readonly());
+        ddl->execute();
+    }
+    auto sel = pool.prepare("select count(*) from t");
+    CHECK(sel.readonly());
+    auto ins = pool.prepare("insert into t values (?)");
+    CHECK(false == ins.readonly());
+    ins->bind(1).execute();
+    ins->bind(2).execute();
+    {
+        result_set rs = sel->execute();
+        CHECK(rs.next() && 2 == rs.get_int(0));
+    }
+    CHECK(1 == pool.statistics().readers.borrowed && 1 == pool.statistics().writer.borrowed);
+    sel = std::move(ins);
+    CHECK(false == sel.readonly());
+    CHECK(0 == pool.statistics().readers.borrowed && 2 == pool.statistics().readers.idle);
+    sel->bind(3).execute();
+    auto st = pool.statistics();
+    CHECK(1 == st.reads && 2 == st.writes);
+    // the route of a known SQL text is not checked on a reader again
+    auto sel2 = pool.prepare("select count(*) from t");
+    CHECK(sel2.readonly());
+    result_set rs = sel2->execute();
+    CHECK(rs.next() && 3 == rs.get_int(0));
+    CHECK(2 == pool.statistics().reads);
+}
+
+/*
+ * basic_statement and basic_result_set bind parameters and read values by
+ * their C++ types like statement and result_set do
+ */
+static void test_basic_typed_access()
+{
+    basic_connection<sqlite::driver> conn(driver<sqlite::driver>::load().get_connection(DBNAME));
+    CHECK(conn.connect());
+    basic_statement<sqlite::driver> stmt = conn.get_statement();
+    stmt.execute("create table items (id integer, name text, price real)");
+    stmt.execute("insert into items values (?, ?, ?)", 1, "a", 1.5);
+    stmt.bind(2, string("b"), nullptr).execute();
+    auto rs = stmt.execute("select id, name, price from items where id >= ? order by id", 1);
+    CHECK(rs.next());
+    CHECK(1 == rs.get<int64_t>(0) && "a" == rs.get<string>("name") && 1.5 == rs.get<double>(2));
+    auto row = rs.get_row<tuple<int, utils::string_view, double>>();
+    CHECK(1 == get<0>(row) && "a" == string(get<1>(row).data(), get<1>(row).size()) && 1.5 == get<2>(row));
+    auto name = rs.column_handle<string>("name");
+    CHECK(rs.next() && "b" == name.get() && rs.is_null(2));
+    CHECK(false == rs.next());
+    rs = stmt.execute("select id, name, price from items order by id");
+    vector<int64_t> ids;
+    for (auto& it : rs.as<item>())
+        ids.push_back(it.id);
+    CHECK((vector<int64_t>{1, 2}) == ids);
+}
+
+/*
+ * prepared statement is executed again without exhausting or canceling its
+ * previous result, rebinding resets it, and other statements running on the
+ * connection are not interrupted by the reset
+ */
+static void test_reexecute_after_reset()
+{
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.execute("create table t (a integer, b text)");
+    stmt.execute("insert into t values (1, 'x'), (2, 'y'), (3, 'z')");
+    statement scan = conn.get_statement();
+    result_set all = scan.execute("select a from t order by a");
+    CHECK(all.next() && 1 == all.get_int(0));
+    stmt.prepare("select b from t where a >= ? order by a");
+    result_set rs = stmt.bind(1).execute();
+    CHECK(rs.next() && "x" == rs.get_string("b"));
+    // the previous result is still stepping when the parameter is bound again
+    rs = stmt.bind(2).execute();
+    CHECK(rs.next() && "y" == rs.get_string("b"));
+    rs = stmt.execute();
+    CHECK(rs.next() && "y" == rs.get_string("b") && rs.next() && "z" == rs.get_string("b") && false == rs.next());
+    static_cast<sqlite::statement&>(stmt).clear_params();
+    rs = stmt.execute();
+    CHECK(false == rs.next());
+    CHECK(all.next() && 2 == all.get_int(0) && all.next() && 3 == all.get_int(0) && false == all.next());
+}
+
+/*
+ * busy handler retries a statement locked by another connection until the
+ * lock is released or the wait exceeds the timeout, and counts its sleeps and
+ * the statements which failed with SQLITE_BUSY
+ */
+static void test_busy_counters()
+{
+    connection writer = get_connection();
+    connection other = get_connection();
+    auto& busy = static_cast<sqlite::connection&>(other);
+    statement wstmt = writer.get_statement();
+    statement ostmt = other.get_statement();
+    wstmt.execute("create table t (a integer)");
+    wstmt.execute("begin immediate");
+    wstmt.execute("insert into t values (1)");
+    auto insert = [&ostmt]()
+    {
+        try
+        {
+            ostmt.execute("insert into t values (2)");
+        }
+        catch (const exception& e)
+        {
+            return string::npos != string(e.what()).find("database is locked");
+        }
+        return false;
+    };
+    // no handler by default
+    CHECK(insert());
+    auto st = busy.busy_statistics();
+    CHECK(0 == st.waits && 1 == st.timeouts);
+    busy.busy_backoff(chrono::milliseconds(30), chrono::microseconds(500), chrono::milliseconds(5));
+    CHECK(insert());
+    st = busy.busy_statistics();
+    CHECK(1 < st.waits && 2 == st.timeouts);
+    CHECK(30000 <= st.wait_time && 30000 <= st.max_wait && st.max_wait <= st.wait_time);
+    // the lock is released while the statement waits
+    busy.busy_timeout(chrono::milliseconds(5000));
+    auto done = async(launch::async, [&wstmt]()
+    {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        wstmt.execute("commit");
+    });
+    CHECK(false == insert());
+    done.get();
+    auto last = busy.busy_statistics();
+    CHECK(st.waits < last.waits && 2 == last.timeouts && st.wait_time + 40000 <= last.wait_time);
+    result_set rs = ostmt.execute("select count(*) from t");
+    CHECK(rs.next() && 2 == rs.get_int(0));
+}
+
+/*
+ * maintenance thread checkpoints the WAL written with automatic checkpoints
+ * disabled, a WAL over the threshold is truncated after it has been copied
+ */
+static void test_maintenance_checkpoint()
+{
+    sqlite::wal_pool pool(DBNAME, 1);
+    pool.wal_autocheckpoint(0);
+    pool.prepare("create table t (a integer, b text)")->execute();
+    {
+        auto ins = pool.prepare("insert into t values (?, ?)");
+        for (int i = 0; i < 100; ++i)
+            ins->bind(i, string(100, 'x')).execute();
+    }
+    sqlite::maintenance mnt(DBNAME);
+    mnt.checkpoint(chrono::milliseconds(10)).checkpoint_threshold(1, sqlite::checkpoint_mode::TRUNCATE).start();
+    auto deadline = chrono::steady_clock::now() + chrono::seconds(5);
+    while (0 == mnt.statistics().checkpoint.runs && chrono::steady_clock::now() < deadline)
+        this_thread::sleep_for(chrono::milliseconds(5));
+    mnt.stop();
+    auto st = mnt.statistics();
+    CHECK(1 <= st.checkpoint.runs && 0 == st.checkpoint.failures && 0 == st.busy_checkpoints);
+    CHECK(1 == st.escalated_checkpoints && 0 < st.checkpointed_frames && 0 == st.wal_frames);
+    CHECK(0 == st.optimize.runs && 0 == st.vacuum.runs && 0 == st.analyze.runs && st.last_error.empty());
+    FILE* wal = fopen((string(DBNAME) + "-wal").c_str(), "rb");
+    CHECK(nullptr != wal && 0 == fseek(wal, 0, SEEK_END) && 0 == ftell(wal));
+    if (nullptr != wal)
+        fclose(wal);
+    auto sel = pool.prepare("select count(*) from t");
+    result_set rs = sel->execute();
+    CHECK(rs.next() && 100 == rs.get_int(0));
+}
+
+int main(int argc, char** argv)
+{
+    vector<pair<const char*, function<void()>>> tests =
+    {
+        {"pool_reap_failure", test_pool_reap_failure},
+        {"batch_types", test_batch_types},
+        {"batch_data_sets", test_batch_data_sets},
+        {"async_callbacks_and_views", test_async_callbacks_and_views},
+        {"prefetch_after_prepare", test_prefetch_after_prepare},
+        {"prefetch_data_sets", test_prefetch_data_sets},
+        {"prefetch_getters", test_prefetch_getters},
+        {"prefetch_idle", test_prefetch_idle},
+        {"parallel_data_sets", test_parallel_data_sets},
+        {"script_data_sets", test_script_data_sets},
+        {"script_rows_affected", test_script_rows_affected},
+        {"wal_routing", test_wal_routing},
+        {"basic_typed_access", test_basic_typed_access},
+        {"reexecute_after_reset", test_reexecute_after_reset},
+        {"busy_counters", test_busy_counters},
+        {"maintenance_checkpoint", test_maintenance_checkpoint},
+    };
+    for (auto& t : tests)
+    {
+        try
+        {
+            remove_database();
+            t.second();
+        }
+        catch (const exception& e)
+        {
+            ++failures;
+            cout << t.first << ": exception: " << e.what() << endl;
+        }
+    }
+    remove_database();
+    cout << (0 == failures ? "all tests passed" : "some tests failed") << endl;
+    return (0 == failures ? 0 : 1);
+}
@@ -0,0 +1,285 @@
+/*
+ * File:   sqlite_wal_pool.hpp
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef SQLITE_WAL_POOL_HPP
+#define SQLITE_WAL_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include "sqlite_driver.hpp"
+#include "connection_pool.hpp"
+
+namespace vgi { namespace dbconn { namespace dbd { namespace sqlite {
+
+/**
+ * wal_pool - is a thread-safe pool of connections to a database in WAL mode,
+ * which allows many concurrent readers and one writer. The pool keeps exactly
+ * one writer connection and up to the given number of read-only connections,
+ * each connection is used by one thread at a time and opened without sqlite
+ * mutexes (NOMUTEX). Statements prepared by the pool are routed by
+ * sqlite3_stmt_readonly(): reads run on a reader, writes are funneled through
+ * the writer, eg:
+ *
+ *     wal_pool pool("test.db", 4);
+ *     auto stmt = pool.prepare("select * from test where id = ?");
+ *     auto rs = stmt->bind(1).execute();
+ *
+ * Transactions made of several statements should borrow the writer explicitly
+ * with writer(), as BEGIN and COMMIT statements are read-only by themselves.
+ * The database is switched to WAL journal mode when the pool is created.
+ */
+class wal_pool
+{
+public:
+    /**
+     * routed_statement - is a statement prepared on a borrowed reader or writer
+     * connection, the connection is returned back to the pool on destruction
+     */
+    class routed_statement
+    {
+    public:
+        routed_statement(routed_statement&& rs) = default;
+
+        routed_statement& operator=(routed_statement&& rs)
+        {
+            if (this != &rs)
+            {
+                // the old statement is destroyed on its connection before the connection is returned
+                stmt = std::move(rs.stmt);
+                conn = std::move(rs.conn);
+                is_readonly = rs.is_readonly;
+            }
+            return *this;
+        }
+
+        dbi::statement& operator*()
+        {
+            return stmt;
+        }
+
+        dbi::statement* operator->()
+        {
+            return &stmt;
+        }
+
+        /**
+         * Function returns true if the statement was routed to a reader
+         * @return
+         */
+        bool readonly() const
+        {
+            return is_readonly;
+        }
+
+    private:
+        friend class wal_pool;
+        routed_statement(dbi::connection_pool::handle&& conn, dbi::statement&& stmt, bool readonly)
+            : conn(std::move(conn)), stmt(std::move(stmt)), is_readonly(readonly)
+        {
+        }
+
+    private:
+        // declared first, so the destructor returns the connection after the statement is destroyed
+        dbi::connection_pool::handle conn;
+        dbi::statement stmt;
+        bool is_readonly;
+    }; // routed_statement
+
+    /**
+     * stats - pool counters snapshot, waiting counters are the reader and
+     * writer queue depths
+     */
+    struct stats
+    {
+        dbi::connection_pool::stats readers;
+        dbi::connection_pool::stats writer;
+        size_t reads = 0;
+        size_t writes = 0;
+    };
+
+    /**
+     * Constructor opens the writer connection and switches the database to
+     * WAL journal mode
+     * @param database database file name
+     * @param readers maximum number of read-only connections
+     * @param busy_timeout busy timeout of all connections, see connection::busy_timeout()
+     */
+    explicit wal_pool(const std::string& database, size_t readers = std::thread::hardware_concurrency(),
+                      std::chrono::milliseconds busy_timeout = std::chrono::milliseconds(5000))
+        : writer_pool([this, database, busy_timeout]()
+                      {
+                          dbi::connection conn = factory(database, open_flag::READWRITE | open_flag::CREATE | open_flag::NOMUTEX, busy_timeout)();
+                          if (autocheckpoint_pages >= 0)
+                              static_cast<sqlite::connection&>(conn).wal_autocheckpoint(autocheckpoint_pages);
+                          return conn;
+                      }),
+          reader_pool(factory(database, open_flag::READONLY | open_flag::NOMUTEX, busy_timeout))
+    {
+        writer_pool.max_size(1).min_size(1);
+        reader_pool.max_size(std::max<size_t>(1, readers));
+        auto conn = writer_pool.get();
+        dbi::statement stmt = conn->get_statement();
+        dbi::result_set rs = stmt.execute("pragma journal_mode=wal");
+        if (false == rs.next() || "wal" != rs.get_string(0))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to switch database to WAL journal mode: ").append(database));
+    }
+
+    /**
+     * Function prepares single SQL statement on a reader if it is read-only,
+     * on the writer otherwise. The routing of each SQL text is remembered,
+     * so a statement is only checked on a reader the first time (SQL texts
+     * should use parameters rather than literal values).
+     * @param sql
+     * @return prepared statement holding the borrowed connection
+     */
+    routed_statement prepare(const std::string& sql)
+    {
+        bool readonly = false;
+        bool known = false;
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            auto it = routes.find(sql);
+            if (routes.end() != it)
+            {
+                known = true;
+                readonly = it->second;
+            }
+        }
+        if (known)
+            return prepare(sql, readonly);
+        {
+            auto conn = reader_pool.get();
+            dbi::statement stmt = conn->get_statement();
+            stmt.prepare(sql);
+            readonly = static_cast<sqlite::statement&>(stmt).readonly();
+            {
+                std::lock_guard<std::mutex> lg(lock);
+                routes.emplace(sql, readonly);
+                reads += (readonly ? 1 : 0);
+            }
+            if (readonly)
+                return routed_statement(std::move(conn), std::move(stmt), true);
+        }
+        return prepare(sql, false);
+    }
+
+    /**
+     * Function borrows a read-only connection
+     * @return connection handle
+     */
+    dbi::connection_pool::handle reader()
+    {
+        return reader_pool.get();
+    }
+
+    /**
+     * Function borrows the writer connection, waiting while it is used by
+     * another thread
+     * @return connection handle
+     */
+    dbi::connection_pool::handle writer()
+    {
+        return writer_pool.get();
+    }
+
+    /**
+     * Function sets automatic checkpoint threshold of the writer connection,
+     * see connection::wal_autocheckpoint(). Zero disables the checkpoints in
+     * the write path, they should be run by sqlite::maintenance then.
+     * @param pages
+     * @return
+     */
+    wal_pool& wal_autocheckpoint(int pages)
+    {
+        auto conn = writer_pool.get();
+        autocheckpoint_pages = std::max(0, pages);
+        static_cast<sqlite::connection&>(*conn).wal_autocheckpoint(autocheckpoint_pages);
+        return *this;
+    }
+
+    /**
+     * Function sets time prepare(), reader() and writer() wait for a free connection
+     * @param timeout
+     * @return
+     */
+    wal_pool& borrow_timeout(std::chrono::milliseconds timeout)
+    {
+        writer_pool.borrow_timeout(timeout);
+        reader_pool.borrow_timeout(timeout);
+        return *this;
+    }
+
+    /**
+     * Function returns pool counters
+     * @return stats
+     */
+    stats statistics() const
+    {
+        stats st;
+        st.readers = reader_pool.statistics();
+        st.writer = writer_pool.statistics();
+        std::lock_guard<std::mutex> lg(lock);
+        st.reads = reads;
+        st.writes = writes;
+        return st;
+    }
+
+private:
+    wal_pool(const wal_pool&) = delete;
+    wal_pool& operator=(const wal_pool&) = delete;
+
+    static std::function<dbi::connection()> factory(const std::string& database, open_flag flags, std::chrono::milliseconds busy_timeout)
+    {
+        return [database, flags, busy_timeout]()
+        {
+            dbi::connection conn = dbd::driver<sqlite::driver>::load().get_connection(database);
+            static_cast<sqlite::connection&>(conn).flags(flags).busy_timeout(busy_timeout);
+            conn.statement_cache(64);
+            return conn;
+        };
+    }
+
+    routed_statement prepare(const std::string& sql, bool readonly)
+    {
+        auto conn = (readonly ? reader_pool.get() : writer_pool.get());
+        dbi::statement stmt = conn->get_statement();
+        stmt.prepare(sql);
+        {
+            std::lock_guard<std::mutex> lg(lock);
+            (readonly ? reads : writes) += 1;
+        }
+        return routed_statement(std::move(conn), std::move(stmt), readonly);
+    }
+
+private:
+    dbi::connection_pool writer_pool;
+    dbi::connection_pool reader_pool;
+    std::unordered_map<std::string, bool> routes;
+    size_t reads = 0;
+    size_t writes = 0;
+    std::atomic<int> autocheckpoint_pages{-1};
+    mutable std::mutex lock;
+}; // wal_pool
+
+} } } } // namespace vgi::dbconn::dbd::sqlite
+
+#endif // SQLITE_WAL_POOL_HPP
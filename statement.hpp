@@ -19,12 +19,31 @@
 #ifndef STATEMENT_HPP
 #define STATEMENT_HPP
 
+#include <tuple>
+#include <numeric>
 #include "result_set.hpp"
+#include "prefetch_result_set.hpp"
 
 namespace vgi { namespace dbconn { namespace dbi {
 
 class connection;
 
+/**
+ * batch_result - is a result of statement execute_batch() call
+ */
+struct batch_result
+{
+    std::vector<size_t> affected;     // number of rows affected by each parameter row
+    std::vector<size_t> failed;       // indexes of failed parameter rows
+    std::vector<std::string> errors;  // error messages of failed parameter rows
+
+    size_t rows_affected() const
+    {
+        return std::accumulate(affected.begin(), affected.end(), size_t(0));
+    }
+};
+
+
 /**
  * istatement - is an interface that describes common functionality for all
  * concrete native implementations for a statement class
@@ -50,12 +69,17 @@ struct istatement
     virtual void set_bool(size_t col_idx, bool val) = 0;
     virtual void set_char(size_t col_idx, char val) = 0;
     virtual void set_string(size_t col_idx, const std::string& val) = 0;
+    virtual void set_string(size_t col_idx, std::string&& val) = 0;
+    virtual void set_string_view(size_t col_idx, utils::string_view val) = 0;
     virtual void set_date(size_t col_idx, int val) = 0;
     virtual void set_time(size_t col_idx, double val) = 0;
     virtual void set_datetime(size_t col_idx, time_t val) = 0;
     virtual void set_u16char(size_t col_idx, char16_t val) = 0;
     virtual void set_u16string(size_t col_idx, const std::u16string& val) = 0;
     virtual void set_binary(size_t col_idx, const std::vector<uint8_t>& val) = 0;
+    virtual void set_binary(size_t col_idx, std::vector<uint8_t>&& val) = 0;
+    virtual void set_blob_span(size_t col_idx, utils::blob_span val) = 0;
+    virtual batch_result execute_batch(const column_batch& params) = 0;
 };
 
 
@@ -76,7 +100,9 @@ public:
      * Move constructor
      * @param stmt
      */
-    statement(statement&& stmt) : stmt_impl(std::move(stmt.stmt_impl))
+    statement(statement&& stmt)
+        : stmt_impl(std::move(stmt.stmt_impl)), prefetcher(std::move(stmt.prefetcher)),
+          prefetch_rows(stmt.prefetch_rows), prefetch_bytes(stmt.prefetch_bytes)
     {
     }
 
@@ -88,7 +114,12 @@ public:
     statement& operator=(statement&& stmt)
     {
         if (this != &stmt)
+        {
+            prefetcher = std::move(stmt.prefetcher);
             stmt_impl = std::move(stmt.stmt_impl);
+            prefetch_rows = stmt.prefetch_rows;
+            prefetch_bytes = stmt.prefetch_bytes;
+        }
         return *this;
     }
 
@@ -98,6 +129,7 @@ public:
      */
     void prepare(const std::string& sql)
     {
+        stop_prefetch();
         stmt_impl->prepare(sql);
     }
 
@@ -107,6 +139,7 @@ public:
      */
     void call(const std::string& proc)
     {
+        stop_prefetch();
         stmt_impl->call(proc);
     }
 
@@ -116,7 +149,8 @@ public:
      */
     result_set execute()
     {
-        return result_set(stmt_impl->execute());
+        stop_prefetch();
+        return make_result_set(stmt_impl->execute());
     }
 
     /**
@@ -128,15 +162,104 @@ public:
      */
     result_set execute(const std::string& sql, bool cursor = false, bool scrollable = false)
     {
-        return result_set(stmt_impl->execute(sql, cursor, scrollable));
+        stop_prefetch();
+        return make_result_set(stmt_impl->execute(sql, cursor, scrollable));
+    }
+
+    /**
+     * Function prepares SQL statement, binds parameters and runs it. Note that
+     * the call with bool arguments only is the call with cursor flags.
+     * @param sql statement to be executed
+     * @param args parameter values, see bind()
+     * @return result set object
+     */
+    template <typename... Args, typename = typename std::enable_if<(sizeof...(Args) > 0)>::type>
+    result_set execute(const std::string& sql, Args&&... args)
+    {
+        stop_prefetch();
+        stmt_impl->prepare(sql);
+        bind(std::forward<Args>(args)...);
+        return make_result_set(stmt_impl->execute());
     }
 
     /**
-     * Function cancels currently running SQL statements
+     * Function binds parameters of prepared statement starting from the first
+     * one, the set function for each parameter is chosen by its C++ type at
+     * compile time (nullptr binds NULL, rvalue strings and vectors are moved
+     * into the statement, string_view and blob_span are bound without copying)
+     * @param args parameter values
+     * @return
+     */
+    template <typename... Args>
+    statement& bind(Args&&... args)
+    {
+        stop_prefetch();
+        bind_params(std::index_sequence_for<Args...>(), std::forward<Args>(args)...);
+        return *this;
+    }
+
+    /**
+     * Function runs prepared statement or stored procedure once for each row
+     * of parameters, all rows are run in one transaction unless auto-commit is
+     * off. Failed rows do not stop the batch, they are reported in the result,
+     * unless the database rolls back the transaction after the failure, then
+     * the whole batch fails. Drivers without array binding of parameters (eg
+     * Sybase) send each row in its own round trip.
+     * @param params columnar parameter arrays, one column per parameter
+     * @return per row affected counts and failures
+     */
+    batch_result execute_batch(const column_batch& params)
+    {
+        stop_prefetch();
+        return stmt_impl->execute_batch(params);
+    }
+
+    /**
+     * Function runs prepared statement or stored procedure once for each tuple
+     * of parameters, see execute_batch(const column_batch&)
+     * @param rows parameter tuples (integral, floating point, string or binary values)
+     * @return per row affected counts and failures
+     */
+    template <typename... T>
+    batch_result execute_batch(const std::vector<std::tuple<T...>>& rows)
+    {
+        column_batch params;
+        init_batch(params, std::tuple<T...>(), std::index_sequence_for<T...>());
+        for (auto& row : rows)
+            append_batch(params, row, std::index_sequence_for<T...>());
+        params.rows = rows.size();
+        stop_prefetch();
+        return stmt_impl->execute_batch(params);
+    }
+
+    /**
+     * Function enables prefetch mode for result sets of subsequently executed
+     * statements: a producer thread reads rows ahead into a ring of decoded
+     * rows while the caller processes current ones, next() takes rows from the
+     * ring. The producer is stopped by cancel(), by the next statement
+     * execution, prepare or parameter binding. Cursors, date/time and UTF-16
+     * getters are not available in prefetch mode, see prefetch_result_set.
+     * @param rows maximum number of rows read ahead, zero disables prefetch mode
+     * @param bytes maximum number of text and binary bytes read ahead, zero for no limit
+     * @return
+     */
+    statement& prefetch(size_t rows, size_t bytes = 0)
+    {
+        stop_prefetch();
+        prefetch_rows = rows;
+        prefetch_bytes = bytes;
+        return *this;
+    }
+
+    /**
+     * Function cancels currently running SQL statements, in prefetch mode the
+     * producer thread is stopped first and the read ahead rows are dropped
      * @return true if canceled, false otherwise
      */
     bool cancel()
     {
+        if (nullptr != prefetcher)
+            prefetcher->cancel();
         return stmt_impl->cancel();
     }
     
@@ -148,107 +271,271 @@ public:
      */
     int proc_retval()
     {
+        stop_prefetch();
         return stmt_impl->proc_retval();
     }
     
+    /**
+     * Conversion operator to the concrete database statement implementation
+     * @return 
+     */
+    template <typename T>
+    explicit operator T&() const
+    {
+        return dynamic_cast<T&>(*stmt_impl);
+    }
+
     virtual void set_null(size_t col_idx)
     {
+        stop_prefetch();
         stmt_impl->set_null(col_idx);
     }
     
     virtual void set_short(size_t col_idx, int16_t val)
     {
+        stop_prefetch();
         stmt_impl->set_short(col_idx, val);
     }
     
     virtual void set_ushort(size_t col_idx, uint16_t val)
     {
+        stop_prefetch();
         stmt_impl->set_ushort(col_idx, val);
     }
     
     virtual void set_int(size_t col_idx, int32_t val)
     {
+        stop_prefetch();
         stmt_impl->set_int(col_idx, val);
     }
     
     virtual void set_uint(size_t col_idx, uint32_t val)
     {
+        stop_prefetch();
         stmt_impl->set_uint(col_idx, val);
     }
     
     virtual void set_long(size_t col_idx, int64_t val)
     {
+        stop_prefetch();
         stmt_impl->set_long(col_idx, val);
     }
     
     virtual void set_ulong(size_t col_idx, uint64_t val)
     {
+        stop_prefetch();
         stmt_impl->set_ulong(col_idx, val);
     }
     
     virtual void set_float(size_t col_idx, float val)
     {
+        stop_prefetch();
         stmt_impl->set_float(col_idx, val);
     }
     
     virtual void set_double(size_t col_idx, double val)
     {
+        stop_prefetch();
         stmt_impl->set_double(col_idx, val);
     }
     
     virtual void set_bool(size_t col_idx, bool val)
     {
+        stop_prefetch();
         stmt_impl->set_bool(col_idx, val);
     }
     
     virtual void set_char(size_t col_idx, char val)
     {
+        stop_prefetch();
         stmt_impl->set_char(col_idx, val);
     }
     
     virtual void set_string(size_t col_idx, const std::string& val)
     {
+        stop_prefetch();
         stmt_impl->set_string(col_idx, val);
     }
+
+    /**
+     * Function binds string parameter taking ownership of the string, which
+     * lets the driver use the string memory without copying it
+     * @param col_idx
+     * @param val
+     */
+    virtual void set_string(size_t col_idx, std::string&& val)
+    {
+        stop_prefetch();
+        stmt_impl->set_string(col_idx, std::move(val));
+    }
+
+    /**
+     * Function binds string parameter without copying it, the caller has to
+     * keep the string data unchanged until the statement is executed for the
+     * last time with this parameter value
+     * @param col_idx
+     * @param val
+     */
+    virtual void set_string_view(size_t col_idx, utils::string_view val)
+    {
+        stop_prefetch();
+        stmt_impl->set_string_view(col_idx, val);
+    }
     
     virtual void set_date(size_t col_idx, int val)
     {
+        stop_prefetch();
         stmt_impl->set_date(col_idx, val);
     }
     
     virtual void set_time(size_t col_idx, double val)
     {
+        stop_prefetch();
         stmt_impl->set_time(col_idx, val);
     }
     
     virtual void set_datetime(size_t col_idx, time_t val)
     {
+        stop_prefetch();
         stmt_impl->set_datetime(col_idx, val);
     }
     
     virtual void set_u16char(size_t col_idx, char16_t val)
     {
+        stop_prefetch();
         stmt_impl->set_u16char(col_idx, val);
     }
     
     virtual void set_u16string(size_t col_idx, const std::u16string& val)
     {
+        stop_prefetch();
         stmt_impl->set_u16string(col_idx, val);
     }
     
     virtual void set_binary(size_t col_idx, const std::vector<uint8_t>& val)
     {
+        stop_prefetch();
         stmt_impl->set_binary(col_idx, val);
     }
+
+    /**
+     * Function binds binary parameter taking ownership of the data
+     * @param col_idx
+     * @param val
+     */
+    virtual void set_binary(size_t col_idx, std::vector<uint8_t>&& val)
+    {
+        stop_prefetch();
+        stmt_impl->set_binary(col_idx, std::move(val));
+    }
+
+    /**
+     * Function binds binary parameter without copying it, the caller has to
+     * keep the data unchanged until the statement is executed for the last
+     * time with this parameter value
+     * @param col_idx
+     * @param val
+     */
+    virtual void set_blob_span(size_t col_idx, utils::blob_span val)
+    {
+        stop_prefetch();
+        stmt_impl->set_blob_span(col_idx, val);
+    }
     
 private:
     friend class connection;
     statement(istatement* stmt) : stmt_impl(stmt) { }
+
+    // the prefetch result set is kept alive as result_set objects returned earlier refer to it
+    void stop_prefetch()
+    {
+        if (nullptr != prefetcher)
+            prefetcher->cancel();
+    }
+
+    result_set make_result_set(iresult_set* rs)
+    {
+        if (0 == prefetch_rows)
+            return result_set(rs);
+        if (nullptr == prefetcher)
+            prefetcher.reset(new prefetch_result_set(rs, prefetch_rows, prefetch_bytes));
+        else
+            prefetcher->reset(rs, prefetch_rows, prefetch_bytes);
+        return result_set(prefetcher.get());
+    }
+
+    template <size_t... I, typename... Args>
+    void bind_params(std::index_sequence<I...>, Args&&... args)
+    {
+        int expand[] = { 0, (bind_param(I, std::forward<Args>(args)), 0)... };
+        (void)expand;
+    }
+
+    void bind_param(size_t idx, std::nullptr_t) { stmt_impl->set_null(idx); }
+    void bind_param(size_t idx, bool val) { stmt_impl->set_bool(idx, val); }
+    void bind_param(size_t idx, char val) { stmt_impl->set_char(idx, val); }
+    void bind_param(size_t idx, char16_t val) { stmt_impl->set_u16char(idx, val); }
+    void bind_param(size_t idx, float val) { stmt_impl->set_float(idx, val); }
+    void bind_param(size_t idx, double val) { stmt_impl->set_double(idx, val); }
+    void bind_param(size_t idx, const char* val) { stmt_impl->set_string(idx, std::string(val)); }
+    void bind_param(size_t idx, const std::string& val) { stmt_impl->set_string(idx, val); }
+    void bind_param(size_t idx, std::string&& val) { stmt_impl->set_string(idx, std::move(val)); }
+    void bind_param(size_t idx, utils::string_view val) { stmt_impl->set_string_view(idx, val); }
+    void bind_param(size_t idx, const std::u16string& val) { stmt_impl->set_u16string(idx, val); }
+    void bind_param(size_t idx, const std::vector<uint8_t>& val) { stmt_impl->set_binary(idx, val); }
+    void bind_param(size_t idx, std::vector<uint8_t>&& val) { stmt_impl->set_binary(idx, std::move(val)); }
+    void bind_param(size_t idx, utils::blob_span val) { stmt_impl->set_blob_span(idx, val); }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value && !std::is_same<T, char16_t>::value>::type
+    bind_param(size_t idx, T val)
+    {
+        if (sizeof(T) <= sizeof(int16_t))
+            std::is_signed<T>::value ? stmt_impl->set_short(idx, val) : stmt_impl->set_ushort(idx, val);
+        else if (sizeof(T) <= sizeof(int32_t))
+            std::is_signed<T>::value ? stmt_impl->set_int(idx, val) : stmt_impl->set_uint(idx, val);
+        else
+            std::is_signed<T>::value ? stmt_impl->set_long(idx, val) : stmt_impl->set_ulong(idx, val);
+    }
+
+    template <typename... T, size_t... I>
+    static void init_batch(column_batch& params, const std::tuple<T...>& row, std::index_sequence<I...>)
+    {
+        params.columns.resize(sizeof...(T));
+        int expand[] = { 0, (params.columns[I].type = batch_type(std::get<I>(row)), 0)... };
+        (void)expand;
+    }
+
+    template <typename... T, size_t... I>
+    static void append_batch(column_batch& params, const std::tuple<T...>& row, std::index_sequence<I...>)
+    {
+        int expand[] = { 0, (append_batch(params.columns[I], std::get<I>(row)), 0)... };
+        (void)expand;
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value, data_type>::type batch_type(const T&) { return data_type::INTEGER; }
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, data_type>::type batch_type(const T&) { return data_type::REAL; }
+    static data_type batch_type(const std::string&) { return data_type::TEXT; }
+    static data_type batch_type(const char*) { return data_type::TEXT; }
+    static data_type batch_type(const std::vector<uint8_t>&) { return data_type::BLOB; }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value>::type append_batch(column_batch::column& col, T val) { col.append(static_cast<int64_t>(val)); }
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type append_batch(column_batch::column& col, T val) { col.append(static_cast<double>(val)); }
+    static void append_batch(column_batch::column& col, const std::string& val) { col.append(val.data(), val.size()); }
+    static void append_batch(column_batch::column& col, const char* val) { col.append(val, std::char_traits<char>::length(val)); }
+    static void append_batch(column_batch::column& col, const std::vector<uint8_t>& val) { col.append(reinterpret_cast<const char*>(val.data()), val.size()); }
     statement(const statement&) = delete;
     statement& operator=(const statement&) = delete;
 
 private:
     std::unique_ptr<istatement> stmt_impl;
+    std::unique_ptr<prefetch_result_set> prefetcher;  // lives as long as the statement, destroyed before stmt_impl
+    size_t prefetch_rows = 0;
+    size_t prefetch_bytes = 0;
 
 }; // statement
 
@@ -20,11 +20,20 @@
 #define SYBASE_DRIVER_HPP
 
 #include <ctpublic.h>
+#include <bkpublic.h>
 #include <cstring>
+#include <chrono>
 #include <vector>
+#include <list>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <algorithm>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <array>
+#include <atomic>
 #include <type_traits>
 #include "driver.hpp"
 
@@ -75,6 +84,220 @@ constexpr debug_flag operator|(debug_flag l, debug_flag r) { return debug_flag(u
 class driver;
 class statement;
 class connection;
+class bulk_writer;
+class bulk_reader;
+class poller;
+
+
+
+//=====================================================================================
+
+
+/**
+ * dynamic_cache - is a bounded LRU cache of prepared dynamic SQL statements keyed
+ * by SQL text. Each entry keeps server side statement id and input parameters
+ * description, so the cached statement can be executed without CS_PREPARE and
+ * CS_DESCRIBE_INPUT round trips. Entries are reference counted by statements
+ * using them and only unused entries are evicted, evicted statement ids are
+ * returned to the caller which must deallocate them with CS_DEALLOC.
+ */
+class dynamic_cache
+{
+public:
+    struct entry
+    {
+        std::string id;
+        std::vector<CS_DATAFMT> params;
+        size_t refs = 0;
+    };
+
+    const entry* acquire(const std::string& sql)
+    {
+        if (0 == counters.capacity)
+            return nullptr;
+        auto it = index.find(sql);
+        if (it == index.end())
+        {
+            counters.misses += 1;
+            return nullptr;
+        }
+        counters.hits += 1;
+        entries.splice(entries.begin(), entries, it->second);
+        it->second->second.refs += 1;
+        return &(it->second->second);
+    }
+
+    void insert(const std::string& sql, const std::string& id, const std::vector<CS_DATAFMT>& params, std::vector<std::string>& evicted)
+    {
+        entries.emplace_front(sql, entry());
+        entry& e = entries.front().second;
+        e.id = id;
+        e.params = params;
+        e.refs = 1;
+        index[sql] = entries.begin();
+        evict(evicted);
+    }
+
+    void release(const std::string& sql, std::vector<std::string>& evicted)
+    {
+        auto it = index.find(sql);
+        if (it != index.end() && it->second->second.refs > 0)
+            it->second->second.refs -= 1;
+        evict(evicted);
+    }
+
+    void capacity(size_t cap, std::vector<std::string>& evicted)
+    {
+        counters.capacity = cap;
+        evict(evicted);
+    }
+
+    size_t capacity() const
+    {
+        return counters.capacity;
+    }
+
+    void clear()
+    {
+        entries.clear();
+        index.clear();
+    }
+
+    dbi::cache_stats stats() const
+    {
+        dbi::cache_stats st = counters;
+        st.size = entries.size();
+        return st;
+    }
+
+private:
+    void evict(std::vector<std::string>& evicted)
+    {
+        auto it = entries.end();
+        while (entries.size() > counters.capacity && it != entries.begin())
+        {
+            --it;
+            if (it->second.refs > 0)
+                continue;
+            evicted.push_back(it->second.id);
+            index.erase(it->first);
+            it = entries.erase(it);
+            counters.evictions += 1;
+        }
+    }
+
+private:
+    using lru_list = std::list<std::pair<std::string, entry>>;
+    lru_list entries;
+    std::unordered_map<std::string, lru_list::iterator> index;
+    dbi::cache_stats counters;
+}; // dynamic_cache
+
+
+
+//=====================================================================================
+
+
+/**
+ * metadata_cache - is a thread-safe driver wide cache of stored procedure input
+ * parameters descriptions keyed by server and procedure name (including the
+ * procedure number, eg 'proc;2'), and of server types (ASE or ASA) keyed by
+ * server name. Procedure parameters are cached only if time to live is set.
+ * Please note that unqualified procedure names are resolved in the current
+ * database, so the applications that switch databases should use qualified
+ * names or invalidate the cache.
+ */
+class metadata_cache
+{
+    using clock = std::chrono::steady_clock;
+    using proc_key = std::pair<std::string, std::string>;
+
+    struct proc_entry
+    {
+        std::vector<CS_DATAFMT> params;
+        clock::time_point expires;
+    };
+
+public:
+    void ttl(std::chrono::seconds t)
+    {
+        std::lock_guard<utils::spin_lock> lg(lock);
+        proc_ttl = t;
+        if (proc_ttl.count() <= 0)
+            procs.clear();
+    }
+
+    bool find_proc_params(const std::string& server, const std::string& proc, std::vector<CS_DATAFMT>& params)
+    {
+        std::lock_guard<utils::spin_lock> lg(lock);
+        auto it = procs.find(proc_key(server, proc));
+        if (it == procs.end())
+            return false;
+        if (clock::now() >= it->second.expires)
+        {
+            procs.erase(it);
+            return false;
+        }
+        params = it->second.params;
+        return true;
+    }
+
+    void store_proc_params(const std::string& server, const std::string& proc, const std::vector<CS_DATAFMT>& params)
+    {
+        std::lock_guard<utils::spin_lock> lg(lock);
+        if (proc_ttl.count() > 0)
+        {
+            proc_entry& e = procs[proc_key(server, proc)];
+            e.params = params;
+            e.expires = clock::now() + proc_ttl;
+        }
+    }
+
+    bool find_server_type(const std::string& server, bool& ase)
+    {
+        std::lock_guard<utils::spin_lock> lg(lock);
+        auto it = servers.find(server);
+        if (it == servers.end())
+            return false;
+        ase = it->second;
+        return true;
+    }
+
+    void store_server_type(const std::string& server, bool ase)
+    {
+        std::lock_guard<utils::spin_lock> lg(lock);
+        servers[server] = ase;
+    }
+
+    /**
+     * Function removes cached parameters of the stored procedure on all servers
+     * or all cached data if procedure name is empty
+     * @param proc
+     */
+    void invalidate(const std::string& proc)
+    {
+        std::lock_guard<utils::spin_lock> lg(lock);
+        if (proc.empty())
+        {
+            procs.clear();
+            servers.clear();
+            return;
+        }
+        for (auto it = procs.begin(); it != procs.end();)
+        {
+            if (it->first.second == proc)
+                it = procs.erase(it);
+            else
+                ++it;
+        }
+    }
+
+private:
+    std::chrono::seconds proc_ttl = std::chrono::seconds(0);
+    std::map<proc_key, proc_entry> procs;
+    std::map<std::string, bool> servers;
+    utils::spin_lock lock;
+}; // metadata_cache
 
 
 
@@ -89,7 +312,7 @@ class connection;
  * function call. result_set objects automatically cancel executed
  * queries and destroy allocated memory as they go out of scope.
  */
-class result_set : public dbi::iresult_set
+class result_set final : public dbi::iresult_set
 {
 private:
     struct column_data
@@ -97,6 +320,19 @@ private:
         CS_INT length = 0;
         CS_SMALLINT indicator = 0;
         std::vector<CS_CHAR> data;
+        // per row lengths and indicators of the bound result columns
+        std::vector<CS_INT> lengths;
+        std::vector<CS_SMALLINT> indicators;
+        // parameter value in caller or moved in memory used instead of data
+        CS_VOID* ext = nullptr;
+        CS_VOID* bound = nullptr;
+        std::string str;
+        std::vector<uint8_t> bin;
+
+        CS_VOID* buffer()
+        {
+            return (nullptr != ext ? ext : data.data());
+        }
 
         void allocate(const size_t size)
         {
@@ -104,6 +340,13 @@ private:
             std::memset(data.data(), 0, size);
         }
 
+        void allocate(const size_t size, const size_t rows)
+        {
+            allocate(size * rows);
+            lengths.assign(rows, 0);
+            indicators.assign(rows, 0);
+        }
+
         operator char*()
         {
             return data.data();
@@ -116,6 +359,8 @@ public:
         columndata.clear();
         name2index.clear();
         row_cnt = 0;
+        batch_row = 0;
+        batch_size = 0;
         affected_rows = 0;
         more_res = false;
     }
@@ -127,6 +372,7 @@ public:
 
     virtual bool more_results()
     {
+        batch_end = false;
         return more_res;
     }
 
@@ -154,10 +400,7 @@ public:
 
     virtual int column_index(const std::string& col_name)
     {
-        auto it = name2index.find(col_name);
-        if (it != name2index.end())
-            return it->second;
-        return -1;
+        return name2index.find(col_name);
     }
 
     virtual bool prev()
@@ -185,11 +428,22 @@ public:
             }
             else
             {
+                // walk through rows fetched by the previous array fetch first
+                if (batch_row + 1 < batch_size)
+                {
+                    batch_row += 1;
+                    row_cnt += 1;
+                    fetched_rows += 1;
+                    return true;
+                }
                 if ((CS_SUCCEED == (retcode = ct_fetch(cscommand, CS_UNUSED, CS_UNUSED, CS_UNUSED, &result))) || CS_ROW_FAIL == retcode)
                 {
                     if (CS_ROW_FAIL == retcode)
-                        throw std::runtime_error(std::string(__FUNCTION__).append(": Error fetching row ").append(std::to_string(result)));
-                    row_cnt += result;
+                        throw std::runtime_error(std::string(__FUNCTION__).append(": Error fetching row ").append(std::to_string(row_cnt + result)));
+                    batch_row = 0;
+                    batch_size = result;
+                    row_cnt += 1;
+                    fetched_rows += 1;
                     return true;
                 }
                 else
@@ -203,7 +457,7 @@ public:
     {
         if (col_idx >= columns.size())
             throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column index"));
-        return (CS_NULLDATA == columndata[col_idx].indicator);
+        return (CS_NULLDATA == columndata[col_idx].indicators[batch_row]);
     }
 
     virtual int16_t get_short(size_t col_idx)
@@ -334,7 +588,7 @@ public:
     {
         if (CS_REAL_TYPE == columns[col_idx].datatype)
             return get<CS_REAL>(col_idx);
-        if (CS_FLOAT_TYPE == columns[col_idx].datatype && columndata[col_idx].length <= 4)
+        if (CS_FLOAT_TYPE == columns[col_idx].datatype && cell_length(col_idx) <= 4)
             return get<CS_FLOAT>(col_idx);
         throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type (supported: real, float(p) if p < 16)"));
     }
@@ -401,7 +655,33 @@ public:
             default:
                 throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type (supported: char, varchar, text)"));
         }
-        return std::move(std::string((char*)columndata[col_idx], 0, columndata[col_idx].data.size()));
+        return std::string(cell(col_idx), cell_length(col_idx));
+    }
+
+    virtual void get_string(size_t col_idx, std::string& out)
+    {
+        auto sv = get_string_view(col_idx);
+        out.assign(sv.data(), sv.size());
+    }
+
+    virtual utils::string_view get_string_view(size_t col_idx)
+    {
+        switch (columns[col_idx].datatype)
+        {
+            case CS_CHAR_TYPE:
+            case CS_LONGCHAR_TYPE:
+            case CS_TEXT_TYPE:
+            case CS_VARCHAR_TYPE:
+            case CS_BOUNDARY_TYPE:
+            case CS_SENSITIVITY_TYPE:
+#ifdef CS_XML_TYPE
+            case CS_XML_TYPE:
+#endif
+                break;
+            default:
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type (supported: char, varchar, text)"));
+        }
+        return utils::string_view(cell(col_idx), cell_length(col_idx));
     }
 
     virtual int get_date(size_t col_idx)
@@ -473,7 +753,7 @@ public:
             default:
                 throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type: ").append(std::to_string(columns[col_idx].datatype)));
         }
-        return std::move(std::u16string(reinterpret_cast<char16_t*>((char*)columndata[col_idx]), 0, columndata[col_idx].data.size() / sizeof(char16_t)));
+        return std::u16string(reinterpret_cast<char16_t*>(cell(col_idx)), cell_length(col_idx) / sizeof(char16_t));
     }
 
     virtual std::vector<uint8_t> get_binary(size_t col_idx)
@@ -491,11 +771,53 @@ public:
             default:
                 throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type: ").append(std::to_string(columns[col_idx].datatype)));
         }
-        std::vector<uint8_t> t(columndata[col_idx].length);
-        std::memcpy(reinterpret_cast<void*>(t.data()), columndata[col_idx], columndata[col_idx].length);
+        std::vector<uint8_t> t(cell_length(col_idx));
+        std::memcpy(reinterpret_cast<void*>(t.data()), cell(col_idx), t.size());
         return std::move(t);
     }
 
+    virtual void get_binary(size_t col_idx, std::vector<uint8_t>& out)
+    {
+        auto blob = get_blob_span(col_idx);
+        out.assign(blob.begin(), blob.end());
+    }
+
+    virtual utils::blob_span get_blob_span(size_t col_idx)
+    {
+        switch (columns[col_idx].datatype)
+        {
+            case CS_IMAGE_TYPE:
+            case CS_BINARY_TYPE:
+            case CS_VARBINARY_TYPE:
+            case CS_LONGBINARY_TYPE:
+#ifdef CS_BLOB_TYPE
+            case CS_BLOB_TYPE:
+#endif
+                break;
+            default:
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type: ").append(std::to_string(columns[col_idx].datatype)));
+        }
+        return utils::blob_span(reinterpret_cast<const uint8_t*>(cell(col_idx)), cell_length(col_idx));
+    }
+
+    virtual size_t fetch_batch(size_t rows, dbi::column_batch& batch)
+    {
+        batch.clear();
+        // next() moves to the next data set at the end of data, its rows are fetched after more_results() call
+        if (batch_end)
+            return 0;
+        while (batch.rows < rows)
+        {
+            if (false == result_set::next())
+            {
+                batch_end = true;
+                break;
+            }
+            append_row(batch);
+        }
+        return batch.rows;
+    }
+
     bool cancel()
     {
         if (CS_SUCCEED != ct_cancel(nullptr, cscommand, CS_CANCEL_ALL))
@@ -505,6 +827,9 @@ public:
 
 private:
     friend class statement;
+    friend class bulk_writer;
+    friend class bulk_reader;
+    friend class poller;
 
     result_set() {}
     result_set(const result_set&) = delete;
@@ -562,17 +887,19 @@ private:
     {
         switch (res)
         {
+        case CS_ROW_RESULT:
+            process_result(false, true, fetch_rows);
+            return true;
         case CS_PARAM_RESULT:
         case CS_STATUS_RESULT:
-        case CS_ROW_RESULT:
         case CS_CURSOR_RESULT:
-            process_result(false, true);
+            process_result(false, true, 1);
             return true;
         case CS_COMPUTE_RESULT:
-            process_result(true, true);
+            process_result(true, true, 1);
             return true;
         case CS_DESCRIBE_RESULT:
-            process_result(false, false);
+            process_result(false, false, 1);
             break;
         case CS_CMD_DONE:
             if (CS_SUCCEED != ct_res_info(cscommand, CS_ROW_COUNT, &res, CS_UNUSED, nullptr))
@@ -593,7 +920,13 @@ private:
         return false;
     }
 
-    void process_result(bool compute, bool bind)
+    /**
+     * Function describes and binds result columns
+     * @param compute true for compute results
+     * @param bind true to bind columns data buffers
+     * @param rows number of rows fetched at once, zero to calculate it from the row width
+     */
+    void process_result(bool compute, bool bind, size_t rows)
     {
         auto colcnt = 0;
         if (CS_SUCCEED != ct_res_info(cscommand, CS_NUMDATA, &colcnt, CS_UNUSED, nullptr))
@@ -634,11 +967,22 @@ private:
             }
             else if (::strlen(columns[i].name) == 0)
                 std::sprintf(columns[i].name, "column%d", i + 1);
-            name2index[columns[i].name] = i;
-            columndata[i].allocate(columns[i].maxlength);
+            name2index.insert(columns[i].name, i);
+        }
+        if (0 == rows)
+        {
+            size_t width = 0;
+            for (auto& col : columns)
+                width += col.maxlength;
+            rows = std::max<size_t>(1, std::min<size_t>(max_fetch_rows, fetch_buffer_size / std::max<size_t>(1, width)));
+        }
+        for (auto i = 0; i < colcnt; ++i)
+        {
+            columndata[i].allocate(columns[i].maxlength, rows);
             if (bind)
             {
-                if (CS_SUCCEED != ct_bind(cscommand, i + 1, &(columns[i]), columndata[i], &(columndata[i].length), &(columndata[i].indicator)))
+                columns[i].count = rows;
+                if (CS_SUCCEED != ct_bind(cscommand, i + 1, &(columns[i]), columndata[i], columndata[i].lengths.data(), columndata[i].indicators.data()))
                     throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to bind column ").append(std::to_string(i)));
             }
         }
@@ -671,82 +1015,245 @@ private:
             throw std::runtime_error(std::string(__FUNCTION__).append(": The function can only be called if scrollable cursor is used "));
     }
 
-    template<typename T>
-    T get(size_t col_idx)
+    /**
+     * Function appends current row to the columnar batch
+     * @param batch
+     */
+    void append_row(dbi::column_batch& batch)
     {
-        if (is_null(col_idx))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Can't convert NULL data"));
-        switch (columns[col_idx].datatype)
+        if (0 == batch.rows)
         {
-            case CS_NUMERIC_TYPE:
-            case CS_DECIMAL_TYPE:
-            case CS_MONEY_TYPE:
-            case CS_MONEY4_TYPE:
+            batch.columns.resize(columns.size());
+            for (size_t i = 0; i < columns.size(); ++i)
             {
-                double num = 0.0;
-                std::memset(&destfmt, 0, sizeof(destfmt));
-                destfmt.maxlength = sizeof(num);
-                destfmt.datatype = CS_FLOAT_TYPE;
-                destfmt.format = CS_FMT_UNUSED;
-                destfmt.locale = nullptr;
-                if (CS_SUCCEED != cs_convert(cscontext, &columns[col_idx], static_cast<CS_VOID*>(columndata[col_idx]), &destfmt, &num, 0))
-                    throw std::runtime_error(std::string(__FUNCTION__).append(": cs_convert failed"));
-                return num;
+                batch.columns[i].name = columns[i].name;
+                batch.columns[i].type = batch_type(i);
+                batch.columns[i].clear();
             }
         }
-        if (sizeof(T) < columndata[col_idx].data.size())
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Sybase data type is larger than the primitive data type"));
-        return *(reinterpret_cast<T*>((char*)columndata[col_idx]));
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            auto& col = batch.columns[i];
+            if (result_set::is_null(i))
+                col.append_null();
+            else
+            {
+                switch (col.type)
+                {
+                    case dbi::data_type::INTEGER:
+                        col.append(get_integer(i));
+                        break;
+                    case dbi::data_type::REAL:
+                        col.append(result_set::get_double(i));
+                        break;
+                    case dbi::data_type::BLOB:
+                        col.append(cell(i), cell_length(i));
+                        break;
+                    case dbi::data_type::TEXT:
+                        append_text(col, i);
+                        break;
+                }
+            }
+        }
+        ++batch.rows;
     }
 
-    void getdt(size_t col_idx)
+    char* cell(size_t col_idx)
+    {
+        return columndata[col_idx].data.data() + batch_row * columns[col_idx].maxlength;
+    }
+
+    CS_INT cell_length(size_t col_idx) const
+    {
+        return columndata[col_idx].lengths[batch_row];
+    }
+
+    dbi::data_type batch_type(size_t col_idx)
     {
-        if (is_null(col_idx))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Can't convert NULL data"));
         switch (columns[col_idx].datatype)
         {
-            case CS_DATETIME_TYPE:
-            case CS_DATETIME4_TYPE:
-#ifdef CS_DATE_TYPE
-            case CS_DATE_TYPE:
+            case CS_BIT_TYPE:
+            case CS_TINYINT_TYPE:
+            case CS_SMALLINT_TYPE:
+            case CS_USHORT_TYPE:
+            case CS_INT_TYPE:
+            case CS_LONG_TYPE:
+#ifdef CS_USMALLINT_TYPE
+            case CS_USMALLINT_TYPE:
 #endif
-#ifdef CS_TIME_TYPE
-            case CS_TIME_TYPE:
+#ifdef CS_UINT_TYPE
+            case CS_UINT_TYPE:
 #endif
-#ifdef CS_BIGDATETIME_TYPE
-            case CS_BIGDATETIME_TYPE:
+#ifdef CS_BIGINT_TYPE
+            case CS_BIGINT_TYPE:
 #endif
-#ifdef CS_BIGTIME_TYPE
-            case CS_BIGTIME_TYPE:
+#ifdef CS_UBIGINT_TYPE
+            case CS_UBIGINT_TYPE:
 #endif
-                break;
+                return dbi::data_type::INTEGER;
+            case CS_REAL_TYPE:
+            case CS_FLOAT_TYPE:
+            case CS_MONEY_TYPE:
+            case CS_MONEY4_TYPE:
+            case CS_DECIMAL_TYPE:
+            case CS_NUMERIC_TYPE:
+                return dbi::data_type::REAL;
+            case CS_IMAGE_TYPE:
+            case CS_BINARY_TYPE:
+            case CS_VARBINARY_TYPE:
+            case CS_LONGBINARY_TYPE:
+#ifdef CS_BLOB_TYPE
+            case CS_BLOB_TYPE:
+#endif
+                return dbi::data_type::BLOB;
             default:
-                throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type (supported: date, time, datetime, smalldatetime, bigdatetime)"));
+                return dbi::data_type::TEXT;
         }
-        std::memset(&daterec, 0, sizeof(daterec));
-        if (CS_SUCCEED != cs_dt_crack(cscontext, columns[col_idx].datatype, static_cast<CS_VOID*>(columndata[col_idx]), &daterec))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": cs_dt_crack failed"));
     }
 
-private:
-    bool scrollable = false;
-    bool do_cancel = false;
-    long row_cnt = 0;
-    size_t affected_rows = 0;
-    bool more_res = false;
-    Context* cscontext = nullptr;
-    CS_COMMAND* cscommand = nullptr;
-    CS_RETCODE retcode;
-    CS_INT result;
-    CS_DATAFMT destfmt;
-    CS_DATEREC daterec;
-    struct tm stm;
-    std::map<std::string, int> name2index;
-    std::vector<CS_DATAFMT> columns;
-    std::vector<column_data> columndata;
-}; // result_set
-
-
+    int64_t get_integer(size_t col_idx)
+    {
+        switch (columns[col_idx].datatype)
+        {
+            case CS_BIT_TYPE:
+                return get<bool>(col_idx);
+            case CS_USHORT_TYPE:
+                return get<CS_USHORT>(col_idx);
+#ifdef CS_UBIGINT_TYPE
+            case CS_UBIGINT_TYPE:
+                return get<CS_UBIGINT>(col_idx);
+#endif
+            default:
+                return result_set::get_long(col_idx);
+        }
+    }
+
+    void append_text(dbi::column_batch::column& col, size_t col_idx)
+    {
+        switch (columns[col_idx].datatype)
+        {
+            case CS_CHAR_TYPE:
+            case CS_LONGCHAR_TYPE:
+            case CS_TEXT_TYPE:
+            case CS_VARCHAR_TYPE:
+            case CS_BOUNDARY_TYPE:
+            case CS_SENSITIVITY_TYPE:
+#ifdef CS_XML_TYPE
+            case CS_XML_TYPE:
+#endif
+                col.append(cell(col_idx), cell_length(col_idx));
+                break;
+            default:
+            {
+                // dates, unichar and other types are converted to character data
+                CS_DATAFMT srcfmt = columns[col_idx];
+                srcfmt.maxlength = cell_length(col_idx);
+                srcfmt.count = 1;
+                CS_DATAFMT destfmt;
+                std::memset(&destfmt, 0, sizeof(destfmt));
+                destfmt.datatype = CS_CHAR_TYPE;
+                destfmt.format = CS_FMT_UNUSED;
+                destfmt.locale = nullptr;
+                destfmt.maxlength = columns[col_idx].maxlength * 2 + 64;
+                convbuf.resize(destfmt.maxlength);
+                CS_INT len = 0;
+                if (CS_SUCCEED != cs_convert(cscontext, &srcfmt, static_cast<CS_VOID*>(cell(col_idx)), &destfmt, convbuf.data(), &len))
+                    throw std::runtime_error(std::string(__FUNCTION__).append(": cs_convert failed"));
+                col.append(convbuf.data(), len);
+            }
+        }
+    }
+
+    template<typename T>
+    T get(size_t col_idx)
+    {
+        if (is_null(col_idx))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Can't convert NULL data"));
+        switch (columns[col_idx].datatype)
+        {
+            case CS_NUMERIC_TYPE:
+            case CS_DECIMAL_TYPE:
+            case CS_MONEY_TYPE:
+            case CS_MONEY4_TYPE:
+            {
+                double num = 0.0;
+                std::memset(&destfmt, 0, sizeof(destfmt));
+                destfmt.maxlength = sizeof(num);
+                destfmt.datatype = CS_FLOAT_TYPE;
+                destfmt.format = CS_FMT_UNUSED;
+                destfmt.locale = nullptr;
+                if (CS_SUCCEED != cs_convert(cscontext, &columns[col_idx], static_cast<CS_VOID*>(cell(col_idx)), &destfmt, &num, 0))
+                    throw std::runtime_error(std::string(__FUNCTION__).append(": cs_convert failed"));
+                return num;
+            }
+        }
+        if (sizeof(T) < static_cast<size_t>(columns[col_idx].maxlength))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Sybase data type is larger than the primitive data type"));
+        return *(reinterpret_cast<T*>(cell(col_idx)));
+    }
+
+    void getdt(size_t col_idx)
+    {
+        if (is_null(col_idx))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Can't convert NULL data"));
+        switch (columns[col_idx].datatype)
+        {
+            case CS_DATETIME_TYPE:
+            case CS_DATETIME4_TYPE:
+#ifdef CS_DATE_TYPE
+            case CS_DATE_TYPE:
+#endif
+#ifdef CS_TIME_TYPE
+            case CS_TIME_TYPE:
+#endif
+#ifdef CS_BIGDATETIME_TYPE
+            case CS_BIGDATETIME_TYPE:
+#endif
+#ifdef CS_BIGTIME_TYPE
+            case CS_BIGTIME_TYPE:
+#endif
+                break;
+            default:
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid column data type (supported: date, time, datetime, smalldatetime, bigdatetime)"));
+        }
+        std::memset(&daterec, 0, sizeof(daterec));
+        if (CS_SUCCEED != cs_dt_crack(cscontext, columns[col_idx].datatype, static_cast<CS_VOID*>(cell(col_idx)), &daterec))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": cs_dt_crack failed"));
+    }
+
+private:
+    // array fetch is limited by the buffer size and the maximum number of rows
+    static constexpr size_t fetch_buffer_size = 64 * 1024;
+    static constexpr size_t max_fetch_rows = 1024;
+
+    bool scrollable = false;
+    bool do_cancel = false;
+    long row_cnt = 0;
+    // rows fetched by next() from all data sets of the command, unlike row_cnt it is not reset by clear()
+    size_t fetched_rows = 0;
+    bool batch_end = false;     // fetch_batch() reached the end of the current data set
+    size_t fetch_rows = 1;
+    size_t batch_row = 0;
+    size_t batch_size = 0;
+    std::vector<char> convbuf;
+    size_t affected_rows = 0;
+    bool more_res = false;
+    Context* cscontext = nullptr;
+    CS_COMMAND* cscommand = nullptr;
+    CS_RETCODE retcode;
+    CS_INT result;
+    CS_DATAFMT destfmt;
+    CS_DATEREC daterec;
+    struct tm stm;
+    utils::index_map name2index;
+    std::vector<CS_DATAFMT> columns;
+    std::vector<column_data> columndata;
+}; // result_set
+
+constexpr size_t result_set::fetch_buffer_size;
+constexpr size_t result_set::max_fetch_rows;
+
+
 
 //=====================================================================================
 
@@ -758,7 +1265,7 @@ private:
  * get_connection() function call. connection objects automatically delete the
  * native connection handle they manage as soon as they themselves are destroyed.
  */
-class connection : public dbi::iconnection
+class connection final : public dbi::iconnection
 {
 public:
     virtual ~connection()
@@ -767,10 +1274,10 @@ public:
     }
 
     connection(connection&& conn)
-        : ase(conn.ase), is_autocommit(conn.is_autocommit),
-          cscontext(conn.cscontext), csconnection(conn.csconnection),
+        : ase(conn.ase), is_autocommit(conn.is_autocommit), fetch_rows_cnt(conn.fetch_rows_cnt),
+          mdcache(conn.mdcache), cscontext(conn.cscontext), csconnection(conn.csconnection),
           server(std::move(conn.server)), user(std::move(conn.user)),
-          passwd(std::move(conn.passwd))
+          passwd(std::move(conn.passwd)), dyn_cache(std::move(conn.dyn_cache))
     {
         conn.cscontext = nullptr;
         conn.csconnection = nullptr;
@@ -783,6 +1290,8 @@ public:
             destroy();
             ase = conn.ase;
             is_autocommit = conn.is_autocommit;
+            fetch_rows_cnt = conn.fetch_rows_cnt;
+            mdcache = conn.mdcache;
             cscontext = conn.cscontext;
             csconnection = conn.csconnection;
             conn.cscontext = nullptr;
@@ -790,6 +1299,7 @@ public:
             server = std::move(conn.server);
             user = std::move(conn.user);
             passwd = std::move(conn.passwd);
+            dyn_cache = std::move(conn.dyn_cache);
         }
         return *this;
     }
@@ -799,12 +1309,21 @@ public:
         if (true == connected())
             disconnect();
         if (nullptr != csconnection && CS_SUCCEED == ct_connect(csconnection, (server.empty() ? nullptr : const_cast<CS_CHAR*>(server.c_str())), server.empty() ? 0 : CS_NULLTERM))
-            is_server_ase();
+        {
+            if (nullptr == mdcache || false == mdcache->find_server_type(server, ase))
+            {
+                is_server_ase();
+                if (nullptr != mdcache)
+                    mdcache->store_server_type(server, ase);
+            }
+        }
         return alive();
     }
 
     virtual void disconnect()
     {
+        // dynamic statements are dropped by the server on disconnect
+        dyn_cache.clear();
         if (nullptr != csconnection)
         {
             CS_INT stat = 0;
@@ -879,6 +1398,13 @@ public:
 
     virtual dbi::istatement* get_statement(dbi::iconnection& iconn);
 
+    virtual void statement_cache(size_t capacity);
+
+    virtual dbi::cache_stats statement_cache_stats() const
+    {
+        return dyn_cache.stats();
+    }
+
 
     template<typename T>
     connection& userdata(T& user_struct)
@@ -920,16 +1446,34 @@ public:
         return ase;
     }
 
+    /**
+     * Function sets number of rows fetched from the server at once by
+     * subsequently executed statements (only regular row results are fetched
+     * in batches, cursors, stored procedure parameters and compute results are
+     * always fetched by one row). Default is 1, zero means the number of rows is
+     * calculated from the row width.
+     * @param rows
+     * @return
+     */
+    connection& fetch_rows(size_t rows)
+    {
+        fetch_rows_cnt = rows;
+        return *this;
+    }
+
 private:
     friend class driver;
     friend class statement;
+    friend class bulk_writer;
+    friend class bulk_reader;
+    friend class poller;
 
     connection() = delete;
     connection(const connection&) = delete;
     connection& operator=(const connection&) = delete;
 
-    connection(Context* context, CS_INT dbg_flag, const std::string& protofile, const std::string& server, const std::string& user, const std::string& passwd)
-        : cscontext(context), server(server), user(user), passwd(passwd)
+    connection(Context* context, metadata_cache* mdcache, CS_INT dbg_flag, const std::string& protofile, const std::string& server, const std::string& user, const std::string& passwd)
+        : mdcache(mdcache), cscontext(context), server(server), user(user), passwd(passwd)
     {
         if (CS_SUCCEED != ct_con_alloc(cscontext, &csconnection))
             throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to allocate connection struct"));
@@ -966,11 +1510,14 @@ private:
 private:
     bool ase = false;
     CS_BOOL is_autocommit = CS_TRUE;
+    size_t fetch_rows_cnt = 1;
+    metadata_cache* mdcache = nullptr;
     Context* cscontext = nullptr;
     Connection* csconnection = nullptr;
     std::string server;
     std::string user;
     std::string passwd;
+    dynamic_cache dyn_cache;
 };
 
 
@@ -985,6 +1532,10 @@ private:
 class driver : public idriver
 {
 public:
+    using connection_type = connection;
+    using statement_type = statement;
+    using result_set_type = result_set;
+
     ~driver()
     {
         if (cslocale != nullptr && cscontext != nullptr)
@@ -994,7 +1545,31 @@ public:
 
     dbi::connection get_connection(const std::string& server, const std::string& user = "", const std::string& passwd = "")
     {
-        return create_connection(new connection(cscontext, dbg_flag, protofile, server, user, passwd));
+        return create_connection(new connection(cscontext, &mdcache, dbg_flag, protofile, server, user, passwd));
+    }
+
+    /**
+     * Function sets time to live of cached stored procedure parameters
+     * descriptions, zero (default) disables the cache
+     * @param ttl
+     * @return
+     */
+    driver& proc_cache_ttl(std::chrono::seconds ttl)
+    {
+        mdcache.ttl(ttl);
+        return *this;
+    }
+
+    /**
+     * Function removes cached parameters descriptions of the stored procedure
+     * or all cached metadata (including server types) if procedure name is empty
+     * @param proc
+     * @return
+     */
+    driver& invalidate_proc_cache(const std::string& proc = "")
+    {
+        mdcache.invalidate(proc);
+        return *this;
     }
 
     driver& debug(debug_flag flag)
@@ -1176,6 +1751,7 @@ public:
     }
 
 protected:
+    friend class poller;
     driver(const driver&) = delete;
     driver(driver&&) = delete;
     driver& operator=(const driver&) = delete;
@@ -1304,6 +1880,7 @@ private:
     Context* cscontext = nullptr;
     CS_INT dbg_flag = 0;
     std::string protofile;
+    metadata_cache mdcache;
     utils::spin_lock lock;
 }; // driver
 
@@ -1325,13 +1902,19 @@ constexpr std::array<const char*, 8> driver::severity;
  * get_statement() function call. statement objects automatically cancel executed
  * queries and destroy result set as they go out of scope.
  */
-class statement : public dbi::istatement
+class statement final : public dbi::istatement
 {
 public:
     ~statement()
     {
         cancel();
         close_cursor();
+        try
+        {
+            release_dynamic();
+        }
+        catch (...)
+        { }
         ct_cmd_drop(cscommand);
     }
 
@@ -1344,8 +1927,13 @@ public:
     {
         if (false == conn.alive())
             throw std::runtime_error(std::string(__FUNCTION__).append(": Database connection is dead"));
+        if (rebind)
+            init_params();
         if (CS_SUCCEED != ct_send(cscommand))
             throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to send command: ").append(command));
+        rs.fetch_rows = conn.fetch_rows_cnt;
+        rs.fetched_rows = 0;
+        rs.batch_end = false;
         rs.next_result();
         return &rs;
     }
@@ -1362,39 +1950,48 @@ public:
     virtual void prepare(const std::string& cmd)
     {
         set_command(cmd, CS_LANG_CMD);
-        std::string csid = genid("proc");
         if (false == conn.alive())
             throw std::runtime_error(std::string(__FUNCTION__).append(": Database connection is dead"));
-        if (CS_SUCCEED != ct_dynamic(cscommand, CS_PREPARE, const_cast<CS_CHAR*>(csid.c_str()), CS_NULLTERM, const_cast<CS_CHAR*>(command.c_str()), CS_NULLTERM))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to prepare command"));
-        execute();
-        if (CS_SUCCEED != ct_dynamic(cscommand, CS_DESCRIBE_INPUT, const_cast<CS_CHAR*>(csid.c_str()), CS_NULLTERM, nullptr, CS_UNUSED))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to get input params decription"));
-        execute();
-        if (CS_SUCCEED != ct_dynamic(cscommand, CS_EXECUTE, const_cast<CS_CHAR*>(csid.c_str()), CS_NULLTERM, nullptr, CS_UNUSED))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set command for execution"));
-        param_datafmt.resize(rs.columns.size());
-        param_data.resize(rs.columns.size());
-        for (auto i = 0U; i < rs.columns.size(); ++i)
+        std::string csid;
+        const dynamic_cache::entry* cached = conn.dyn_cache.acquire(command);
+        if (nullptr != cached)
         {
-            param_datafmt[i] = rs.columns[i];
-            param_data[i].allocate(rs.columns[i].maxlength);
-            if (CS_SUCCEED != ct_setparam(cscommand, &(param_datafmt[i]), param_data[i], &(param_data[i].length), &(param_data[i].indicator)))
-                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set param, index ").append(std::to_string(i)));
+            csid = cached->id;
+            param_datafmt = cached->params;
+            cache_key = command;
+        }
+        else
+        {
+            csid = genid("proc");
+            if (CS_SUCCEED != ct_dynamic(cscommand, CS_PREPARE, const_cast<CS_CHAR*>(csid.c_str()), CS_NULLTERM, const_cast<CS_CHAR*>(command.c_str()), CS_NULLTERM))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to prepare command"));
+            execute();
+            dynid = csid;
+            if (CS_SUCCEED != ct_dynamic(cscommand, CS_DESCRIBE_INPUT, const_cast<CS_CHAR*>(csid.c_str()), CS_NULLTERM, nullptr, CS_UNUSED))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to get input params decription"));
+            execute();
+            param_datafmt = rs.columns;
+            if (conn.dyn_cache.capacity() > 0)
+            {
+                std::vector<std::string> evicted;
+                conn.dyn_cache.insert(command, csid, param_datafmt, evicted);
+                cache_key = command;
+                dynid.clear();
+                deallocate(evicted);
+            }
         }
+        execid = csid;
+        param_data.resize(param_datafmt.size());
+        for (auto i = 0U; i < param_datafmt.size(); ++i)
+            param_data[i].allocate(param_datafmt[i].maxlength);
+        init_params();
     }
 
     virtual void call(const std::string& cmd)
     {
         get_proc_params(cmd);;
         set_command(cmd, CS_RPC_CMD);
-        if (CS_SUCCEED != ct_command(cscommand, CS_RPC_CMD, const_cast<CS_CHAR*>(cmd.c_str()), CS_NULLTERM, CS_NO_RECOMPILE))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set stored proc command"));
-        for (auto i = 0U; i < param_datafmt.size(); ++i)
-        {
-            if (CS_SUCCEED != ct_setparam(cscommand, &(param_datafmt[i]), param_data[i], &(param_data[i].length), &(param_data[i].indicator)))
-                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set param, index ").append(std::to_string(i)));
-        }
+        init_params();
     }
     
     virtual int proc_retval()
@@ -1473,15 +2070,26 @@ public:
             throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
         param_data[param_idx].length = val.length();
         if (CS_TEXT_TYPE == param_datafmt[param_idx].datatype)
-        {
-            param_datafmt[param_idx].maxlength = param_data[param_idx].length;
-            param_data[param_idx].allocate(param_data[param_idx].length);
-        }
+            resize_param(param_idx, param_data[param_idx].length);
         if (param_data[param_idx].length > param_datafmt[param_idx].maxlength)
             throw std::runtime_error(std::string(__FUNCTION__).append(": Data length is greater than maximum field size"));
         param_data[param_idx].indicator = 0;
+        set_buffer(param_idx, nullptr);
         std::memcpy(param_data[param_idx], val.c_str(), val.length());
     }
+
+    virtual void set_string(size_t param_idx, std::string&& val)
+    {
+        if (param_idx >= param_data.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        param_data[param_idx].str = std::move(val);
+        set_external(param_idx, &param_data[param_idx].str[0], param_data[param_idx].str.length(), CS_TEXT_TYPE == param_datafmt[param_idx].datatype);
+    }
+
+    virtual void set_string_view(size_t param_idx, utils::string_view val)
+    {
+        set_external(param_idx, val.data(), val.size(), param_idx < param_datafmt.size() && CS_TEXT_TYPE == param_datafmt[param_idx].datatype);
+    }
     
     virtual void set_date(size_t param_idx, int val)
     {
@@ -1526,6 +2134,7 @@ public:
         if (param_data[param_idx].length > param_datafmt[param_idx].maxlength)
             throw std::runtime_error(std::string(__FUNCTION__).append(": Data length is greater than maximum field size"));
         param_data[param_idx].indicator = 0;
+        set_buffer(param_idx, nullptr);
         std::memcpy(param_data[param_idx], &val, param_data[param_idx].length);
     }
     
@@ -1536,14 +2145,12 @@ public:
         param_data[param_idx].length = sizeof(char16_t) * val.length();
 #ifdef CS_UNITEXT_TYPE
         if (CS_UNITEXT_TYPE == param_datafmt[param_idx].datatype)
-        {
-            param_datafmt[param_idx].maxlength = param_data[param_idx].length;
-            param_data[param_idx].allocate(param_data[param_idx].length);
-        }
+            resize_param(param_idx, param_data[param_idx].length);
 #endif  
         if (param_data[param_idx].length > param_datafmt[param_idx].maxlength)
             throw std::runtime_error(std::string(__FUNCTION__).append(": Data length is greater than maximum field size"));
         param_data[param_idx].indicator = 0;
+        set_buffer(param_idx, nullptr);
         std::memcpy(param_data[param_idx], &val[0], param_data[param_idx].length);
     }
     
@@ -1553,16 +2160,96 @@ public:
             throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
         param_data[param_idx].length = val.size();
         if (CS_IMAGE_TYPE == param_datafmt[param_idx].datatype || CS_LONGBINARY_TYPE == param_datafmt[param_idx].datatype)
-        {
-            param_datafmt[param_idx].maxlength = param_data[param_idx].length;
-            param_data[param_idx].allocate(param_data[param_idx].length);
-        }
+            resize_param(param_idx, param_data[param_idx].length);
         if (param_data[param_idx].length > param_datafmt[param_idx].maxlength)
             throw std::runtime_error(std::string(__FUNCTION__).append(": Data length is greater than maximum field size"));
         param_data[param_idx].indicator = 0;
+        set_buffer(param_idx, nullptr);
         std::memcpy(param_data[param_idx], &val[0], param_data[param_idx].length);
     }
 
+    virtual void set_binary(size_t param_idx, std::vector<uint8_t>&& val)
+    {
+        if (param_idx >= param_data.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        param_data[param_idx].bin = std::move(val);
+        set_external(param_idx, param_data[param_idx].bin.data(), param_data[param_idx].bin.size(), is_blob(param_idx));
+    }
+
+    virtual void set_blob_span(size_t param_idx, utils::blob_span val)
+    {
+        set_external(param_idx, val.data(), val.size(), param_idx < param_datafmt.size() && is_blob(param_idx));
+    }
+
+    /**
+     * Function executes the prepared statement once for each row of parameters.
+     * Client-Library has no array binding of dynamic statement parameters, so
+     * each row is a separate command and a round trip to the server, only the
+     * transaction is shared: the rows are run in one transaction unless
+     * auto-commit is off. Failed rows are reported in the result, but if the
+     * server rolls back the transaction after a failed row (eg deadlock) the
+     * rows run before are lost and the whole batch fails.
+     * @param params columnar parameter arrays, one column per parameter
+     * @return per row affected counts and failures
+     */
+    virtual dbi::batch_result execute_batch(const dbi::column_batch& params)
+    {
+        if (params.columns.size() != param_datafmt.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid number of parameters"));
+        dbi::batch_result res;
+        res.affected.reserve(params.rows);
+        std::unique_ptr<dbi::istatement> tx(conn.get_statement(conn));
+        bool own_tx = (TRUE == conn.is_autocommit);
+        bool aborted = false;
+        if (own_tx)
+            tx->execute("begin tran");
+        try
+        {
+            auto level = trancount(*tx);
+            for (size_t row = 0; row < params.rows; ++row)
+            {
+                try
+                {
+                    for (size_t i = 0; i < params.columns.size(); ++i)
+                        set_param(i, params.columns[i], row);
+                    execute();
+                    // the count of affected rows adds up over all results of the command
+                    if (rs.has_data())
+                    {
+                        while (rs.next())
+                        { }
+                    }
+                    res.affected.push_back(rs.rows_affected());
+                }
+                catch (const std::exception& e)
+                {
+                    if (false == conn.alive())
+                        throw;
+                    // the command has to be set up again after a cancel
+                    rebind = true;
+                    if (trancount(*tx) < level)
+                    {
+                        aborted = true;
+                        throw std::runtime_error(std::string(__FUNCTION__).append(": Transaction was rolled back by the server after failure of row ")
+                                .append(std::to_string(row)).append(": ").append(e.what()));
+                    }
+                    res.affected.push_back(0);
+                    res.failed.push_back(row);
+                    res.errors.push_back(e.what());
+                }
+            }
+            if (own_tx)
+                tx->execute("commit tran");
+        }
+        catch (...)
+        {
+            if (own_tx && false == aborted && conn.alive())
+                tx->execute("rollback tran");
+            throw;
+        }
+        return res;
+    }
+
 private:
     friend class connection;
     statement() = delete;
@@ -1576,6 +2263,14 @@ private:
         rs.cscommand = cscommand;
     }
     
+    static int trancount(dbi::istatement& stmt)
+    {
+        dbi::iresult_set* res = stmt.execute("select @@trancount");
+        int cnt = (res->next() ? res->get_int(0) : 0);
+        stmt.cancel();
+        return cnt;
+    }
+
     std::string genid(const std::string& type)
     {
         static std::atomic_int cnt(1);
@@ -1586,75 +2281,250 @@ private:
     
     void set_command(const std::string& cmd, CS_INT type)
     {
-        command = cmd;
-        cmdtype = type;
+        rebind = false;
         rs.cancel();
         rs.set_scrollable(false);
         close_cursor();
+        release_dynamic();
+        execid.clear();
+        command = cmd;
+        cmdtype = type;
     }
-    
-    bool init_command()
+
+    /**
+     * Function initiates stored procedure or dynamic SQL execution command and
+     * binds parameter buffers, it's called again before the next execution when
+     * a parameter buffer is moved
+     */
+    void init_params()
     {
-        if (CS_SUCCEED != ct_command(cscommand, CS_LANG_CMD, const_cast<CS_CHAR*>(command.c_str()), CS_NULLTERM, CS_UNUSED))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set command"));
-        return true;
+        if (CS_RPC_CMD == cmdtype)
+        {
+            if (CS_SUCCEED != ct_command(cscommand, CS_RPC_CMD, const_cast<CS_CHAR*>(command.c_str()), CS_NULLTERM, CS_NO_RECOMPILE))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set stored proc command"));
+        }
+        else if (CS_SUCCEED != ct_dynamic(cscommand, CS_EXECUTE, const_cast<CS_CHAR*>(execid.c_str()), CS_NULLTERM, nullptr, CS_UNUSED))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set command for execution"));
+        for (auto i = 0U; i < param_datafmt.size(); ++i)
+        {
+            param_data[i].bound = param_data[i].buffer();
+            if (CS_SUCCEED != ct_setparam(cscommand, &(param_datafmt[i]), param_data[i].bound, &(param_data[i].length), &(param_data[i].indicator)))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set param, index ").append(std::to_string(i)));
+        }
+        rebind = false;
     }
-    
-    bool init_cursor(bool scrollable)
+
+    void set_buffer(size_t param_idx, const CS_VOID* ext)
     {
-        cursor = true;
-        rs.set_scrollable(scrollable);
-        std::string csid = genid("cursor");
-        if (CS_SUCCEED != ct_cursor(cscommand, CS_CURSOR_DECLARE, const_cast<CS_CHAR*>(csid.c_str()), CS_NULLTERM, const_cast<CS_CHAR*>(command.c_str()), CS_NULLTERM, (scrollable ? CS_SCROLL_CURSOR : CS_READ_ONLY)))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to declare cursor"));
-        if (CS_SUCCEED != ct_cursor(cscommand, CS_CURSOR_OPEN, nullptr, CS_UNUSED, nullptr, CS_UNUSED, CS_UNUSED))
-            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to open cursor"));
-        return true;
+        param_data[param_idx].ext = const_cast<CS_VOID*>(ext);
+        if (param_data[param_idx].buffer() != param_data[param_idx].bound)
+            rebind = true;
     }
-    
-    void close_cursor()
+
+    void resize_param(size_t param_idx, size_t len)
     {
-        if (cursor)
-        {
-            ct_cursor(cscommand, CS_CURSOR_CLOSE, nullptr, CS_UNUSED, nullptr, CS_UNUSED, CS_DEALLOC);
-            cursor = false;
-            execute();
-        }
+        param_datafmt[param_idx].maxlength = len;
+        param_data[param_idx].allocate(len);
+        rebind = true;
     }
-    
-    void get_proc_params(std::string procname)
+
+    void set_external(size_t param_idx, const CS_VOID* val, size_t len, bool resize)
     {
-        param_datafmt.clear();
-        param_data.clear();
-        std::string sql;
-        if (conn.is_ase())
+        if (param_idx >= param_data.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        if (resize && static_cast<size_t>(param_datafmt[param_idx].maxlength) != len)
         {
-            std::string procnum = "1";
-            std::string sysprefix = "dbo";
-            if (2 == std::count(procname.begin(), procname.end(), '.'))
-                sysprefix.insert(0, procname.substr(0, procname.find('.') + 1));
-            std::size_t pos = procname.find(';');
-            if (std::string::npos != pos)        
-            {
-                procnum = procname.substr(pos + 1);
-                procname.erase(pos);
-            }
-            sql = "select c.name, c.usertype, c.length, c.prec, c.scale, c.status2 from " +
-                  sysprefix + ".sysobjects o, " + sysprefix + ".syscolumns c where o.id = object_id('" +
-                  procname + "') and o.type = 'P' and o.id = c.id and c.number = " +
-                  procnum + " order by c.colid";
+            param_datafmt[param_idx].maxlength = len;
+            rebind = true;
         }
-        else
+        if (len > static_cast<size_t>(param_datafmt[param_idx].maxlength))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Data length is greater than maximum field size"));
+        param_data[param_idx].length = len;
+        param_data[param_idx].indicator = 0;
+        set_buffer(param_idx, val);
+    }
+
+    void set_param(size_t param_idx, const dbi::column_batch::column& col, size_t row)
+    {
+        if (col.is_null(row))
         {
-            sql = "select m.parm_name, m.domain_id, m.width, m.width, m.scale, case m.parm_mode_out when 'Y' then 2 else 1 end from sysobjects o, sysprocedure p, sysprocparm m where o.id = object_id('" + 
-                  procname + "') and o.type = 'P' and o.name = p.proc_name and o.uid = p.creator and m.proc_id = p.proc_id and m.parm_type = 0 order by m.parm_id";
+            set_null(param_idx);
+            return;
         }
-        execute(sql);
-        while (rs.next())
+        switch (col.type)
         {
-            param_datafmt.push_back(CS_DATAFMT());
-            CS_DATAFMT& datafmt = *param_datafmt.rbegin();
-            memset(&datafmt, 0, sizeof(datafmt));
+            case dbi::data_type::INTEGER:
+            {
+#ifdef CS_BIGINT_TYPE
+                CS_BIGINT val = col.get_long(row);
+                set_converted(param_idx, CS_BIGINT_TYPE, &val, sizeof(val));
+#else
+                CS_FLOAT val = col.get_long(row);
+                set_converted(param_idx, CS_FLOAT_TYPE, &val, sizeof(val));
+#endif
+                break;
+            }
+            case dbi::data_type::REAL:
+            {
+                CS_FLOAT val = col.get_double(row);
+                set_converted(param_idx, CS_FLOAT_TYPE, &val, sizeof(val));
+                break;
+            }
+            case dbi::data_type::TEXT:
+                switch (param_datafmt[param_idx].datatype)
+                {
+                    case CS_CHAR_TYPE:
+                    case CS_VARCHAR_TYPE:
+                    case CS_LONGCHAR_TYPE:
+                    case CS_TEXT_TYPE:
+                        set_external(param_idx, col.data(row), col.length(row), CS_TEXT_TYPE == param_datafmt[param_idx].datatype);
+                        break;
+                    default:
+                        set_converted(param_idx, CS_CHAR_TYPE, col.data(row), col.length(row));
+                }
+                break;
+            case dbi::data_type::BLOB:
+                set_external(param_idx, col.data(row), col.length(row), is_blob(param_idx));
+                break;
+        }
+    }
+
+    void set_converted(size_t param_idx, CS_INT datatype, const CS_VOID* val, size_t len)
+    {
+        set_buffer(param_idx, nullptr);
+        if (datatype == param_datafmt[param_idx].datatype && len == static_cast<size_t>(param_datafmt[param_idx].maxlength))
+        {
+            std::memcpy(param_data[param_idx], val, len);
+            param_data[param_idx].length = len;
+        }
+        else
+        {
+            std::memset(&srcfmt, 0, sizeof(srcfmt));
+            srcfmt.datatype = datatype;
+            srcfmt.format = CS_FMT_UNUSED;
+            srcfmt.locale = nullptr;
+            srcfmt.maxlength = len;
+            if (CS_SUCCEED != cs_convert(conn.cscontext, &srcfmt, const_cast<CS_VOID*>(val), &param_datafmt[param_idx], param_data[param_idx], &param_data[param_idx].length))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": cs_convert failed for parameter ").append(std::to_string(param_idx)));
+        }
+        param_data[param_idx].indicator = 0;
+    }
+
+    bool is_blob(size_t param_idx)
+    {
+        return (CS_IMAGE_TYPE == param_datafmt[param_idx].datatype || CS_LONGBINARY_TYPE == param_datafmt[param_idx].datatype);
+    }
+
+    /**
+     * Function releases dynamic SQL statement used by the statement, statement
+     * is deallocated on the server unless it's kept in connection cache
+     */
+    void release_dynamic()
+    {
+        std::vector<std::string> ids;
+        if (false == cache_key.empty())
+        {
+            conn.dyn_cache.release(cache_key, ids);
+            cache_key.clear();
+        }
+        if (false == dynid.empty())
+        {
+            ids.push_back(dynid);
+            dynid.clear();
+        }
+        deallocate(ids);
+    }
+
+    void deallocate(const std::vector<std::string>& ids)
+    {
+        if (ids.empty() || false == conn.alive())
+            return;
+        for (auto& id : ids)
+        {
+            if (CS_SUCCEED != ct_dynamic(cscommand, CS_DEALLOC, const_cast<CS_CHAR*>(id.c_str()), CS_NULLTERM, nullptr, CS_UNUSED))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to deallocate dynamic statement ").append(id));
+            execute();
+        }
+    }
+    
+    bool init_command()
+    {
+        if (CS_SUCCEED != ct_command(cscommand, CS_LANG_CMD, const_cast<CS_CHAR*>(command.c_str()), CS_NULLTERM, CS_UNUSED))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set command"));
+        return true;
+    }
+    
+    bool init_cursor(bool scrollable)
+    {
+        cursor = true;
+        rs.set_scrollable(scrollable);
+        std::string csid = genid("cursor");
+        if (CS_SUCCEED != ct_cursor(cscommand, CS_CURSOR_DECLARE, const_cast<CS_CHAR*>(csid.c_str()), CS_NULLTERM, const_cast<CS_CHAR*>(command.c_str()), CS_NULLTERM, (scrollable ? CS_SCROLL_CURSOR : CS_READ_ONLY)))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to declare cursor"));
+        if (CS_SUCCEED != ct_cursor(cscommand, CS_CURSOR_OPEN, nullptr, CS_UNUSED, nullptr, CS_UNUSED, CS_UNUSED))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to open cursor"));
+        return true;
+    }
+    
+    void close_cursor()
+    {
+        if (cursor)
+        {
+            ct_cursor(cscommand, CS_CURSOR_CLOSE, nullptr, CS_UNUSED, nullptr, CS_UNUSED, CS_DEALLOC);
+            cursor = false;
+            execute();
+        }
+    }
+    
+    void get_proc_params(std::string procname)
+    {
+        param_datafmt.clear();
+        param_data.clear();
+        if (nullptr == conn.mdcache || false == conn.mdcache->find_proc_params(conn.server, procname, param_datafmt))
+        {
+            query_proc_params(procname);
+            if (nullptr != conn.mdcache)
+                conn.mdcache->store_proc_params(conn.server, procname, param_datafmt);
+        }
+        param_data.resize(param_datafmt.size());
+        for (auto i = 0U; i < param_datafmt.size(); ++i)
+        {
+            param_data[i].allocate(param_datafmt[i].maxlength);
+            param_data[i].length = param_datafmt[i].maxlength;
+        }
+    }
+
+    void query_proc_params(std::string procname)
+    {
+        std::string sql;
+        if (conn.is_ase())
+        {
+            std::string procnum = "1";
+            std::string sysprefix = "dbo";
+            if (2 == std::count(procname.begin(), procname.end(), '.'))
+                sysprefix.insert(0, procname.substr(0, procname.find('.') + 1));
+            std::size_t pos = procname.find(';');
+            if (std::string::npos != pos)        
+            {
+                procnum = procname.substr(pos + 1);
+                procname.erase(pos);
+            }
+            sql = "select c.name, c.usertype, c.length, c.prec, c.scale, c.status2 from " +
+                  sysprefix + ".sysobjects o, " + sysprefix + ".syscolumns c where o.id = object_id('" +
+                  procname + "') and o.type = 'P' and o.id = c.id and c.number = " +
+                  procnum + " order by c.colid";
+        }
+        else
+        {
+            sql = "select m.parm_name, m.domain_id, m.width, m.width, m.scale, case m.parm_mode_out when 'Y' then 2 else 1 end from sysobjects o, sysprocedure p, sysprocparm m where o.id = object_id('" + 
+                  procname + "') and o.type = 'P' and o.name = p.proc_name and o.uid = p.creator and m.proc_id = p.proc_id and m.parm_type = 0 order by m.parm_id";
+        }
+        execute(sql);
+        while (rs.next())
+        {
+            param_datafmt.push_back(CS_DATAFMT());
+            CS_DATAFMT& datafmt = *param_datafmt.rbegin();
+            memset(&datafmt, 0, sizeof(datafmt));
             strcpy(datafmt.name, rs.get_string(0).c_str());
             datafmt.namelen = CS_NULLTERM;
             datafmt.datatype = ctlib_datatype(rs.get_int(1));
@@ -1666,10 +2536,6 @@ private:
                 datafmt.scale = rs.get_int(4);
             datafmt.status = (rs.get_int(5) == 1 ? CS_INPUTVALUE : CS_RETURN);
             datafmt.locale = NULL;
-            param_data.push_back(result_set::column_data());
-            result_set::column_data& coldata = *param_data.rbegin();
-            coldata.allocate(datafmt.maxlength);
-            coldata.length = datafmt.maxlength;
         }
     }
     
@@ -1678,6 +2544,7 @@ private:
     {
         if (param_idx >= param_data.size())
             throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        set_buffer(param_idx, nullptr);
         switch (param_datafmt[param_idx].datatype)
         {
             case CS_NUMERIC_TYPE:
@@ -1710,6 +2577,7 @@ private:
     {
         if (param_idx >= param_data.size())
             throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        set_buffer(param_idx, nullptr);
         std::memset(&srcfmt, 0, sizeof(srcfmt));
         srcfmt.datatype = CS_CHAR_TYPE;
         srcfmt.format = CS_FMT_UNUSED;
@@ -1825,6 +2693,10 @@ private:
     bool cursor = false;
     CS_INT cmdtype = CS_RPC_CMD;
     std::string command;
+    std::string dynid;
+    std::string execid;
+    std::string cache_key;
+    bool rebind = false;
     result_set rs;
     CS_DATAFMT srcfmt;
     struct tm stm;
@@ -1839,8 +2711,1005 @@ dbi::istatement* connection::get_statement(dbi::iconnection& iconn)
     return new statement(dynamic_cast<connection&>(iconn));
 }
 
+void connection::statement_cache(size_t capacity)
+{
+    std::vector<std::string> evicted;
+    dyn_cache.capacity(capacity, evicted);
+    if (false == evicted.empty())
+    {
+        statement stmt(*this);
+        stmt.deallocate(evicted);
+    }
+}
+
+
+
+//=====================================================================================
+
+
+/**
+ * bulk_writer - is a class that loads rows into a database table using bulk copy
+ * (blk_*) routines, which is much faster than inserting rows one by one. Rows are
+ * sent to the server as they are written and committed every batch_size() rows,
+ * the rest of the rows is committed by done() call. Rows which are not committed
+ * when bulk_writer goes out of scope are discarded. The connection has to be
+ * opened with CS_BULK_LOGIN property set, if the connection is not opened yet
+ * bulk_writer sets the property and opens it.
+ */
+class bulk_writer
+{
+public:
+    /**
+     * Constructor
+     * @param conn connection to use for the bulk copy
+     * @param table name of the table to load
+     */
+    bulk_writer(connection& conn, const std::string& table) : conn(conn), table(table)
+    {
+        try
+        {
+            init();
+        }
+        catch (...)
+        {
+            destroy(CS_BLK_CANCEL);
+            throw;
+        }
+    }
+
+    ~bulk_writer()
+    {
+        destroy(CS_BLK_CANCEL);
+    }
+
+    /**
+     * Function sets number of rows sent to the server between commits, zero
+     * (default) commits all rows at once in done() call
+     * @param rows
+     * @return
+     */
+    bulk_writer& batch_size(size_t rows)
+    {
+        batch_sz = rows;
+        return *this;
+    }
+
+    /**
+     * Function sends a row to the server, values are in order of table columns
+     * @param vals values of the row, nullptr is used for NULL values
+     * @return
+     */
+    template <typename... T>
+    bulk_writer& write(const T&... vals)
+    {
+        if (sizeof...(T) != columns.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid number of values"));
+        set_values(0, vals...);
+        send_row();
+        return *this;
+    }
+
+    /**
+     * Function sends a row stored in a tuple to the server
+     * @param row
+     * @return
+     */
+    template <typename... T>
+    bulk_writer& write(const std::tuple<T...>& row)
+    {
+        return write_tuple(row, std::index_sequence_for<T...>());
+    }
+
+    /**
+     * Function sends all rows (tuples) of a container to the server
+     * @param rows
+     * @return
+     */
+    template <typename Rows>
+    bulk_writer& write_rows(const Rows& rows)
+    {
+        for (auto& row : rows)
+            write(row);
+        return *this;
+    }
+
+    /**
+     * Function sends columnar batch of rows to the server, each vector holds
+     * values of one table column
+     * @param cols
+     * @return
+     */
+    template <typename... T>
+    bulk_writer& write_columns(const std::vector<T>&... cols)
+    {
+        if (sizeof...(T) != columns.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid number of columns"));
+        std::array<size_t, sizeof...(T)> sizes = {{ cols.size()... }};
+        if (std::any_of(sizes.begin(), sizes.end(), [&sizes](size_t s) { return s != sizes[0]; }))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Columns have different number of rows"));
+        for (size_t row = 0; row < sizes[0]; ++row)
+        {
+            set_values(0, cols[row]...);
+            send_row();
+        }
+        return *this;
+    }
+
+    /**
+     * Function commits rows sent since the last commit
+     * @return number of rows committed
+     */
+    size_t commit()
+    {
+        if (nullptr == blkdesc)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Bulk copy is already done"));
+        CS_INT outrow = 0;
+        if (CS_SUCCEED != blk_done(blkdesc, CS_BLK_BATCH, &outrow))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to commit batch of rows into ").append(table));
+        batch_rows = 0;
+        rows_committed += outrow;
+        return outrow;
+    }
+
+    /**
+     * Function commits the remaining rows and finishes the bulk copy
+     * @return total number of rows committed
+     */
+    size_t done()
+    {
+        if (nullptr == blkdesc)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Bulk copy is already done"));
+        CS_INT outrow = 0;
+        if (CS_SUCCEED != blk_done(blkdesc, CS_BLK_ALL, &outrow))
+        {
+            destroy(CS_BLK_CANCEL);
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to complete bulk copy into ").append(table));
+        }
+        rows_committed += outrow;
+        destroy(CS_UNUSED);
+        return rows_committed;
+    }
+
+    /**
+     * Function returns number of rows sent to the server
+     * @return
+     */
+    size_t rows_sent() const
+    {
+        return rows_cnt;
+    }
+
+    /**
+     * Function loads rows into a table using several bulk writers in parallel,
+     * each on its own connection and with its own share of the rows
+     * @param factory function that returns new (not yet connected) connection
+     * @param table name of the table to load
+     * @param rows random access container of rows (tuples)
+     * @param writers number of parallel writers
+     * @param batch number of rows between commits, zero to commit once per writer
+     * @return total number of rows committed
+     */
+    template <typename Rows>
+    static size_t parallel_write(std::function<dbi::connection()> factory, const std::string& table, const Rows& rows, size_t writers, size_t batch = 0)
+    {
+        writers = std::max<size_t>(1, std::min<size_t>(writers, rows.size()));
+        const size_t chunk = (rows.size() + writers - 1) / writers;
+        std::vector<size_t> committed(writers, 0);
+        std::vector<std::exception_ptr> errors(writers);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < writers; ++i)
+        {
+            threads.emplace_back([&, i]()
+            {
+                try
+                {
+                    dbi::connection dbconn = factory();
+                    bulk_writer writer(static_cast<connection&>(dbconn), table);
+                    writer.batch_size(batch);
+                    for (size_t row = i * chunk; row < std::min(rows.size(), (i + 1) * chunk); ++row)
+                        writer.write(rows[row]);
+                    committed[i] = writer.done();
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        for (auto& e : errors)
+        {
+            if (e)
+                std::rethrow_exception(e);
+        }
+        return std::accumulate(committed.begin(), committed.end(), size_t(0));
+    }
+
+private:
+    friend class bulk_reader;
+
+    bulk_writer(const bulk_writer&) = delete;
+    bulk_writer& operator=(const bulk_writer&) = delete;
+
+    void init()
+    {
+        CS_BOOL bulk_login = CS_FALSE;
+        if (false == conn.connected())
+        {
+            if (CS_SUCCEED != ct_con_props(conn.csconnection, CS_SET, CS_BULK_LOGIN, &TRUE, CS_UNUSED, nullptr) || false == conn.connect())
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to open bulk copy connection"));
+        }
+        else if (CS_SUCCEED != ct_con_props(conn.csconnection, CS_GET, CS_BULK_LOGIN, &bulk_login, CS_UNUSED, nullptr) || CS_TRUE != bulk_login)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Connection is not opened with CS_BULK_LOGIN property"));
+        columns.resize(column_count());
+        coldata.resize(columns.size());
+        if (CS_SUCCEED != blk_alloc(conn.csconnection, blk_version(), &blkdesc))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to allocate bulk copy descriptor"));
+        if (CS_SUCCEED != blk_init(blkdesc, CS_BLK_IN, const_cast<CS_CHAR*>(table.c_str()), CS_NULLTERM))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to initialize bulk copy into ").append(table));
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            std::memset(&columns[i], 0, sizeof(CS_DATAFMT));
+            if (CS_SUCCEED != blk_describe(blkdesc, i + 1, &columns[i]))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to describe column ").append(std::to_string(i)));
+            columns[i].count = 1;
+            coldata[i].allocate(columns[i].maxlength);
+            if (CS_SUCCEED != blk_bind(blkdesc, i + 1, &columns[i], coldata[i], &(coldata[i].length), &(coldata[i].indicator)))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to bind column ").append(std::to_string(i)));
+        }
+    }
+
+    void destroy(CS_INT type)
+    {
+        if (nullptr != blkdesc)
+        {
+            CS_INT outrow = 0;
+            if (CS_UNUSED != type)
+                blk_done(blkdesc, type, &outrow);
+            blk_drop(blkdesc);
+            blkdesc = nullptr;
+        }
+    }
+
+    size_t column_count()
+    {
+        std::unique_ptr<dbi::istatement> stmt(conn.get_statement(conn));
+        return stmt->execute(std::string("select * from ").append(table).append(" where 1 = 0"))->column_count();
+    }
+
+    static CS_INT blk_version()
+    {
+#ifdef BLK_VERSION_150
+        return BLK_VERSION_150;
+#else
+        return BLK_VERSION_100;
+#endif
+    }
+
+    void send_row()
+    {
+        if (nullptr == blkdesc)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Bulk copy is already done"));
+        if (CS_SUCCEED != blk_rowxfer(blkdesc))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to send row ").append(std::to_string(rows_cnt + 1)).append(" into ").append(table));
+        ++rows_cnt;
+        if (batch_sz > 0 && ++batch_rows >= batch_sz)
+            commit();
+    }
+
+    template <typename... T, size_t... I>
+    bulk_writer& write_tuple(const std::tuple<T...>& row, std::index_sequence<I...>)
+    {
+        return write(std::get<I>(row)...);
+    }
+
+    void set_values(size_t col_idx)
+    {
+    }
+
+    template <typename T, typename... Args>
+    void set_values(size_t col_idx, const T& val, const Args&... args)
+    {
+        set(col_idx, val);
+        set_values(col_idx + 1, args...);
+    }
+
+    void set(size_t col_idx, std::nullptr_t)
+    {
+        coldata[col_idx].length = 0;
+        coldata[col_idx].indicator = -1;
+    }
+
+    void set(size_t col_idx, bool val)
+    {
+        CS_BIT t = val;
+        convert(col_idx, CS_BIT_TYPE, &t, sizeof(t));
+    }
+
+    void set(size_t col_idx, char val)
+    {
+        convert(col_idx, CS_CHAR_TYPE, &val, sizeof(val));
+    }
+
+    void set(size_t col_idx, const char* val)
+    {
+        convert(col_idx, CS_CHAR_TYPE, val, std::strlen(val));
+    }
+
+    void set(size_t col_idx, const std::string& val)
+    {
+        convert(col_idx, CS_CHAR_TYPE, val.data(), val.length());
+    }
+
+    void set(size_t col_idx, const std::vector<uint8_t>& val)
+    {
+        convert(col_idx, CS_BINARY_TYPE, val.data(), val.size());
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type set(size_t col_idx, T val)
+    {
+        CS_FLOAT t = val;
+        convert(col_idx, CS_FLOAT_TYPE, &t, sizeof(t));
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && (sizeof(T) < sizeof(CS_INT) || (sizeof(T) == sizeof(CS_INT) && std::is_signed<T>::value))>::type set(size_t col_idx, T val)
+    {
+        CS_INT t = val;
+        convert(col_idx, CS_INT_TYPE, &t, sizeof(t));
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && (sizeof(T) > sizeof(CS_INT) || (sizeof(T) == sizeof(CS_INT) && std::is_unsigned<T>::value))>::type set(size_t col_idx, T val)
+    {
+#ifdef CS_BIGINT_TYPE
+        CS_BIGINT t = val;
+        convert(col_idx, CS_BIGINT_TYPE, &t, sizeof(t));
+#else
+        CS_FLOAT t = val;
+        convert(col_idx, CS_FLOAT_TYPE, &t, sizeof(t));
+#endif
+    }
+
+    void convert(size_t col_idx, CS_INT datatype, const void* val, size_t len)
+    {
+        auto& data = coldata[col_idx];
+        if (datatype == columns[col_idx].datatype)
+        {
+            if (len > data.data.size())
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Value is too large for column ").append(std::to_string(col_idx)));
+            std::memcpy(data, val, len);
+            data.length = len;
+        }
+        else
+        {
+            CS_DATAFMT srcfmt;
+            std::memset(&srcfmt, 0, sizeof(srcfmt));
+            srcfmt.datatype = datatype;
+            srcfmt.format = CS_FMT_UNUSED;
+            srcfmt.locale = nullptr;
+            srcfmt.maxlength = len;
+            if (CS_SUCCEED != cs_convert(conn.cscontext, &srcfmt, const_cast<CS_VOID*>(val), &columns[col_idx], data, &data.length))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": cs_convert failed for column ").append(std::to_string(col_idx)));
+        }
+        data.indicator = 0;
+    }
+
+private:
+    connection& conn;
+    std::string table;
+    CS_BLKDESC* blkdesc = nullptr;
+    size_t batch_sz = 0;
+    size_t batch_rows = 0;
+    size_t rows_cnt = 0;
+    size_t rows_committed = 0;
+    std::vector<CS_DATAFMT> columns;
+    std::vector<result_set::column_data> coldata;
+}; // bulk_writer
+
+
+
+//=====================================================================================
 
 
+/**
+ * bulk_reader - is a class that extracts all rows of a database table using bulk
+ * copy out (blk_*) routines directly into caller provided column buffers, which
+ * avoids per row and per value overhead of result_set. Each fetch() call
+ * transfers up to rows_per_fetch() rows, columns which are not bound by the
+ * caller are read into internal buffers. The connection has to be opened with
+ * CS_BULK_LOGIN property set, if the connection is not opened yet bulk_reader
+ * sets the property and opens it.
+ */
+class bulk_reader
+{
+public:
+    /**
+     * Constructor
+     * @param conn connection to use for the bulk copy
+     * @param table name of the table to extract
+     */
+    bulk_reader(connection& conn, const std::string& table) : conn(conn), table(table)
+    {
+        try
+        {
+            init();
+        }
+        catch (...)
+        {
+            destroy(CS_BLK_CANCEL);
+            throw;
+        }
+    }
+
+    ~bulk_reader()
+    {
+        destroy(CS_BLK_CANCEL);
+    }
+
+    /**
+     * Function sets number of rows transferred by each fetch() call, column
+     * buffers have to hold that many values. Default is 1.
+     * @param rows
+     * @return
+     */
+    bulk_reader& rows_per_fetch(size_t rows)
+    {
+        if (bound)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Columns are already bound"));
+        fetch_rows = std::max<size_t>(1, rows);
+        return *this;
+    }
+
+    size_t column_count() const
+    {
+        return columns.size();
+    }
+
+    std::string column_name(size_t col_idx) const
+    {
+        if (col_idx >= columns.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        return std::string(columns[col_idx].name, columns[col_idx].namelen > 0 ? columns[col_idx].namelen : ::strlen(columns[col_idx].name));
+    }
+
+    /**
+     * Function returns maximum length of a column value in bytes
+     * @param col_idx
+     * @return
+     */
+    size_t column_length(size_t col_idx) const
+    {
+        if (col_idx >= columns.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        return columns[col_idx].maxlength;
+    }
+
+    /**
+     * Function binds numeric column buffer
+     * @param col_idx
+     * @param values array of rows_per_fetch() values, T is one of CS_TINYINT,
+     *        CS_SMALLINT, CS_INT, CS_BIGINT, CS_REAL or CS_FLOAT
+     * @param indicators optional array of rows_per_fetch() indicators, CS_NULLDATA
+     *        marks NULL values
+     * @return
+     */
+    template <typename T>
+    bulk_reader& bind(size_t col_idx, T* values, CS_SMALLINT* indicators = nullptr)
+    {
+        return bind(col_idx, datatype(values), values, sizeof(T), nullptr, indicators);
+    }
+
+    /**
+     * Function binds character or binary column buffer
+     * @param col_idx
+     * @param values buffer of rows_per_fetch() * width bytes
+     * @param width size of each value in the buffer
+     * @param lengths array of rows_per_fetch() actual value lengths
+     * @param indicators optional array of rows_per_fetch() indicators, CS_NULLDATA
+     *        marks NULL values
+     * @param binary true to transfer values as binary data
+     * @return
+     */
+    bulk_reader& bind(size_t col_idx, char* values, size_t width, CS_INT* lengths, CS_SMALLINT* indicators = nullptr, bool binary = false)
+    {
+        return bind(col_idx, (binary ? CS_BINARY_TYPE : CS_CHAR_TYPE), values, width, lengths, indicators);
+    }
+
+    /**
+     * Function transfers next block of rows into column buffers
+     * @return number of rows transferred, zero when all rows are transferred
+     */
+    size_t fetch()
+    {
+        if (nullptr == blkdesc)
+            return 0;
+        if (false == bound)
+            bind_columns();
+        CS_INT rows = 0;
+        switch (blk_rowxfer_mult(blkdesc, &rows))
+        {
+            case CS_SUCCEED:
+                break;
+            case CS_END_DATA:
+            {
+                CS_INT outrow = 0;
+                blk_done(blkdesc, CS_BLK_ALL, &outrow);
+                destroy(CS_UNUSED);
+                break;
+            }
+            default:
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to transfer rows from ").append(table));
+        }
+        rows_cnt += rows;
+        return rows;
+    }
+
+    /**
+     * Function returns number of rows transferred so far
+     * @return
+     */
+    size_t row_count() const
+    {
+        return rows_cnt;
+    }
+
+    /**
+     * Function extracts rows of a table split by key ranges in parallel by up
+     * to the given number of readers, each reader on its own connection takes
+     * ranges one by one. Bulk copy out cannot filter rows thus ranges are
+     * selected by regular queries with multi-row fetch. The consumer is called
+     * from the reader threads with the range index and the result set of the
+     * range positioned before the first row.
+     * @param factory function that returns new (not yet connected) connection
+     * @param table name of the table
+     * @param key key column name
+     * @param bounds sorted range boundaries as SQL literals, N boundaries make
+     *        N + 1 ranges: key < b[0], b[0] <= key < b[1], ..., key >= b[N - 1]
+     * @param consumer function that reads rows of a range
+     * @param readers number of parallel readers
+     * @param fetch_rows number of rows fetched at once, zero to calculate it
+     *        from the row width
+     * @return total number of rows read by the consumers
+     */
+    static size_t parallel_read(std::function<dbi::connection()> factory, const std::string& table, const std::string& key,
+                                const std::vector<std::string>& bounds, std::function<void(size_t, dbi::iresult_set&)> consumer,
+                                size_t readers, size_t fetch_rows = 0)
+    {
+        const size_t parts = bounds.size() + 1;
+        readers = std::max<size_t>(1, std::min<size_t>(readers, parts));
+        std::vector<size_t> rows(readers, 0);
+        std::vector<std::exception_ptr> errors(readers);
+        std::atomic<size_t> next_part(0);
+        std::vector<std::thread> threads;
+        for (size_t r = 0; r < readers; ++r)
+        {
+            threads.emplace_back([&, r]()
+            {
+                try
+                {
+                    dbi::connection dbconn = factory();
+                    if (false == dbconn.connect())
+                        throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to connect to database"));
+                    connection& conn = static_cast<connection&>(dbconn);
+                    conn.fetch_rows(fetch_rows);
+                    std::unique_ptr<dbi::istatement> stmt(conn.get_statement(conn));
+                    for (size_t i = next_part++; i < parts; i = next_part++)
+                    {
+                        std::string sql = std::string("select * from ").append(table);
+                        if (i > 0)
+                            sql.append(" where ").append(key).append(" >= ").append(bounds[i - 1]);
+                        if (i < bounds.size())
+                            sql.append(i > 0 ? " and " : " where ").append(key).append(" < ").append(bounds[i]);
+                        // row_count() is reset at the end of data, count rows fetched by the consumer instead
+                        result_set& rs = static_cast<result_set&>(*stmt->execute(sql));
+                        consumer(i, rs);
+                        rows[r] += rs.fetched_rows;
+                    }
+                }
+                catch (...)
+                {
+                    errors[r] = std::current_exception();
+                    next_part = parts;
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        for (auto& e : errors)
+        {
+            if (e)
+                std::rethrow_exception(e);
+        }
+        return std::accumulate(rows.begin(), rows.end(), size_t(0));
+    }
+
+private:
+    bulk_reader(const bulk_reader&) = delete;
+    bulk_reader& operator=(const bulk_reader&) = delete;
+
+    struct column_buffer
+    {
+        CS_DATAFMT datafmt;
+        CS_VOID* values = nullptr;
+        CS_INT* lengths = nullptr;
+        CS_SMALLINT* indicators = nullptr;
+        result_set::column_data data;
+    };
+
+    void init()
+    {
+        CS_BOOL bulk_login = CS_FALSE;
+        if (false == conn.connected())
+        {
+            if (CS_SUCCEED != ct_con_props(conn.csconnection, CS_SET, CS_BULK_LOGIN, &TRUE, CS_UNUSED, nullptr) || false == conn.connect())
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to open bulk copy connection"));
+        }
+        else if (CS_SUCCEED != ct_con_props(conn.csconnection, CS_GET, CS_BULK_LOGIN, &bulk_login, CS_UNUSED, nullptr) || CS_TRUE != bulk_login)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Connection is not opened with CS_BULK_LOGIN property"));
+        std::unique_ptr<dbi::istatement> stmt(conn.get_statement(conn));
+        columns.resize(stmt->execute(std::string("select * from ").append(table).append(" where 1 = 0"))->column_count());
+        buffers.resize(columns.size());
+        stmt.reset();
+        if (CS_SUCCEED != blk_alloc(conn.csconnection, bulk_writer::blk_version(), &blkdesc))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to allocate bulk copy descriptor"));
+        if (CS_SUCCEED != blk_init(blkdesc, CS_BLK_OUT, const_cast<CS_CHAR*>(table.c_str()), CS_NULLTERM))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to initialize bulk copy from ").append(table));
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            std::memset(&columns[i], 0, sizeof(CS_DATAFMT));
+            if (CS_SUCCEED != blk_describe(blkdesc, i + 1, &columns[i]))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to describe column ").append(std::to_string(i)));
+        }
+    }
+
+    void destroy(CS_INT type)
+    {
+        if (nullptr != blkdesc)
+        {
+            CS_INT outrow = 0;
+            if (CS_UNUSED != type)
+                blk_done(blkdesc, type, &outrow);
+            blk_drop(blkdesc);
+            blkdesc = nullptr;
+        }
+    }
+
+    bulk_reader& bind(size_t col_idx, CS_INT type, CS_VOID* values, size_t width, CS_INT* lengths, CS_SMALLINT* indicators)
+    {
+        if (col_idx >= columns.size())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Invalid index"));
+        if (bound)
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Columns are already bound"));
+        auto& buf = buffers[col_idx];
+        std::memset(&buf.datafmt, 0, sizeof(CS_DATAFMT));
+        buf.datafmt.datatype = type;
+        buf.datafmt.format = CS_FMT_UNUSED;
+        buf.datafmt.maxlength = width;
+        buf.values = values;
+        buf.lengths = lengths;
+        buf.indicators = indicators;
+        return *this;
+    }
+
+    void bind_columns()
+    {
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            auto& buf = buffers[i];
+            if (nullptr == buf.values)
+            {
+                buf.datafmt = columns[i];
+                buf.data.allocate(columns[i].maxlength, fetch_rows);
+                buf.values = buf.data;
+                buf.lengths = buf.data.lengths.data();
+                buf.indicators = buf.data.indicators.data();
+            }
+            buf.datafmt.count = fetch_rows;
+            if (CS_SUCCEED != blk_bind(blkdesc, i + 1, &buf.datafmt, buf.values, buf.lengths, buf.indicators))
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to bind column ").append(std::to_string(i)));
+        }
+        bound = true;
+    }
+
+    static CS_INT datatype(const CS_TINYINT*) { return CS_TINYINT_TYPE; }
+    static CS_INT datatype(const CS_SMALLINT*) { return CS_SMALLINT_TYPE; }
+    static CS_INT datatype(const CS_INT*) { return CS_INT_TYPE; }
+#ifdef CS_BIGINT_TYPE
+    static CS_INT datatype(const CS_BIGINT*) { return CS_BIGINT_TYPE; }
+#endif
+    static CS_INT datatype(const CS_REAL*) { return CS_REAL_TYPE; }
+    static CS_INT datatype(const CS_FLOAT*) { return CS_FLOAT_TYPE; }
+
+private:
+    connection& conn;
+    std::string table;
+    CS_BLKDESC* blkdesc = nullptr;
+    bool bound = false;
+    size_t fetch_rows = 1;
+    size_t rows_cnt = 0;
+    std::vector<CS_DATAFMT> columns;
+    std::vector<column_buffer> buffers;
+}; // bulk_reader
+
+
+
+
+//=====================================================================================
+
+
+/**
+ * poller - is an event loop driving asynchronous execution of SQL statements
+ * on many connections from a single thread. While a statement is executed the
+ * connection is switched to deferred network I/O (CS_NETIO = CS_DEFER_IO), so
+ * ct_send(), ct_results() and ct_fetch() return CS_PENDING instead of waiting
+ * for the server and their completions are collected by poll() with ct_poll().
+ * Rows are fetched into column batches and the callback is called from poll()
+ * with the whole result. Only one statement can be in flight per connection,
+ * the connection must not be used otherwise until the callback is called.
+ * poll() can be run in a loop or called when the connection socket returned
+ * by socket() becomes readable (eg from epoll), eg:
+ *
+ *     sybase::poller poller(driver<sybase::driver>::load());
+ *     poller.execute(conn1, "select * from test1", [](std::exception_ptr ex, dbi::materialized_result&& res) { ... });
+ *     poller.execute(conn2, "select * from test2", [](std::exception_ptr ex, dbi::materialized_result&& res) { ... });
+ *     poller.run();
+ */
+class poller
+{
+public:
+    using callback = std::function<void(std::exception_ptr, dbi::materialized_result&&)>;
+
+    explicit poller(driver& drv) : cscontext(drv.cscontext)
+    {
+    }
+
+    ~poller()
+    {
+        // a command can't be dropped while it has network I/O or results pending
+        for (auto& op : ops)
+        {
+            cancel(*op.second);
+            release(*op.second);
+        }
+    }
+
+    /**
+     * Function starts execution of SQL statement on the connection
+     * @param conn opened connection which has no statement in flight
+     * @param sql statement to be executed
+     * @param cb callback function called from poll() on completion
+     */
+    void execute(connection& conn, const std::string& sql, callback cb)
+    {
+        if (sql.empty())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": SQL command is not set"));
+        if (false == conn.connected())
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Database connection is not opened"));
+        for (auto& op : ops)
+        {
+            if (op.second->conn == &conn)
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Connection has statement in flight"));
+        }
+        std::unique_ptr<operation> op(new operation(conn, std::move(cb)));
+        if (CS_SUCCEED != ct_cmd_alloc(conn.csconnection, &op->cscommand))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to allocate command struct"));
+        op->rs.cscontext = cscontext;
+        op->rs.cscommand = op->cscommand;
+        op->rs.fetch_rows = (conn.fetch_rows_cnt > 1 ? conn.fetch_rows_cnt : 0);
+        if (CS_SUCCEED != ct_command(op->cscommand, CS_LANG_CMD, const_cast<CS_CHAR*>(sql.c_str()), CS_NULLTERM, CS_UNUSED))
+        {
+            release(*op);
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set command"));
+        }
+        if (false == netio(conn, CS_DEFER_IO))
+        {
+            release(*op);
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to set deferred network I/O"));
+        }
+        auto cmd = op->cscommand;
+        auto& opref = *op;
+        ops.emplace(cmd, std::move(op));
+        auto ret = ct_send(cmd);
+        if (CS_PENDING != ret)
+            complete(opref, CT_SEND, ret);
+    }
+
+    /**
+     * Function collects completed network operations and advances statements,
+     * callbacks of finished statements are called from this function
+     * @param timeout time to wait for the first completion, zero to only check
+     * @return number of finished statements
+     */
+    size_t poll(std::chrono::milliseconds timeout = std::chrono::milliseconds(0))
+    {
+        size_t finished = 0;
+        auto wait = static_cast<CS_INT>(timeout.count());
+        while (false == ops.empty())
+        {
+            Connection* compconn = nullptr;
+            CS_COMMAND* compcmd = nullptr;
+            CS_INT compid = 0;
+            CS_RETCODE compstatus = CS_FAIL;
+            auto ret = ct_poll(cscontext, nullptr, wait, &compconn, &compcmd, &compid, &compstatus);
+            if (CS_TIMED_OUT == ret || CS_QUIET == ret || CS_INTERRUPT == ret)
+                break;
+            if (CS_SUCCEED != ret)
+                throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to poll connections"));
+            wait = 0;
+            auto it = ops.find(compcmd);
+            if (it != ops.end() && complete(*it->second, compid, compstatus))
+                finished += 1;
+        }
+        return finished;
+    }
+
+    /**
+     * Function polls until all statements have finished
+     */
+    void run()
+    {
+        while (false == ops.empty())
+            poll(std::chrono::milliseconds(100));
+    }
+
+    /**
+     * Function returns number of statements in flight
+     * @return
+     */
+    size_t pending() const
+    {
+        return ops.size();
+    }
+
+    /**
+     * Function returns socket of the connection which can be watched for
+     * readability by an external event loop (eg epoll) to call poll()
+     * @param conn
+     * @return socket file descriptor
+     */
+    static int socket(connection& conn)
+    {
+        CS_INT fd = -1;
+        if (nullptr == conn.csconnection || CS_SUCCEED != ct_con_props(conn.csconnection, CS_GET, CS_ENDPOINT, &fd, CS_UNUSED, nullptr))
+            throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to get connection socket"));
+        return fd;
+    }
+
+private:
+    struct operation
+    {
+        operation(connection& conn, callback&& cb) : conn(&conn), cb(std::move(cb)) { }
+
+        connection* conn;
+        callback cb;
+        CS_COMMAND* cscommand = nullptr;
+        CS_INT restype = 0;
+        CS_INT rows_read = 0;
+        result_set rs;
+        dbi::materialized_result res;
+    };
+
+    poller(const poller&) = delete;
+    poller& operator=(const poller&) = delete;
+
+    static bool netio(connection& conn, CS_INT mode)
+    {
+        return (CS_SUCCEED == ct_con_props(conn.csconnection, CS_SET, CS_NETIO, &mode, CS_UNUSED, nullptr));
+    }
+
+    /**
+     * Function advances the statement after completion of its network
+     * operation, the following operations are started until one of them is
+     * pending or the statement has finished
+     * @return true if the statement has finished
+     */
+    bool complete(operation& op, CS_INT compid, CS_RETCODE status)
+    {
+        std::exception_ptr ex;
+        try
+        {
+            if (false == advance(op, compid, status))
+                return false;
+        }
+        catch (...)
+        {
+            cancel(op);
+            ex = std::current_exception();
+        }
+        finish(op, ex);
+        return true;
+    }
+
+    bool advance(operation& op, CS_INT compid, CS_RETCODE status)
+    {
+        while (true)
+        {
+            switch (compid)
+            {
+                case CT_SEND:
+                    if (CS_SUCCEED != status)
+                        throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to send command"));
+                    compid = CT_RESULTS;
+                    status = ct_results(op.cscommand, &op.restype);
+                    break;
+                case CT_RESULTS:
+                    if (CS_END_RESULTS == status || CS_CANCELED == status)
+                        return true;
+                    if (CS_SUCCEED != status)
+                        throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to get results"));
+                    if (CS_CMD_FAIL == op.restype)
+                        throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to execute command"));
+                    op.rs.clear();
+                    if (op.rs.process_ct_result(op.restype))
+                    {
+                        op.res.result_sets.emplace_back();
+                        compid = CT_FETCH;
+                        status = ct_fetch(op.cscommand, CS_UNUSED, CS_UNUSED, CS_UNUSED, &op.rows_read);
+                    }
+                    else
+                    {
+                        op.res.rows_affected += op.rs.affected_rows;
+                        status = ct_results(op.cscommand, &op.restype);
+                    }
+                    break;
+                case CT_FETCH:
+                    if (CS_SUCCEED == status)
+                    {
+                        for (op.rs.batch_row = 0; op.rs.batch_row < static_cast<size_t>(op.rows_read); ++op.rs.batch_row)
+                            op.rs.append_row(op.res.result_sets.back());
+                        status = ct_fetch(op.cscommand, CS_UNUSED, CS_UNUSED, CS_UNUSED, &op.rows_read);
+                    }
+                    else if (CS_END_DATA == status)
+                    {
+                        compid = CT_RESULTS;
+                        status = ct_results(op.cscommand, &op.restype);
+                    }
+                    else
+                        throw std::runtime_error(std::string(__FUNCTION__).append(": Failed to fetch rows"));
+                    break;
+                default:
+                    // completion of an operation not started by poller (eg ct_cancel)
+                    return false;
+            }
+            if (CS_PENDING == status)
+                return false;
+        }
+    }
+
+    void finish(operation& op, std::exception_ptr ex)
+    {
+        auto cmd = op.cscommand;
+        auto cb = std::move(op.cb);
+        auto res = std::move(op.res);
+        release(op);
+        ops.erase(cmd);
+        if (cb)
+            cb(ex, std::move(res));
+    }
+
+    void cancel(operation& op)
+    {
+        netio(*op.conn, CS_SYNC_IO);
+        ct_cancel(nullptr, op.cscommand, CS_CANCEL_ALL);
+    }
+
+    void release(operation& op)
+    {
+        if (nullptr != op.cscommand)
+        {
+            netio(*op.conn, CS_SYNC_IO);
+            ct_cmd_drop(op.cscommand);
+            op.cscommand = nullptr;
+        }
+    }
+
+private:
+    Context* cscontext = nullptr;
+    std::map<CS_COMMAND*, std::unique_ptr<operation>> ops;
+}; // poller
 
 
 
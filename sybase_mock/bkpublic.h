@@ -0,0 +1,193 @@
+/*
+ * File:   bkpublic.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * In-memory replacement of Sybase Bulk-Library used by the driver regression
+ * tests, see ctpublic.h. Rows are copied in and out of the tables of the
+ * scripted server (ctmock::server().tables), rows copied in are added to the
+ * table when the batch is committed by blk_done().
+ */
+
+#ifndef BKPUBLIC_H
+#define BKPUBLIC_H
+
+#include "ctpublic.h"
+
+#define BLK_VERSION_100 100
+#define BLK_VERSION_150 150
+#define BLK_VERSION_155 155
+#define BLK_VERSION_160 160
+
+#define CS_BLK_IN 1
+#define CS_BLK_OUT 2
+#define CS_BLK_BATCH 1
+#define CS_BLK_ALL 2
+#define CS_BLK_CANCEL 3
+
+struct CS_BLKDESC
+{
+    CS_CONNECTION* conn = nullptr;
+    CS_INT direction = 0;
+    std::string table;
+    std::vector<ctmock::column> columns;
+    std::vector<ctmock::binding> bindings;
+    // rows copied in and not committed yet
+    std::vector<std::vector<ctmock::value>> rows;
+    // number of rows copied out
+    size_t next = 0;
+};
+
+inline CS_RETCODE blk_alloc(CS_CONNECTION* connection, CS_INT version, CS_BLKDESC** blkdesc)
+{
+    if (nullptr == connection || CS_CONSTAT_CONNECTED != connection->status)
+        return CS_FAIL;
+    *blkdesc = new CS_BLKDESC();
+    (*blkdesc)->conn = connection;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE blk_init(CS_BLKDESC* blkdesc, CS_INT direction, CS_CHAR* tblname, CS_INT tblnamelen)
+{
+    if (nullptr == blkdesc || CS_TRUE != blkdesc->conn->bulk_login || (CS_BLK_IN != direction && CS_BLK_OUT != direction))
+        return CS_FAIL;
+    auto& srv = ctmock::server();
+    std::lock_guard<std::mutex> guard(srv.lock);
+    auto name = ctmock::detail::text(tblname, tblnamelen);
+    auto tbl = srv.tables.find(name);
+    if (tbl == srv.tables.end())
+        return CS_FAIL;
+    blkdesc->direction = direction;
+    blkdesc->table = name;
+    blkdesc->columns = tbl->second.columns;
+    blkdesc->bindings.assign(blkdesc->columns.size(), ctmock::binding());
+    blkdesc->rows.clear();
+    blkdesc->next = 0;
+    srv.log.push_back("BLK INIT " + name);
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE blk_describe(CS_BLKDESC* blkdesc, CS_INT colnum, CS_DATAFMT* datafmt)
+{
+    if (nullptr == blkdesc || colnum < 1 || static_cast<size_t>(colnum) > blkdesc->columns.size())
+        return CS_FAIL;
+    auto& col = blkdesc->columns[colnum - 1];
+    std::memset(datafmt, 0, sizeof(CS_DATAFMT));
+    std::snprintf(datafmt->name, CS_MAX_NAME, "%s", col.name.c_str());
+    datafmt->namelen = std::strlen(datafmt->name);
+    datafmt->datatype = col.datatype;
+    datafmt->format = CS_FMT_UNUSED;
+    datafmt->maxlength = col.maxlength;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE blk_bind(CS_BLKDESC* blkdesc, CS_INT colnum, CS_DATAFMT* datafmt, CS_VOID* buffer, CS_INT* datalen, CS_SMALLINT* indicator)
+{
+    if (nullptr == blkdesc || colnum < 1 || static_cast<size_t>(colnum) > blkdesc->bindings.size())
+        return CS_FAIL;
+    auto& b = blkdesc->bindings[colnum - 1];
+    b.datatype = datafmt->datatype;
+    b.maxlength = datafmt->maxlength;
+    b.count = std::max(1, datafmt->count);
+    b.buffer = buffer;
+    b.length = datalen;
+    b.indicator = indicator;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE blk_rowxfer(CS_BLKDESC* blkdesc)
+{
+    if (nullptr == blkdesc || CS_BLK_IN != blkdesc->direction)
+        return CS_FAIL;
+    std::vector<ctmock::value> row(blkdesc->columns.size());
+    for (size_t i = 0; i < row.size(); ++i)
+    {
+        auto& b = blkdesc->bindings[i];
+        if (nullptr == b.buffer || false == ctmock::detail::copy_in(b.buffer, b.datatype, b.length, b.indicator, blkdesc->columns[i], row[i]))
+            return CS_FAIL;
+    }
+    blkdesc->rows.push_back(std::move(row));
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE blk_rowxfer_mult(CS_BLKDESC* blkdesc, CS_INT* rowcount)
+{
+    if (nullptr == blkdesc || CS_BLK_OUT != blkdesc->direction || blkdesc->bindings.empty())
+        return CS_FAIL;
+    auto& srv = ctmock::server();
+    std::lock_guard<std::mutex> guard(srv.lock);
+    auto& rows = srv.tables[blkdesc->table].rows;
+    size_t cnt = std::min<size_t>(blkdesc->bindings[0].count, rows.size() - std::min(rows.size(), blkdesc->next));
+    if (nullptr != rowcount)
+        *rowcount = cnt;
+    if (0 == cnt)
+        return CS_END_DATA;
+    for (size_t r = 0; r < cnt; ++r)
+    {
+        for (size_t c = 0; c < blkdesc->bindings.size(); ++c)
+        {
+            if (false == ctmock::detail::copy_out(rows[blkdesc->next + r][c], blkdesc->columns[c], blkdesc->bindings[c], r))
+                return CS_FAIL;
+        }
+    }
+    blkdesc->next += cnt;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE blk_done(CS_BLKDESC* blkdesc, CS_INT type, CS_INT* outrow)
+{
+    if (nullptr == blkdesc || 0 == blkdesc->direction)
+        return CS_FAIL;
+    auto& srv = ctmock::server();
+    std::lock_guard<std::mutex> guard(srv.lock);
+    CS_INT cnt = (CS_BLK_OUT == blkdesc->direction ? blkdesc->next : blkdesc->rows.size());
+    switch (type)
+    {
+        case CS_BLK_BATCH:
+        case CS_BLK_ALL:
+            if (CS_BLK_IN == blkdesc->direction)
+            {
+                auto& rows = srv.tables[blkdesc->table].rows;
+                rows.insert(rows.end(), blkdesc->rows.begin(), blkdesc->rows.end());
+                blkdesc->rows.clear();
+            }
+            srv.log.push_back((CS_BLK_BATCH == type ? "BLK BATCH " : "BLK ALL ") + std::to_string(cnt));
+            break;
+        case CS_BLK_CANCEL:
+            srv.log.push_back("BLK CANCEL " + std::to_string(cnt));
+            blkdesc->rows.clear();
+            cnt = 0;
+            break;
+        default:
+            return CS_FAIL;
+    }
+    if (CS_BLK_BATCH != type)
+        blkdesc->direction = 0;
+    if (nullptr != outrow)
+        *outrow = cnt;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE blk_drop(CS_BLKDESC* blkdesc)
+{
+    if (nullptr == blkdesc)
+        return CS_FAIL;
+    delete blkdesc;
+    return CS_SUCCEED;
+}
+
+#endif // BKPUBLIC_H
@@ -0,0 +1,1485 @@
+/*
+ * File:   ctpublic.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * In-memory replacement of Sybase Client-Library used by the driver regression
+ * tests (sybase_test.cpp), it shadows the real ctpublic.h when its directory is
+ * put first on the include path. Only the part of the library used by
+ * sybase_driver.hpp is implemented: commands are answered by a scripted server
+ * (ctmock::server()) which keeps connection transaction level and dynamic
+ * statements, records the commands it receives, and completes deferred network
+ * I/O (CS_NETIO = CS_DEFER_IO) through ct_poll().
+ */
+
+#ifndef CTPUBLIC_H
+#define CTPUBLIC_H
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+typedef int CS_INT;
+typedef int CS_RETCODE;
+typedef int CS_BOOL;
+typedef short CS_SMALLINT;
+typedef char CS_CHAR;
+typedef void CS_VOID;
+typedef unsigned char CS_TINYINT;
+typedef unsigned char CS_BIT;
+typedef unsigned char CS_BYTE;
+typedef unsigned short CS_USHORT;
+typedef unsigned short CS_USMALLINT;
+typedef unsigned short CS_UNICHAR;
+typedef unsigned int CS_UINT;
+typedef long CS_LONG;
+typedef long long CS_BIGINT;
+typedef unsigned long long CS_UBIGINT;
+typedef float CS_REAL;
+typedef double CS_FLOAT;
+
+#define CS_MAX_NAME 132
+#define CS_MAX_CHAR 256
+#define CS_MAX_MSG 1024
+
+// return codes
+#define CS_SUCCEED 1
+#define CS_FAIL 0
+#define CS_MEM_ERROR (-1)
+#define CS_PENDING (-2)
+#define CS_QUIET (-3)
+#define CS_BUSY (-4)
+#define CS_INTERRUPT (-5)
+#define CS_BLK_HAS_TEXT (-6)
+#define CS_CANCELED (-202)
+#define CS_ROW_FAIL (-203)
+#define CS_END_DATA (-204)
+#define CS_END_RESULTS (-205)
+#define CS_TIMED_OUT (-208)
+
+#define CS_TRUE 1
+#define CS_FALSE 0
+#define CS_NULLDATA (-1)
+#define CS_UNUSED (-99999)
+#define CS_NULLTERM (-9)
+#define CS_NO_LIMIT (-9999)
+
+// versions
+#define CS_VERSION_100 112
+#define CS_VERSION_110 1100
+#define CS_VERSION_125 12500
+#define CS_VERSION_150 15000
+#define CS_VERSION_155 15500
+#define CS_VERSION_157 15700
+#define CS_VERSION_160 16000
+
+// data types
+#define CS_CHAR_TYPE 0
+#define CS_BINARY_TYPE 1
+#define CS_LONGCHAR_TYPE 2
+#define CS_LONGBINARY_TYPE 3
+#define CS_TEXT_TYPE 4
+#define CS_IMAGE_TYPE 5
+#define CS_TINYINT_TYPE 6
+#define CS_SMALLINT_TYPE 7
+#define CS_INT_TYPE 8
+#define CS_REAL_TYPE 9
+#define CS_FLOAT_TYPE 10
+#define CS_BIT_TYPE 11
+#define CS_DATETIME_TYPE 12
+#define CS_DATETIME4_TYPE 13
+#define CS_MONEY_TYPE 14
+#define CS_MONEY4_TYPE 15
+#define CS_NUMERIC_TYPE 16
+#define CS_DECIMAL_TYPE 17
+#define CS_VARCHAR_TYPE 18
+#define CS_VARBINARY_TYPE 19
+#define CS_LONG_TYPE 20
+#define CS_SENSITIVITY_TYPE 21
+#define CS_BOUNDARY_TYPE 22
+#define CS_USHORT_TYPE 24
+#define CS_UNICHAR_TYPE 25
+#define CS_BLOB_TYPE 26
+#define CS_DATE_TYPE 27
+#define CS_TIME_TYPE 28
+#define CS_UNITEXT_TYPE 29
+#define CS_BIGINT_TYPE 30
+#define CS_USMALLINT_TYPE 31
+#define CS_UINT_TYPE 32
+#define CS_UBIGINT_TYPE 33
+#define CS_XML_TYPE 34
+#define CS_BIGDATETIME_TYPE 35
+#define CS_BIGTIME_TYPE 36
+#define CS_FMT_UNUSED 0
+
+// actions
+#define CS_GET 33
+#define CS_SET 34
+#define CS_CLEAR 35
+#define CS_SUPPORTED 36
+
+// properties
+#define CS_USERNAME 9100
+#define CS_PASSWORD 9101
+#define CS_APPNAME 9102
+#define CS_USERDATA 9103
+#define CS_LOC_PROP 9104
+#define CS_BULK_LOGIN 9105
+#define CS_CON_STATUS 9106
+#define CS_NETIO 9107
+#define CS_ENDPOINT 9108
+#define CS_VERSION 9109
+#define CS_VER_STRING 9110
+#define CS_MAX_CONNECT 9111
+#define CS_TIMEOUT 9112
+#define CS_CON_KEEPALIVE 9113
+#define CS_CON_TCP_NODELAY 9114
+#define CS_EXTERNAL_CONFIG 9115
+#define CS_CONFIG_FILE 9116
+#define CS_EXPOSE_FORMATS 9117
+#define CS_MESSAGE_CB 9118
+#define CS_CLIENTMSG_CB 9119
+#define CS_SERVERMSG_CB 9120
+#define CS_LC_ALL 9121
+
+#define CS_CONSTAT_CONNECTED 1
+#define CS_CONSTAT_DEAD 2
+#define CS_SYNC_IO 8111
+#define CS_ASYNC_IO 8112
+#define CS_DEFER_IO 8113
+
+// debug flags
+#define CS_DBG_ASYNC 0x1
+#define CS_DBG_ERROR 0x2
+#define CS_DBG_MEM 0x4
+#define CS_DBG_PROTOCOL 0x8
+#define CS_DBG_PROTOCOL_STATES 0x10
+#define CS_DBG_API_STATES 0x20
+#define CS_DBG_DIAG 0x40
+#define CS_DBG_NETWORK 0x80
+#define CS_DBG_API_LOGCALL 0x100
+#define CS_DBG_ALL 0x1ff
+#define CS_SET_FLAG 1700
+#define CS_SET_DBG_FILE 1701
+#define CS_SET_PROTOCOL_FILE 1702
+
+// commands
+#define CS_LANG_CMD 148
+#define CS_RPC_CMD 149
+#define CS_NO_RECOMPILE 188
+#define CS_PREPARE 717
+#define CS_EXECUTE 718
+#define CS_DESCRIBE_INPUT 720
+#define CS_DESCRIBE_OUTPUT 721
+#define CS_DEALLOC 711
+#define CS_CURSOR_DECLARE 700
+#define CS_CURSOR_OPEN 702
+#define CS_CURSOR_CLOSE 704
+#define CS_READ_ONLY 170
+#define CS_SCROLL_CURSOR 171
+#define CS_CANCEL_ALL 6001
+#define CS_CANCEL_ATTN 6002
+#define CS_CANCEL_CURRENT 6003
+#define CS_FORCE_EXIT 300
+#define CS_FORCE_CLOSE 301
+#define CS_INPUTVALUE 0x100
+#define CS_RETURN 0x20
+
+// result types
+#define CS_ROW_RESULT 4040
+#define CS_CURSOR_RESULT 4041
+#define CS_PARAM_RESULT 4042
+#define CS_STATUS_RESULT 4043
+#define CS_MSG_RESULT 4044
+#define CS_COMPUTE_RESULT 4045
+#define CS_CMD_DONE 4046
+#define CS_CMD_SUCCEED 4047
+#define CS_CMD_FAIL 4048
+#define CS_ROWFMT_RESULT 4049
+#define CS_COMPUTEFMT_RESULT 4050
+#define CS_DESCRIBE_RESULT 4051
+
+// result information
+#define CS_ROW_COUNT 800
+#define CS_NUMDATA 803
+#define CS_COMP_OP 5350
+#define CS_COMP_COLID 5351
+#define CS_OP_SUM 5370
+#define CS_OP_AVG 5371
+#define CS_OP_COUNT 5372
+#define CS_OP_MIN 5373
+#define CS_OP_MAX 5374
+
+// scrollable cursor fetch
+#define CS_FIRST 3000
+#define CS_NEXT 3001
+#define CS_PREV 3002
+#define CS_LAST 3003
+#define CS_CURSOR_BEFORE_FIRST (-210)
+#define CS_CURSOR_AFTER_LAST (-211)
+
+// asynchronous operation ids returned by ct_poll()
+#define CT_SEND 1
+#define CT_RESULTS 2
+#define CT_FETCH 3
+#define CT_CANCEL 4
+
+// message severities
+#define CS_SV_INFORM 0
+#define CS_SV_CONFIG_FAIL 1
+#define CS_SV_RETRY_FAIL 2
+#define CS_SV_API_FAIL 3
+#define CS_SV_RESOURCE_FAIL 4
+#define CS_SV_COMM_FAIL 5
+#define CS_SV_INTERNAL_FAIL 6
+#define CS_SV_FATAL 7
+#define CS_SEVERITY(x) (((x) >> 8) & 0xff)
+#define CS_LAYER(x) (((x) >> 24) & 0xff)
+#define CS_ORIGIN(x) (((x) >> 16) & 0xff)
+#define CS_NUMBER(x) ((x) & 0xff)
+
+
+struct CS_LOCALE;
+struct CS_CONTEXT;
+struct CS_CONNECTION;
+struct CS_COMMAND;
+
+typedef struct _cs_datafmt
+{
+    CS_CHAR name[CS_MAX_NAME];
+    CS_INT namelen;
+    CS_INT datatype;
+    CS_INT format;
+    CS_INT maxlength;
+    CS_INT scale;
+    CS_INT precision;
+    CS_INT status;
+    CS_INT count;
+    CS_INT usertype;
+    CS_LOCALE* locale;
+} CS_DATAFMT;
+
+typedef struct _cs_daterec
+{
+    CS_INT dateyear;
+    CS_INT datemonth;
+    CS_INT datedmonth;
+    CS_INT datedyear;
+    CS_INT datedweek;
+    CS_INT datehour;
+    CS_INT dateminute;
+    CS_INT datesecond;
+    CS_INT datemsecond;
+    CS_INT datetzone;
+    CS_INT datesecfrac;
+    CS_INT datesecprec;
+} CS_DATEREC;
+
+typedef struct _cs_clientmsg
+{
+    CS_INT severity;
+    CS_INT msgnumber;
+    CS_CHAR msgstring[CS_MAX_MSG];
+    CS_INT msgstringlen;
+    CS_INT osnumber;
+    CS_CHAR osstring[CS_MAX_MSG];
+    CS_INT osstringlen;
+} CS_CLIENTMSG;
+
+typedef struct _cs_servermsg
+{
+    CS_INT msgnumber;
+    CS_INT state;
+    CS_INT severity;
+    CS_CHAR text[CS_MAX_MSG];
+    CS_INT textlen;
+    CS_CHAR svrname[CS_MAX_CHAR];
+    CS_INT svrnlen;
+    CS_CHAR proc[CS_MAX_CHAR];
+    CS_INT proclen;
+    CS_INT line;
+} CS_SERVERMSG;
+
+
+
+namespace ctmock {
+
+/**
+ * value - is a column or parameter value in its native (CS_*_TYPE) representation
+ */
+struct value
+{
+    bool null = true;
+    std::string data;
+};
+
+inline value null()
+{
+    return value();
+}
+
+template <typename T>
+value make(T val)
+{
+    value v;
+    v.null = false;
+    v.data.assign(reinterpret_cast<const char*>(&val), sizeof(val));
+    return v;
+}
+
+inline value make(const std::string& str)
+{
+    value v;
+    v.null = false;
+    v.data = str;
+    return v;
+}
+
+inline value make(const char* str)
+{
+    return make(std::string(str));
+}
+
+template <typename T>
+T as(const value& v)
+{
+    T val = T();
+    std::memcpy(&val, v.data.data(), std::min(sizeof(val), v.data.size()));
+    return val;
+}
+
+struct column
+{
+    std::string name;
+    CS_INT datatype;
+    CS_INT maxlength;
+};
+
+/**
+ * result - is one result of a command returned by the server: rows, number of
+ * affected rows, failure of the command, or failure which also rolls back the
+ * transaction (eg deadlock)
+ */
+struct result
+{
+    enum kind_t { ROWS, DONE, FAIL, ABORT };
+    kind_t kind = DONE;
+    std::vector<column> columns;
+    std::vector<std::vector<value>> rows;
+    CS_INT count = 0;
+};
+
+inline result rows(const std::vector<column>& cols, const std::vector<std::vector<value>>& data)
+{
+    result r;
+    r.kind = result::ROWS;
+    r.columns = cols;
+    r.rows = data;
+    r.count = data.size();
+    return r;
+}
+
+inline result done(CS_INT count = 0)
+{
+    result r;
+    r.count = count;
+    return r;
+}
+
+inline result fail()
+{
+    result r;
+    r.kind = result::FAIL;
+    return r;
+}
+
+inline result abort_tran()
+{
+    result r;
+    r.kind = result::ABORT;
+    return r;
+}
+
+using response = std::vector<result>;
+
+struct table
+{
+    std::vector<column> columns;
+    std::vector<std::vector<value>> rows;
+};
+
+/**
+ * server_state - is the scripted server shared by all connections. Commands
+ * other than the transaction control ones and the table metadata queries of
+ * the driver are answered by handler (language commands get no parameters),
+ * input parameters of dynamic statements are described by params (CS_INT for
+ * each '?' of SQL text without entry). Server side events are recorded in log,
+ * eg "LANG begin tran", "PREPARE <sql>", "EXECUTE <sql>", "DEALLOC <sql>",
+ * "BLK BATCH <rows>"
+ */
+struct server_state
+{
+    std::mutex lock;
+    std::function<response(const std::string& sql, const std::vector<value>& params)> handler;
+    std::map<std::string, std::vector<column>> params;
+    std::map<std::string, table> tables;
+    std::vector<std::string> log;
+    // time after which deferred network operations complete
+    std::chrono::milliseconds latency = std::chrono::milliseconds(0);
+    // commands dropped while they had pending results or network I/O
+    size_t busy_drops = 0;
+    // completions returned by ct_poll
+    size_t polls = 0;
+
+    void reset()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        handler = nullptr;
+        params.clear();
+        tables.clear();
+        log.clear();
+        latency = std::chrono::milliseconds(0);
+        busy_drops = 0;
+        polls = 0;
+    }
+
+    size_t count(const std::string& prefix)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t cnt = 0;
+        for (auto& entry : log)
+            cnt += (0 == entry.compare(0, prefix.length(), prefix) ? 1 : 0);
+        return cnt;
+    }
+};
+
+inline server_state& server()
+{
+    static server_state srv;
+    return srv;
+}
+
+struct item
+{
+    CS_INT restype = 0;
+    std::vector<column> columns;
+    std::vector<std::vector<value>> rows;
+    CS_INT count = -1;
+};
+
+struct binding
+{
+    CS_INT datatype = 0;
+    CS_INT maxlength = 0;
+    CS_INT count = 0;
+    CS_VOID* buffer = nullptr;
+    CS_INT* length = nullptr;
+    CS_SMALLINT* indicator = nullptr;
+};
+
+struct param
+{
+    CS_DATAFMT fmt;
+    CS_VOID* data;
+    CS_INT* length;
+    CS_SMALLINT* indicator;
+};
+
+struct completion
+{
+    CS_CONNECTION* conn;
+    CS_COMMAND* cmd;
+    CS_INT id;
+    std::function<CS_RETCODE()> op;
+    std::chrono::steady_clock::time_point ready;
+};
+
+} // namespace ctmock
+
+
+
+struct CS_LOCALE
+{
+};
+
+struct CS_CONTEXT
+{
+    std::vector<char> userdata;
+    std::deque<ctmock::completion> completions;
+};
+
+struct CS_CONNECTION
+{
+    CS_CONTEXT* context = nullptr;
+    CS_INT status = 0;
+    CS_BOOL bulk_login = CS_FALSE;
+    CS_INT netio = CS_SYNC_IO;
+    std::string username;
+    std::string password;
+    std::string servername;
+    std::vector<char> userdata;
+    // server side state of the session
+    int trancount = 0;
+    std::map<std::string, std::string> dynamic;
+    std::set<CS_COMMAND*> commands;
+};
+
+struct CS_COMMAND
+{
+    CS_CONNECTION* conn = nullptr;
+    CS_INT type = 0;
+    std::string text;
+    std::string id;
+    std::vector<ctmock::param> params;
+    // sent and not yet fully processed
+    bool active = false;
+    // deferred network operation not yet completed by ct_poll
+    bool in_flight = false;
+    std::deque<ctmock::item> results;
+    ctmock::item current;
+    size_t row = 0;
+    std::vector<ctmock::binding> bindings;
+};
+
+
+
+namespace ctmock { namespace detail {
+
+inline std::string text(const CS_CHAR* buf, CS_INT len)
+{
+    if (nullptr == buf)
+        return std::string();
+    return (CS_NULLTERM == len || CS_UNUSED == len ? std::string(buf) : std::string(buf, len));
+}
+
+inline size_t fixed_size(CS_INT type)
+{
+    switch (type)
+    {
+        case CS_BIT_TYPE:
+        case CS_TINYINT_TYPE:   return sizeof(CS_TINYINT);
+        case CS_SMALLINT_TYPE:  return sizeof(CS_SMALLINT);
+        case CS_USHORT_TYPE:
+        case CS_USMALLINT_TYPE: return sizeof(CS_USHORT);
+        case CS_INT_TYPE:       return sizeof(CS_INT);
+        case CS_UINT_TYPE:      return sizeof(CS_UINT);
+        case CS_LONG_TYPE:      return sizeof(CS_LONG);
+        case CS_BIGINT_TYPE:    return sizeof(CS_BIGINT);
+        case CS_UBIGINT_TYPE:   return sizeof(CS_UBIGINT);
+        case CS_REAL_TYPE:      return sizeof(CS_REAL);
+        case CS_FLOAT_TYPE:     return sizeof(CS_FLOAT);
+        default:                return 0;
+    }
+}
+
+inline bool is_text(CS_INT type)
+{
+    return (CS_CHAR_TYPE == type || CS_VARCHAR_TYPE == type || CS_LONGCHAR_TYPE == type || CS_TEXT_TYPE == type);
+}
+
+inline bool is_binary(CS_INT type)
+{
+    return (CS_BINARY_TYPE == type || CS_VARBINARY_TYPE == type || CS_LONGBINARY_TYPE == type || CS_IMAGE_TYPE == type);
+}
+
+/**
+ * scalar - is a value being converted between data types
+ */
+struct scalar
+{
+    enum kind_t { NONE, INTEGER, REAL, TEXT, BINARY };
+    kind_t kind = NONE;
+    long long i = 0;
+    double d = 0.0;
+    std::string s;
+};
+
+template <typename T>
+T load_as(const CS_VOID* src)
+{
+    T val;
+    std::memcpy(&val, src, sizeof(val));
+    return val;
+}
+
+inline scalar load(CS_INT type, const CS_VOID* src, CS_INT len)
+{
+    scalar sc;
+    sc.kind = scalar::INTEGER;
+    switch (type)
+    {
+        case CS_BIT_TYPE:
+        case CS_TINYINT_TYPE:   sc.i = load_as<CS_TINYINT>(src); break;
+        case CS_SMALLINT_TYPE:  sc.i = load_as<CS_SMALLINT>(src); break;
+        case CS_USHORT_TYPE:
+        case CS_USMALLINT_TYPE: sc.i = load_as<CS_USHORT>(src); break;
+        case CS_INT_TYPE:       sc.i = load_as<CS_INT>(src); break;
+        case CS_UINT_TYPE:      sc.i = load_as<CS_UINT>(src); break;
+        case CS_LONG_TYPE:      sc.i = load_as<CS_LONG>(src); break;
+        case CS_BIGINT_TYPE:    sc.i = load_as<CS_BIGINT>(src); break;
+        case CS_UBIGINT_TYPE:   sc.i = static_cast<long long>(load_as<CS_UBIGINT>(src)); break;
+        case CS_REAL_TYPE:      sc.kind = scalar::REAL; sc.d = load_as<CS_REAL>(src); break;
+        case CS_FLOAT_TYPE:     sc.kind = scalar::REAL; sc.d = load_as<CS_FLOAT>(src); break;
+        default:
+            if (is_text(type))
+                sc.kind = scalar::TEXT;
+            else if (is_binary(type))
+                sc.kind = scalar::BINARY;
+            else
+                sc.kind = scalar::NONE;
+            sc.s.assign(static_cast<const char*>(src), std::max(0, len));
+    }
+    return sc;
+}
+
+template <typename T>
+bool store_as(long long val, CS_VOID* dest, CS_INT* outlen)
+{
+    if (val < static_cast<long long>(std::numeric_limits<T>::min()) || (val > 0 && static_cast<unsigned long long>(val) > std::numeric_limits<T>::max()))
+        return false;
+    T t = static_cast<T>(val);
+    std::memcpy(dest, &t, sizeof(t));
+    if (nullptr != outlen)
+        *outlen = sizeof(t);
+    return true;
+}
+
+/**
+ * Function converts the value to the data type, conversions between numbers,
+ * numbers and character data, and character and binary data are supported
+ * @return false if the conversion is not supported or the value doesn't fit
+ */
+inline bool store(const scalar& sc, CS_INT type, CS_INT maxlength, CS_VOID* dest, CS_INT* outlen)
+{
+    if (scalar::NONE == sc.kind)
+        return false;
+    if (is_text(type) || is_binary(type))
+    {
+        std::string str;
+        char buf[64];
+        switch (sc.kind)
+        {
+            case scalar::INTEGER:
+                str = std::to_string(sc.i);
+                break;
+            case scalar::REAL:
+                std::snprintf(buf, sizeof(buf), "%.15g", sc.d);
+                str = buf;
+                break;
+            default:
+                str = sc.s;
+        }
+        if ((is_binary(type) && scalar::BINARY != sc.kind && scalar::TEXT != sc.kind) || str.length() > static_cast<size_t>(maxlength))
+            return false;
+        std::memcpy(dest, str.data(), str.length());
+        if (nullptr != outlen)
+            *outlen = str.length();
+        return true;
+    }
+    if (scalar::BINARY == sc.kind)
+        return false;
+    if (CS_REAL_TYPE == type || CS_FLOAT_TYPE == type)
+    {
+        double d = sc.d;
+        if (scalar::INTEGER == sc.kind)
+            d = sc.i;
+        else if (scalar::TEXT == sc.kind)
+        {
+            char* end = nullptr;
+            d = std::strtod(sc.s.c_str(), &end);
+            if (end == sc.s.c_str() || '\0' != *end)
+                return false;
+        }
+        if (CS_REAL_TYPE == type)
+        {
+            CS_REAL r = static_cast<CS_REAL>(d);
+            std::memcpy(dest, &r, sizeof(r));
+        }
+        else
+            std::memcpy(dest, &d, sizeof(d));
+        if (nullptr != outlen)
+            *outlen = fixed_size(type);
+        return true;
+    }
+    long long i = sc.i;
+    if (scalar::REAL == sc.kind)
+    {
+        if (false == std::isfinite(sc.d) || std::fabs(sc.d) >= 9.2e18)
+            return false;
+        i = static_cast<long long>(sc.d);
+    }
+    else if (scalar::TEXT == sc.kind)
+    {
+        char* end = nullptr;
+        i = std::strtoll(sc.s.c_str(), &end, 10);
+        if (end == sc.s.c_str() || '\0' != *end)
+            return false;
+    }
+    switch (type)
+    {
+        case CS_BIT_TYPE:       return (i >= 0 && i <= 1 && store_as<CS_BIT>(i, dest, outlen));
+        case CS_TINYINT_TYPE:   return store_as<CS_TINYINT>(i, dest, outlen);
+        case CS_SMALLINT_TYPE:  return store_as<CS_SMALLINT>(i, dest, outlen);
+        case CS_USHORT_TYPE:
+        case CS_USMALLINT_TYPE: return store_as<CS_USHORT>(i, dest, outlen);
+        case CS_INT_TYPE:       return store_as<CS_INT>(i, dest, outlen);
+        case CS_UINT_TYPE:      return store_as<CS_UINT>(i, dest, outlen);
+        case CS_LONG_TYPE:      return store_as<CS_LONG>(i, dest, outlen);
+        case CS_BIGINT_TYPE:    return store_as<CS_BIGINT>(i, dest, outlen);
+        case CS_UBIGINT_TYPE:   return store_as<CS_UBIGINT>(i, dest, outlen);
+        default:                return false;
+    }
+}
+
+/**
+ * Function copies the value into row r of the bound array
+ */
+inline bool copy_out(const value& v, const column& col, binding& b, size_t r)
+{
+    if (nullptr == b.buffer)
+        return true;
+    CS_INT len = 0;
+    CS_SMALLINT ind = 0;
+    auto dest = static_cast<char*>(b.buffer) + r * b.maxlength;
+    if (v.null)
+        ind = CS_NULLDATA;
+    else if (b.datatype == col.datatype)
+    {
+        if (v.data.size() > static_cast<size_t>(b.maxlength))
+            return false;
+        std::memcpy(dest, v.data.data(), v.data.size());
+        len = v.data.size();
+    }
+    else if (false == store(load(col.datatype, v.data.data(), v.data.size()), b.datatype, b.maxlength, dest, &len))
+        return false;
+    if (nullptr != b.length)
+        b.length[r] = len;
+    if (nullptr != b.indicator)
+        b.indicator[r] = ind;
+    return true;
+}
+
+/**
+ * Function reads value of bound (ct_setparam or blk_bind) buffer as column
+ * data type
+ */
+inline bool copy_in(const CS_VOID* data, CS_INT datatype, const CS_INT* length, const CS_SMALLINT* indicator, const column& col, value& v)
+{
+    v = value();
+    if (nullptr != indicator && CS_NULLDATA == *indicator)
+        return true;
+    size_t len = fixed_size(datatype);
+    if (0 == len)
+        len = (nullptr != length ? *length : 0);
+    if (datatype == col.datatype)
+    {
+        if (len > static_cast<size_t>(col.maxlength))
+            return false;
+        v.data.assign(static_cast<const char*>(data), len);
+    }
+    else
+    {
+        std::vector<char> buf(std::max<size_t>(col.maxlength, 64));
+        CS_INT outlen = 0;
+        if (false == store(load(datatype, data, len), col.datatype, col.maxlength, buf.data(), &outlen))
+            return false;
+        v.data.assign(buf.data(), outlen);
+    }
+    v.null = false;
+    return true;
+}
+
+inline void respond(CS_COMMAND* cmd, const response& resp)
+{
+    for (auto& res : resp)
+    {
+        item it;
+        switch (res.kind)
+        {
+            case result::ROWS:
+                it.restype = CS_ROW_RESULT;
+                it.columns = res.columns;
+                it.rows = res.rows;
+                cmd->results.push_back(it);
+                it = item();
+                it.restype = CS_CMD_DONE;
+                it.count = res.rows.size();
+                break;
+            case result::DONE:
+                it.restype = CS_CMD_SUCCEED;
+                cmd->results.push_back(it);
+                it.restype = CS_CMD_DONE;
+                it.count = res.count;
+                break;
+            case result::ABORT:
+                cmd->conn->trancount = 0;
+                // fall through
+            case result::FAIL:
+                it.restype = CS_CMD_FAIL;
+                cmd->results.push_back(it);
+                it.restype = CS_CMD_DONE;
+                it.count = 0;
+                break;
+        }
+        cmd->results.push_back(it);
+    }
+}
+
+inline bool starts_with(const std::string& str, const std::string& prefix)
+{
+    return (0 == str.compare(0, prefix.length(), prefix));
+}
+
+/**
+ * Function answers commands which are implemented by the server itself
+ * @return false if the command has to be answered by the handler
+ */
+inline bool builtin(CS_CONNECTION* conn, const std::string& sql, response& resp)
+{
+    auto& srv = server();
+    if ("begin tran" == sql)
+        conn->trancount += 1;
+    else if ("commit tran" == sql || "commit tran begin tran" == sql)
+    {
+        if (0 == conn->trancount)
+            resp.push_back(fail());
+        else
+            conn->trancount -= 1;
+        if ("commit tran begin tran" == sql)
+            conn->trancount += 1;
+    }
+    else if ("rollback tran" == sql || "rollback tran begin tran" == sql)
+    {
+        if (0 == conn->trancount)
+            resp.push_back(fail());
+        conn->trancount = ("rollback tran" == sql ? 0 : 1);
+    }
+    else if ("select @@trancount" == sql)
+        resp.push_back(rows({{"", CS_INT_TYPE, sizeof(CS_INT)}}, {{make<CS_INT>(conn->trancount)}}));
+    else if (starts_with(sql, "if object_id('dbo.sysobjects')"))
+        resp.push_back(rows({{"", CS_INT_TYPE, sizeof(CS_INT)}}, {{make<CS_INT>(1)}}));
+    else if (starts_with(sql, "select * from ") && sql.length() > 26 && 0 == sql.compare(sql.length() - 12, 12, " where 1 = 0"))
+    {
+        // column count query of bulk_writer
+        auto tbl = srv.tables.find(sql.substr(14, sql.length() - 26));
+        if (tbl == srv.tables.end())
+            resp.push_back(fail());
+        else
+            resp.push_back(rows(tbl->second.columns, {}));
+    }
+    else
+        return false;
+    if (resp.empty())
+        resp.push_back(done());
+    return true;
+}
+
+inline std::vector<column> describe(const std::string& sql)
+{
+    auto& srv = server();
+    auto it = srv.params.find(sql);
+    if (it != srv.params.end())
+        return it->second;
+    std::vector<column> cols;
+    for (auto c : sql)
+    {
+        if ('?' == c)
+            cols.push_back({"@p" + std::to_string(cols.size() + 1), CS_INT_TYPE, sizeof(CS_INT)});
+    }
+    return cols;
+}
+
+/**
+ * Function processes sent command on the server and queues its results
+ */
+inline void send(CS_COMMAND* cmd)
+{
+    auto& srv = server();
+    std::lock_guard<std::mutex> guard(srv.lock);
+    auto conn = cmd->conn;
+    response resp;
+    cmd->results.clear();
+    cmd->current = item();
+    cmd->bindings.clear();
+    cmd->active = true;
+    if (CS_LANG_CMD == cmd->type || CS_RPC_CMD == cmd->type)
+    {
+        srv.log.push_back("LANG " + cmd->text);
+        if (false == builtin(conn, cmd->text, resp))
+            resp = (srv.handler ? srv.handler(cmd->text, std::vector<value>()) : response{done()});
+        respond(cmd, resp);
+        return;
+    }
+    auto dyn = conn->dynamic.find(cmd->id);
+    if (CS_PREPARE == cmd->type)
+    {
+        srv.log.push_back("PREPARE " + cmd->text);
+        conn->dynamic[cmd->id] = cmd->text;
+        resp.push_back(done());
+    }
+    else if (dyn == conn->dynamic.end())
+    {
+        // the statement doesn't exist on the server
+        srv.log.push_back("UNKNOWN " + cmd->id);
+        resp.push_back(fail());
+    }
+    else if (CS_DESCRIBE_INPUT == cmd->type)
+    {
+        item it;
+        it.restype = CS_DESCRIBE_RESULT;
+        it.columns = describe(dyn->second);
+        cmd->results.push_back(it);
+        resp.push_back(done());
+    }
+    else if (CS_EXECUTE == cmd->type)
+    {
+        srv.log.push_back("EXECUTE " + dyn->second);
+        auto cols = describe(dyn->second);
+        std::vector<value> vals(cmd->params.size());
+        for (size_t i = 0; i < cmd->params.size(); ++i)
+        {
+            auto& p = cmd->params[i];
+            if (i >= cols.size() || false == copy_in(p.data, p.fmt.datatype, p.length, p.indicator, cols[i], vals[i]))
+            {
+                resp.push_back(fail());
+                break;
+            }
+        }
+        if (resp.empty())
+            resp = (srv.handler ? srv.handler(dyn->second, vals) : response{done()});
+    }
+    else if (CS_DEALLOC == cmd->type)
+    {
+        srv.log.push_back("DEALLOC " + dyn->second);
+        conn->dynamic.erase(dyn);
+        resp.push_back(done());
+    }
+    respond(cmd, resp);
+}
+
+inline CS_RETCODE results(CS_COMMAND* cmd, CS_INT* restype)
+{
+    cmd->bindings.clear();
+    cmd->row = 0;
+    if (cmd->results.empty())
+    {
+        cmd->current = item();
+        cmd->active = false;
+        return CS_END_RESULTS;
+    }
+    cmd->current = cmd->results.front();
+    cmd->results.pop_front();
+    cmd->bindings.resize(cmd->current.columns.size());
+    if (nullptr != restype)
+        *restype = cmd->current.restype;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE fetch(CS_COMMAND* cmd, CS_INT* rows_read)
+{
+    auto& cur = cmd->current;
+    if (nullptr != rows_read)
+        *rows_read = 0;
+    if (CS_ROW_RESULT != cur.restype || cmd->bindings.empty())
+        return CS_FAIL;
+    if (cmd->row >= cur.rows.size())
+        return CS_END_DATA;
+    size_t cnt = std::min<size_t>(std::max(1, cmd->bindings[0].count), cur.rows.size() - cmd->row);
+    for (size_t r = 0; r < cnt; ++r)
+    {
+        for (size_t c = 0; c < cmd->bindings.size(); ++c)
+        {
+            if (false == copy_out(cur.rows[cmd->row + r][c], cur.columns[c], cmd->bindings[c], r))
+                return CS_ROW_FAIL;
+        }
+    }
+    cmd->row += cnt;
+    if (nullptr != rows_read)
+        *rows_read = cnt;
+    return CS_SUCCEED;
+}
+
+inline void cancel(CS_COMMAND* cmd)
+{
+    auto& queue = cmd->conn->context->completions;
+    for (auto it = queue.begin(); it != queue.end(); )
+        it = (it->cmd == cmd ? queue.erase(it) : it + 1);
+    cmd->results.clear();
+    cmd->current = item();
+    cmd->bindings.clear();
+    cmd->active = false;
+    cmd->in_flight = false;
+}
+
+/**
+ * Function queues network operation of a command on deferred I/O connection,
+ * the operation is done when ct_poll() returns its completion
+ */
+inline CS_RETCODE defer(CS_COMMAND* cmd, CS_INT id, std::function<CS_RETCODE()> op)
+{
+    cmd->in_flight = true;
+    cmd->conn->context->completions.push_back({cmd->conn, cmd, id, std::move(op), std::chrono::steady_clock::now() + server().latency});
+    return CS_PENDING;
+}
+
+inline bool deferred(CS_COMMAND* cmd)
+{
+    return (CS_DEFER_IO == cmd->conn->netio);
+}
+
+} } // namespace ctmock::detail
+
+
+
+// CS-Library
+
+inline CS_RETCODE cs_ctx_alloc(CS_INT version, CS_CONTEXT** context)
+{
+    *context = new CS_CONTEXT();
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE cs_ctx_drop(CS_CONTEXT* context)
+{
+    delete context;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE cs_config(CS_CONTEXT* context, CS_INT action, CS_INT property, CS_VOID* buffer, CS_INT buflen, CS_INT* outlen)
+{
+    if (nullptr == context)
+        return CS_FAIL;
+    if (CS_USERDATA == property)
+    {
+        if (CS_SET == action)
+            context->userdata.assign(static_cast<char*>(buffer), static_cast<char*>(buffer) + buflen);
+        else if (CS_GET == action)
+        {
+            if (static_cast<size_t>(buflen) < context->userdata.size())
+                return CS_FAIL;
+            std::memcpy(buffer, context->userdata.data(), context->userdata.size());
+            if (nullptr != outlen)
+                *outlen = context->userdata.size();
+        }
+    }
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE cs_loc_alloc(CS_CONTEXT* context, CS_LOCALE** locale)
+{
+    *locale = new CS_LOCALE();
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE cs_loc_drop(CS_CONTEXT* context, CS_LOCALE* locale)
+{
+    delete locale;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE cs_locale(CS_CONTEXT* context, CS_INT action, CS_LOCALE* locale, CS_INT type, CS_CHAR* buffer, CS_INT buflen, CS_INT* outlen)
+{
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE cs_convert(CS_CONTEXT* context, CS_DATAFMT* srcfmt, CS_VOID* srcdata, CS_DATAFMT* destfmt, CS_VOID* destdata, CS_INT* resultlen)
+{
+    auto sc = ctmock::detail::load(srcfmt->datatype, srcdata, srcfmt->maxlength);
+    return (ctmock::detail::store(sc, destfmt->datatype, destfmt->maxlength, destdata, resultlen) ? CS_SUCCEED : CS_FAIL);
+}
+
+inline CS_RETCODE cs_dt_crack(CS_CONTEXT* context, CS_INT datetype, CS_VOID* dateval, CS_DATEREC* daterec)
+{
+    // date and time types are not supported
+    return CS_FAIL;
+}
+
+
+
+// Client-Library
+
+inline CS_RETCODE ct_init(CS_CONTEXT* context, CS_INT version)
+{
+    return (nullptr != context ? CS_SUCCEED : CS_FAIL);
+}
+
+inline CS_RETCODE ct_exit(CS_CONTEXT* context, CS_INT option)
+{
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_config(CS_CONTEXT* context, CS_INT action, CS_INT property, CS_VOID* buffer, CS_INT buflen, CS_INT* outlen)
+{
+    if (nullptr == context)
+        return CS_FAIL;
+    if (CS_GET == action && CS_VER_STRING == property)
+    {
+        std::snprintf(static_cast<char*>(buffer), buflen, "Sybase Client-Library/16.0/mock/BUILD160-000");
+        if (nullptr != outlen)
+            *outlen = std::strlen(static_cast<char*>(buffer));
+    }
+    else if (CS_GET == action && CS_VERSION == property)
+        *static_cast<CS_INT*>(buffer) = CS_VERSION_160;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_callback(CS_CONTEXT* context, CS_CONNECTION* connection, CS_INT action, CS_INT type, CS_VOID* func)
+{
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_debug(CS_CONTEXT* context, CS_CONNECTION* connection, CS_INT operation, CS_INT flag, CS_CHAR* filename, CS_INT fnamelen)
+{
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_con_alloc(CS_CONTEXT* context, CS_CONNECTION** connection)
+{
+    if (nullptr == context)
+        return CS_FAIL;
+    *connection = new CS_CONNECTION();
+    (*connection)->context = context;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_con_drop(CS_CONNECTION* connection)
+{
+    if (nullptr == connection || false == connection->commands.empty())
+        return CS_FAIL;
+    delete connection;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_con_props(CS_CONNECTION* connection, CS_INT action, CS_INT property, CS_VOID* buffer, CS_INT buflen, CS_INT* outlen)
+{
+    if (nullptr == connection)
+        return CS_FAIL;
+    auto set = (CS_SET == action);
+    switch (property)
+    {
+        case CS_USERNAME:
+            if (set)
+                connection->username = ctmock::detail::text(static_cast<CS_CHAR*>(buffer), buflen);
+            break;
+        case CS_PASSWORD:
+            if (set)
+                connection->password = ctmock::detail::text(static_cast<CS_CHAR*>(buffer), buflen);
+            break;
+        case CS_CON_STATUS:
+            if (set)
+                return CS_FAIL;
+            *static_cast<CS_INT*>(buffer) = connection->status;
+            break;
+        case CS_BULK_LOGIN:
+            if (set)
+                connection->bulk_login = *static_cast<CS_BOOL*>(buffer);
+            else
+                *static_cast<CS_BOOL*>(buffer) = connection->bulk_login;
+            break;
+        case CS_NETIO:
+            if (set)
+                connection->netio = *static_cast<CS_INT*>(buffer);
+            else
+                *static_cast<CS_INT*>(buffer) = connection->netio;
+            break;
+        case CS_ENDPOINT:
+            if (set || 0 == connection->status)
+                return CS_FAIL;
+            *static_cast<CS_INT*>(buffer) = 3;
+            break;
+        case CS_USERDATA:
+            if (set)
+                connection->userdata.assign(static_cast<char*>(buffer), static_cast<char*>(buffer) + buflen);
+            else
+            {
+                if (static_cast<size_t>(buflen) < connection->userdata.size())
+                    return CS_FAIL;
+                std::memcpy(buffer, connection->userdata.data(), connection->userdata.size());
+                if (nullptr != outlen)
+                    *outlen = connection->userdata.size();
+            }
+            break;
+    }
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_connect(CS_CONNECTION* connection, CS_CHAR* server_name, CS_INT snamelen)
+{
+    if (nullptr == connection || 0 != connection->status)
+        return CS_FAIL;
+    auto& srv = ctmock::server();
+    std::lock_guard<std::mutex> guard(srv.lock);
+    connection->servername = ctmock::detail::text(server_name, snamelen);
+    connection->status = CS_CONSTAT_CONNECTED;
+    connection->trancount = 0;
+    connection->dynamic.clear();
+    srv.log.push_back("CONNECT " + connection->servername);
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_close(CS_CONNECTION* connection, CS_INT option)
+{
+    if (nullptr == connection || 0 == connection->status)
+        return CS_FAIL;
+    auto& srv = ctmock::server();
+    std::lock_guard<std::mutex> guard(srv.lock);
+    for (auto cmd : connection->commands)
+        ctmock::detail::cancel(cmd);
+    // the server rolls back the transaction and drops dynamic statements of the session
+    connection->status = 0;
+    connection->trancount = 0;
+    connection->dynamic.clear();
+    srv.log.push_back("CLOSE " + connection->servername);
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_cmd_alloc(CS_CONNECTION* connection, CS_COMMAND** cmd)
+{
+    if (nullptr == connection)
+        return CS_FAIL;
+    *cmd = new CS_COMMAND();
+    (*cmd)->conn = connection;
+    connection->commands.insert(*cmd);
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_cmd_drop(CS_COMMAND* cmd)
+{
+    if (nullptr == cmd)
+        return CS_FAIL;
+    auto ret = CS_SUCCEED;
+    if (cmd->active || cmd->in_flight)
+    {
+        // the real library refuses to drop it, the mock counts the error and drops it anyway
+        auto& srv = ctmock::server();
+        std::lock_guard<std::mutex> guard(srv.lock);
+        srv.busy_drops += 1;
+        ret = CS_FAIL;
+    }
+    ctmock::detail::cancel(cmd);
+    cmd->conn->commands.erase(cmd);
+    delete cmd;
+    return ret;
+}
+
+inline CS_RETCODE ct_command(CS_COMMAND* cmd, CS_INT type, CS_CHAR* buffer, CS_INT buflen, CS_INT option)
+{
+    if (nullptr == cmd || (CS_LANG_CMD != type && CS_RPC_CMD != type) || cmd->active)
+        return CS_FAIL;
+    cmd->type = type;
+    cmd->text = ctmock::detail::text(buffer, buflen);
+    cmd->id.clear();
+    cmd->params.clear();
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_dynamic(CS_COMMAND* cmd, CS_INT type, CS_CHAR* id, CS_INT idlen, CS_CHAR* buffer, CS_INT buflen)
+{
+    if (nullptr == cmd || cmd->active)
+        return CS_FAIL;
+    switch (type)
+    {
+        case CS_PREPARE:
+        case CS_DESCRIBE_INPUT:
+        case CS_EXECUTE:
+        case CS_DEALLOC:
+            break;
+        default:
+            return CS_FAIL;
+    }
+    cmd->type = type;
+    cmd->id = ctmock::detail::text(id, idlen);
+    cmd->text = ctmock::detail::text(buffer, buflen);
+    cmd->params.clear();
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_cursor(CS_COMMAND* cmd, CS_INT type, CS_CHAR* name, CS_INT namelen, CS_CHAR* text, CS_INT tlen, CS_INT option)
+{
+    // cursors are not supported
+    return CS_FAIL;
+}
+
+inline CS_RETCODE ct_setparam(CS_COMMAND* cmd, CS_DATAFMT* datafmt, CS_VOID* data, CS_INT* datalen, CS_SMALLINT* indicator)
+{
+    if (nullptr == cmd || nullptr == datafmt || CS_EXECUTE != cmd->type || cmd->active)
+        return CS_FAIL;
+    cmd->params.push_back({*datafmt, data, datalen, indicator});
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_send(CS_COMMAND* cmd)
+{
+    if (nullptr == cmd || 0 == cmd->type || cmd->active || 0 == cmd->conn->status)
+        return CS_FAIL;
+    if (ctmock::detail::deferred(cmd))
+    {
+        cmd->active = true;
+        return ctmock::detail::defer(cmd, CT_SEND, [cmd]() { ctmock::detail::send(cmd); return CS_SUCCEED; });
+    }
+    ctmock::detail::send(cmd);
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_results(CS_COMMAND* cmd, CS_INT* result_type)
+{
+    if (nullptr == cmd)
+        return CS_FAIL;
+    if (ctmock::detail::deferred(cmd))
+        return ctmock::detail::defer(cmd, CT_RESULTS, [cmd, result_type]() { return ctmock::detail::results(cmd, result_type); });
+    return ctmock::detail::results(cmd, result_type);
+}
+
+inline CS_RETCODE ct_res_info(CS_COMMAND* cmd, CS_INT type, CS_VOID* buffer, CS_INT buflen, CS_INT* outlen)
+{
+    if (nullptr == cmd)
+        return CS_FAIL;
+    switch (type)
+    {
+        case CS_NUMDATA:
+            *static_cast<CS_INT*>(buffer) = cmd->current.columns.size();
+            return CS_SUCCEED;
+        case CS_ROW_COUNT:
+            *static_cast<CS_INT*>(buffer) = cmd->current.count;
+            return CS_SUCCEED;
+        default:
+            return CS_FAIL;
+    }
+}
+
+inline CS_RETCODE ct_describe(CS_COMMAND* cmd, CS_INT item, CS_DATAFMT* datafmt)
+{
+    if (nullptr == cmd || item < 1 || static_cast<size_t>(item) > cmd->current.columns.size())
+        return CS_FAIL;
+    auto& col = cmd->current.columns[item - 1];
+    std::memset(datafmt, 0, sizeof(CS_DATAFMT));
+    std::snprintf(datafmt->name, CS_MAX_NAME, "%s", col.name.c_str());
+    datafmt->namelen = std::strlen(datafmt->name);
+    datafmt->datatype = col.datatype;
+    datafmt->format = CS_FMT_UNUSED;
+    datafmt->maxlength = col.maxlength;
+    datafmt->status = (CS_DESCRIBE_RESULT == cmd->current.restype ? CS_INPUTVALUE : 0);
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_bind(CS_COMMAND* cmd, CS_INT item, CS_DATAFMT* datafmt, CS_VOID* buffer, CS_INT* copied, CS_SMALLINT* indicator)
+{
+    if (nullptr == cmd || item < 1 || static_cast<size_t>(item) > cmd->bindings.size())
+        return CS_FAIL;
+    auto& b = cmd->bindings[item - 1];
+    b.datatype = datafmt->datatype;
+    b.maxlength = datafmt->maxlength;
+    b.count = std::max(1, datafmt->count);
+    b.buffer = buffer;
+    b.length = copied;
+    b.indicator = indicator;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_fetch(CS_COMMAND* cmd, CS_INT type, CS_INT offset, CS_INT option, CS_INT* rows_read)
+{
+    if (nullptr == cmd)
+        return CS_FAIL;
+    if (ctmock::detail::deferred(cmd))
+        return ctmock::detail::defer(cmd, CT_FETCH, [cmd, rows_read]() { return ctmock::detail::fetch(cmd, rows_read); });
+    return ctmock::detail::fetch(cmd, rows_read);
+}
+
+inline CS_RETCODE ct_scroll_fetch(CS_COMMAND* cmd, CS_INT type, CS_INT offset, CS_INT option, CS_INT* rows_read)
+{
+    // cursors are not supported
+    return CS_FAIL;
+}
+
+inline CS_RETCODE ct_compute_info(CS_COMMAND* cmd, CS_INT type, CS_INT colnum, CS_VOID* buffer, CS_INT buflen, CS_INT* outlen)
+{
+    // compute results are not supported
+    return CS_FAIL;
+}
+
+inline CS_RETCODE ct_cancel(CS_CONNECTION* connection, CS_COMMAND* cmd, CS_INT type)
+{
+    if (nullptr != cmd)
+        ctmock::detail::cancel(cmd);
+    else if (nullptr != connection)
+    {
+        for (auto c : connection->commands)
+            ctmock::detail::cancel(c);
+    }
+    else
+        return CS_FAIL;
+    return CS_SUCCEED;
+}
+
+inline CS_RETCODE ct_poll(CS_CONTEXT* context, CS_CONNECTION* connection, CS_INT milliseconds, CS_CONNECTION** compconn,
+                          CS_COMMAND** compcmd, CS_INT* compid, CS_INT* compstatus)
+{
+    if (nullptr == context)
+        return CS_FAIL;
+    auto& queue = context->completions;
+    auto it = queue.begin();
+    while (it != queue.end() && nullptr != connection && it->conn != connection)
+        ++it;
+    if (it == queue.end())
+        return CS_QUIET;
+    auto now = std::chrono::steady_clock::now();
+    if (it->ready > now)
+    {
+        if (0 == milliseconds)
+            return CS_TIMED_OUT;
+        auto wait = it->ready - now;
+        if (CS_NO_LIMIT != milliseconds && wait > std::chrono::milliseconds(milliseconds))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+            return CS_TIMED_OUT;
+        }
+        std::this_thread::sleep_for(wait);
+    }
+    auto comp = std::move(*it);
+    queue.erase(it);
+    comp.cmd->in_flight = false;
+    auto status = comp.op();
+    {
+        auto& srv = ctmock::server();
+        std::lock_guard<std::mutex> guard(srv.lock);
+        srv.polls += 1;
+    }
+    if (nullptr != compconn)
+        *compconn = comp.conn;
+    if (nullptr != compcmd)
+        *compcmd = comp.cmd;
+    if (nullptr != compid)
+        *compid = comp.id;
+    if (nullptr != compstatus)
+        *compstatus = status;
+    return CS_SUCCEED;
+}
+
+#endif // CTPUBLIC_H
@@ -0,0 +1,328 @@
+#include "sybase_driver.hpp"
+
+#include <chrono>
+#include <functional>
+#include <vector>
+using namespace std;
+using namespace vgi::dbconn::dbi;
+using namespace vgi::dbconn::dbd;
+
+/*
+ * Regression checks of the driver run against in-memory Client-Library in
+ * sybase_mock directory, each test prints failed checks and the program exits
+ * with non-zero status if any check failed.
+ */
+
+constexpr auto SERVER = "MOCK";
+
+static int failures = 0;
+
+#define CHECK(expr) \
+    do { if (false == static_cast<bool>(expr)) { ++failures; cout << __FILE__ << ":" << __LINE__ << ": check failed: " #expr "\n"; } } while (false)
+
+static connection get_connection()
+{
+    connection conn = driver<sybase::driver>::load().get_connection(SERVER, "sa", "");
+    if (false == conn.connect())
+        throw runtime_error("failed to connect");
+    return conn;
+}
+
+/*
+ * prepared statements are reused from the connection cache, evicted unused
+ * ones are deallocated on the server and disconnect empties the cache as the
+ * server drops dynamic statements of the session
+ */
+static void test_dynamic_cache()
+{
+    auto& srv = ctmock::server();
+    srv.handler = [](const string& sql, const vector<ctmock::value>& params)
+    {
+        return ctmock::response{ctmock::rows({{"v", CS_INT_TYPE, sizeof(CS_INT)}}, {{params.at(0)}})};
+    };
+    connection conn = get_connection();
+    auto& native = static_cast<sybase::connection&>(conn);
+    conn.statement_cache(2);
+    {
+        statement stmt = conn.get_statement();
+        stmt.prepare("select a = ?");
+        stmt.set_int(0, 7);
+        result_set rs = stmt.execute();
+        CHECK(rs.next() && 7 == rs.get_int(0));
+        CHECK(false == rs.next());
+        stmt.prepare("select b = ?");
+        stmt.prepare("select a = ?");
+        stmt.set_int(0, 8);
+        rs = stmt.execute();
+        CHECK(rs.next() && 8 == rs.get_int(0));
+        CHECK(1 == srv.count("PREPARE select a = ?") && 1 == srv.count("PREPARE select b = ?"));
+        auto st = conn.statement_cache_stats();
+        CHECK(1 == st.hits && 2 == st.misses && 0 == st.evictions && 2 == st.size);
+        // the unused statement is evicted, the ones in use are kept over the capacity until released
+        statement other = conn.get_statement();
+        other.prepare("select c = ?");
+        CHECK(1 == srv.count("DEALLOC") && 1 == srv.count("DEALLOC select b = ?"));
+        {
+            statement third = conn.get_statement();
+            third.prepare("select d = ?");
+            CHECK(3 == conn.statement_cache_stats().size && 1 == srv.count("DEALLOC"));
+        }
+        CHECK(2 == srv.count("DEALLOC") && 1 == srv.count("DEALLOC select d = ?"));
+        st = conn.statement_cache_stats();
+        CHECK(1 == st.hits && 4 == st.misses && 2 == st.evictions && 2 == st.size);
+        CHECK(2 == native.native_connection()->dynamic.size());
+    }
+    CHECK(2 == conn.statement_cache_stats().size);
+    conn.disconnect();
+    CHECK(0 == conn.statement_cache_stats().size);
+    CHECK(2 == srv.count("DEALLOC"));
+    CHECK(conn.connect());
+    {
+        // the statement is prepared again on the new session instead of executing unknown id
+        statement stmt = conn.get_statement();
+        stmt.prepare("select a = ?");
+        stmt.set_int(0, 9);
+        result_set rs = stmt.execute();
+        CHECK(rs.next() && 9 == rs.get_int(0));
+        CHECK(2 == srv.count("PREPARE select a = ?") && 0 == srv.count("UNKNOWN"));
+    }
+}
+
+/*
+ * bulk_writer commits rows every batch_size() rows and the rest in done(),
+ * values are converted to column types and rows which are not committed are
+ * discarded when the writer goes out of scope
+ */
+static void test_bulk_writer()
+{
+    auto& srv = ctmock::server();
+    auto& items = srv.tables["items"];
+    items.columns = {{"id", CS_INT_TYPE, sizeof(CS_INT)}, {"name", CS_CHAR_TYPE, 8}, {"price", CS_FLOAT_TYPE, sizeof(CS_FLOAT)}};
+    connection conn = driver<sybase::driver>::load().get_connection(SERVER, "sa", "");
+    auto& native = static_cast<sybase::connection&>(conn);
+    {
+        // the writer opens the connection with bulk login
+        sybase::bulk_writer writer(native, "items");
+        CHECK(conn.connected());
+        writer.batch_size(2);
+        writer.write(1, "a", 1.5);
+        CHECK(0 == srv.count("BLK BATCH"));
+        writer.write(2, string("bb"), 2.5f);
+        CHECK(1 == srv.count("BLK BATCH 2") && 2 == items.rows.size());
+        writer.write(make_tuple(3, nullptr, 3));
+        writer.write_columns(vector<int64_t>{4, 5}, vector<string>{"dddd", "eeeeeeee"}, vector<double>{4.5, 5.5});
+        CHECK(2 == srv.count("BLK BATCH 2") && 4 == items.rows.size());
+        CHECK(5 == writer.rows_sent());
+        CHECK(5 == writer.done());
+        CHECK(1 == srv.count("BLK ALL 1") && 5 == items.rows.size());
+        bool thrown = false;
+        try
+        {
+            writer.write(6, "f", 6.0);
+        }
+        catch (const exception&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    CHECK(0 == srv.count("BLK CANCEL"));
+    CHECK(3 == ctmock::as<CS_INT>(items.rows[2][0]) && items.rows[2][1].null && 3.0 == ctmock::as<CS_FLOAT>(items.rows[2][2]));
+    CHECK("eeeeeeee" == items.rows[4][1].data && 5.5 == ctmock::as<CS_FLOAT>(items.rows[4][2]));
+    {
+        sybase::bulk_writer writer(native, "items");
+        writer.write(6, "f", 6.0).write(7, "g", 7.0);
+        CHECK(2 == writer.commit());
+        writer.write(8, "h", 8.0);
+        bool thrown = false;
+        try
+        {
+            writer.write(9, "too long value", 9.0);
+        }
+        catch (const exception& e)
+        {
+            thrown = (string::npos != string(e.what()).find("Value is too large"));
+        }
+        CHECK(thrown);
+        CHECK(3 == writer.rows_sent());
+    }
+    // the row sent after the commit is discarded
+    CHECK(1 == srv.count("BLK CANCEL 1") && 7 == items.rows.size());
+    CHECK(7 == ctmock::as<CS_INT>(items.rows.back()[0]) && "g" == items.rows.back()[1].data);
+    {
+        // values which do not fit the column type are not sent
+        sybase::bulk_writer writer(native, "items");
+        bool thrown = false;
+        try
+        {
+            writer.write(int64_t(1) << 40, "i", 10.0);
+        }
+        catch (const exception&)
+        {
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(0 == writer.rows_sent() && 0 == writer.done());
+    }
+    CHECK(7 == items.rows.size());
+}
+
+/*
+ * poller drives statements of several connections through chains of pending
+ * network operations, passes failures to the callbacks, lets a callback start
+ * the next statement on its connection, and cancels statements which are
+ * still in flight when it is destroyed
+ */
+static void test_poller()
+{
+    auto& srv = ctmock::server();
+    srv.latency = chrono::milliseconds(20);
+    srv.handler = [](const string& sql, const vector<ctmock::value>& params)
+    {
+        if ("select fail" == sql)
+            return ctmock::response{ctmock::fail()};
+        if ("update t" == sql)
+            return ctmock::response{ctmock::done(3)};
+        return ctmock::response{ctmock::rows({{"n", CS_INT_TYPE, sizeof(CS_INT)}, {"s", CS_CHAR_TYPE, 8}},
+                                             {{ctmock::make<CS_INT>(1), ctmock::make("a")}, {ctmock::make<CS_INT>(2), ctmock::null()}})};
+    };
+    connection conn1 = get_connection();
+    connection conn2 = get_connection();
+    auto& native1 = static_cast<sybase::connection&>(conn1);
+    auto& native2 = static_cast<sybase::connection&>(conn2);
+    materialized_result selected;
+    size_t updated = 0;
+    string error;
+    {
+        sybase::poller poller(driver<sybase::driver>::load());
+        poller.execute(native1, "select rows", [&](exception_ptr ex, materialized_result&& res)
+        {
+            CHECK(nullptr == ex);
+            selected = move(res);
+            poller.execute(native1, "update t", [&](exception_ptr ex, materialized_result&& res)
+            {
+                CHECK(nullptr == ex);
+                updated = res.rows_affected;
+            });
+        });
+        poller.execute(native2, "select fail", [&](exception_ptr ex, materialized_result&& res)
+        {
+            try
+            {
+                if (ex)
+                    rethrow_exception(ex);
+            }
+            catch (const exception& e)
+            {
+                error = e.what();
+            }
+        });
+        CHECK(2 == poller.pending());
+        CHECK(0 == poller.poll());
+        poller.run();
+        CHECK(0 == poller.pending());
+    }
+    CHECK(1 == selected.result_sets.size());
+    if (1 == selected.result_sets.size())
+    {
+        auto& batch = selected.result_sets[0];
+        CHECK(2 == batch.rows && 2 == batch.columns.size());
+        CHECK(1 == batch.columns[0].get_long(0) && 2 == batch.columns[0].get_long(1));
+        CHECK("a" == batch.columns[1].get_string(0) && batch.columns[1].is_null(1));
+    }
+    CHECK(3 == updated);
+    CHECK(string::npos != error.find("Failed to execute command"));
+    // send, results, 2 fetches and 2 results of the select, send and 3 results of the update, send and results of the failure
+    CHECK(12 == srv.polls);
+    CHECK(0 == srv.busy_drops);
+    bool called = false;
+    {
+        sybase::poller poller(driver<sybase::driver>::load());
+        poller.execute(native1, "select rows", [&](exception_ptr ex, materialized_result&& res) { called = true; });
+        poller.execute(native2, "select rows", [&](exception_ptr ex, materialized_result&& res) { called = true; });
+        CHECK(0 == poller.poll(chrono::milliseconds(100)));
+        CHECK(2 == poller.pending());
+    }
+    CHECK(false == called);
+    CHECK(0 == srv.busy_drops);
+    // the connections are back to synchronous I/O and have no results pending
+    for (auto conn : {&conn1, &conn2})
+    {
+        statement stmt = conn->get_statement();
+        result_set rs = stmt.execute("select rows");
+        CHECK(rs.next() && 1 == rs.get_int(0));
+    }
+}
+
+/*
+ * execute_batch runs all rows in one transaction and reports failed rows, but
+ * fails the whole batch without a rollback of its own when the server rolls
+ * the transaction back after a failed row
+ */
+static void test_execute_batch()
+{
+    auto& srv = ctmock::server();
+    const string sql = "insert into t values (?, ?)";
+    srv.params[sql] = {{"name", CS_CHAR_TYPE, 16}, {"qty", CS_INT_TYPE, sizeof(CS_INT)}};
+    srv.handler = [](const string& sql, const vector<ctmock::value>& params)
+    {
+        if (params.empty())
+            return ctmock::response{ctmock::done()};
+        if ("bad" == params[0].data)
+            return ctmock::response{ctmock::fail()};
+        if ("deadlock" == params[0].data)
+            return ctmock::response{ctmock::abort_tran()};
+        return ctmock::response{ctmock::done(1)};
+    };
+    connection conn = get_connection();
+    statement stmt = conn.get_statement();
+    stmt.prepare(sql);
+    auto res = stmt.execute_batch(vector<tuple<string, int>>{make_tuple("a", 1), make_tuple("bad", 2), make_tuple("c", 3)});
+    CHECK(3 == res.affected.size() && 2 == res.rows_affected());
+    CHECK(1 == res.failed.size() && 1 == res.failed[0] && 1 == res.errors.size());
+    CHECK(3 == srv.count("EXECUTE " + sql));
+    CHECK(1 == srv.count("LANG begin tran") && 1 == srv.count("LANG commit tran") && 0 == srv.count("LANG rollback tran"));
+    srv.log.clear();
+    string error;
+    try
+    {
+        stmt.execute_batch(vector<tuple<string, int>>{make_tuple("a", 1), make_tuple("deadlock", 2), make_tuple("c", 3)});
+    }
+    catch (const exception& e)
+    {
+        error = e.what();
+    }
+    CHECK(string::npos != error.find("Transaction was rolled back"));
+    CHECK(2 == srv.count("EXECUTE " + sql));
+    CHECK(0 == srv.count("LANG commit tran") && 0 == srv.count("LANG rollback tran"));
+    // the statement and the connection are still usable
+    res = stmt.execute_batch(vector<tuple<string, int>>{make_tuple("d", 4)});
+    CHECK(1 == res.rows_affected() && res.failed.empty());
+    CHECK(1 == srv.count("LANG commit tran"));
+}
+
+int main(int argc, char** argv)
+{
+    vector<pair<const char*, function<void()>>> tests =
+    {
+        {"dynamic_cache", test_dynamic_cache},
+        {"bulk_writer", test_bulk_writer},
+        {"poller", test_poller},
+        {"execute_batch", test_execute_batch},
+    };
+    for (auto& t : tests)
+    {
+        try
+        {
+            ctmock::server().reset();
+            t.second();
+        }
+        catch (const exception& e)
+        {
+            ++failures;
+            cout << t.first << ": exception: " << e.what() << endl;
+        }
+    }
+    cout << (0 == failures ? "all tests passed" : "some tests failed") << endl;
+    return (0 == failures ? 0 : 1);
+}
@@ -24,6 +24,13 @@
 #include <type_traits>
 #include <mutex>
 #include <atomic>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#if __cplusplus > 201402L
+#include <string_view>
+#endif
 
 namespace std {
     template<typename T>
@@ -56,6 +63,173 @@ namespace vgi { namespace dbconn { namespace utils {
         std::atomic_flag lck = ATOMIC_FLAG_INIT;
     };
 
+#if __cplusplus > 201402L
+    using string_view = std::string_view;
+#else
+    /**
+     * string_view - is a minimal non-owning reference to a character sequence
+     * used until std::string_view (c++17) is available
+     */
+    class string_view
+    {
+    public:
+        constexpr string_view() noexcept { }
+        constexpr string_view(const char* str, size_t len) noexcept : str(str), len(len) { }
+        string_view(const char* str) noexcept : str(str), len(std::char_traits<char>::length(str)) { }
+        string_view(const std::string& str) noexcept : str(str.data()), len(str.length()) { }
+
+        constexpr const char* data() const noexcept { return str; }
+        constexpr size_t size() const noexcept { return len; }
+        constexpr size_t length() const noexcept { return len; }
+        constexpr bool empty() const noexcept { return 0 == len; }
+        constexpr const char* begin() const noexcept { return str; }
+        constexpr const char* end() const noexcept { return str + len; }
+        constexpr const char& operator[](size_t pos) const { return str[pos]; }
+        explicit operator std::string() const { return std::string(str, len); }
+
+        friend bool operator==(string_view l, string_view r) noexcept
+        {
+            return (l.len == r.len && std::char_traits<char>::compare(l.str, r.str, l.len) == 0);
+        }
+
+        friend bool operator!=(string_view l, string_view r) noexcept
+        {
+            return !(l == r);
+        }
+
+        friend std::ostream& operator<<(std::ostream& stream, string_view sv)
+        {
+            return stream.write(sv.str, sv.len);
+        }
+
+    private:
+        const char* str = nullptr;
+        size_t len = 0;
+    };
+#endif
+
+    /**
+     * span - is a minimal non-owning reference to a contiguous sequence of
+     * objects (std::span is only available in c++20)
+     */
+    template<typename T>
+    class span
+    {
+    public:
+        constexpr span() noexcept { }
+        constexpr span(T* ptr, size_t len) noexcept : ptr(ptr), len(len) { }
+
+        constexpr T* data() const noexcept { return ptr; }
+        constexpr size_t size() const noexcept { return len; }
+        constexpr bool empty() const noexcept { return 0 == len; }
+        constexpr T* begin() const noexcept { return ptr; }
+        constexpr T* end() const noexcept { return ptr + len; }
+        constexpr T& operator[](size_t pos) const { return ptr[pos]; }
+
+    private:
+        T* ptr = nullptr;
+        size_t len = 0;
+    };
+
+    using blob_span = span<const uint8_t>;
+
+    /**
+     * index_map - is a flat open addressing (linear probing) hash table mapping
+     * column names to column indexes. clear() keeps allocated slots and their
+     * strings so that rebuilding the map for the next execution of the same
+     * statement does not allocate memory.
+     */
+    class index_map
+    {
+    public:
+        void clear()
+        {
+            for (auto& slot : slots)
+                slot.index = -1;
+            count = 0;
+        }
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        void insert(string_view name, int index)
+        {
+            if ((count + 1) * 2 > slots.size())
+                grow();
+            auto hash = hash_of(name);
+            auto& slot = slots[probe(name, hash)];
+            if (slot.index < 0)
+            {
+                slot.name.assign(name.data(), name.size());
+                slot.hash = hash;
+                ++count;
+            }
+            slot.index = index;
+        }
+
+        int find(string_view name) const
+        {
+            if (0 == count)
+                return -1;
+            return slots[probe(name, hash_of(name))].index;
+        }
+
+    private:
+        struct slot
+        {
+            std::string name;
+            size_t hash = 0;
+            int index = -1;
+        };
+
+        static size_t hash_of(string_view name)
+        {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ULL;
+            for (auto c : name)
+            {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 1099511628211ULL;
+            }
+            return static_cast<size_t>(hash);
+        }
+
+        size_t probe(string_view name, size_t hash) const
+        {
+            auto mask = slots.size() - 1;
+            for (auto i = hash & mask; ; i = (i + 1) & mask)
+            {
+                auto& slot = slots[i];
+                if (slot.index < 0 || (slot.hash == hash && string_view(slot.name) == name))
+                    return i;
+            }
+        }
+
+        void grow()
+        {
+            std::vector<slot> old(std::max<size_t>(16, slots.size() * 2));
+            old.swap(slots);
+            count = 0;
+            for (auto& slot : old)
+            {
+                if (slot.index >= 0)
+                {
+                    auto& dest = slots[probe(slot.name, slot.hash)];
+                    dest.name = std::move(slot.name);
+                    dest.hash = slot.hash;
+                    dest.index = slot.index;
+                    ++count;
+                }
+            }
+        }
+
+    private:
+        std::vector<slot> slots;
+        size_t count = 0;
+    };
+
 } } } // namepsace vgi::dbconn::utils
 
 #endif // UTILITIES_HPP